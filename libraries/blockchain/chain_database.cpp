@@ -24,6 +24,7 @@
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <thread>
 
 // the definition of detail::chain_database_impl is moved to a separate file so it can be shared by the market_engine(s)
 #include <bts/blockchain/chain_database_impl.hpp>
@@ -33,26 +34,160 @@ namespace bts { namespace blockchain {
 
    namespace detail
    {
+      /**
+       *  A pending transaction is stale if it expired, if it was evaluated without seeing the other
+       *  pending transactions, or if it read a record that changed since it was evaluated.  The
+       *  changes of a stale transaction are invalid too, so transactions that read them are also
+       *  stale.  Only the transactions found through the indexes are visited.
+       */
+      unordered_set<transaction_id_type> chain_database_impl::get_stale_pending_transactions()const
+      {
+            unordered_set<transaction_id_type> stale_trx_ids;
+            vector<transaction_id_type>        unvisited_trx_ids;
+            const auto mark_stale = [&]( const transaction_id_type& trx_id )
+            {
+                if( stale_trx_ids.insert( trx_id ).second )
+                    unvisited_trx_ids.push_back( trx_id );
+            };
+
+            for( auto itr = _pending_by_sequence.lower_bound( _pending_state_reset_sequence ); itr != _pending_by_sequence.end(); ++itr )
+                mark_stale( itr->second );
+
+            const auto now = self->now();
+            for( auto itr = _pending_expirations.begin(); itr != _pending_expirations.end() && itr->first <= now; ++itr )
+                mark_stale( itr->second );
+
+            chain_state_key_set visited_keys;
+            const auto mark_readers_stale = [&]( const chain_state_key& key )
+            {
+                if( !visited_keys.insert( key ).second )
+                    return;
+                const auto readers_itr = _pending_readers.find( key );
+                if( readers_itr == _pending_readers.end() )
+                    return;
+                for( const auto& trx_id : readers_itr->second )
+                    mark_stale( trx_id );
+            };
+
+            for( const auto& key : _pending_invalidated_keys )
+                mark_readers_stale( key );
+
+            while( !unvisited_trx_ids.empty() )
+            {
+                const transaction_id_type trx_id = unvisited_trx_ids.back();
+                unvisited_trx_ids.pop_back();
+
+                const auto state_itr = _pending_transaction_states.find( trx_id );
+                if( state_itr == _pending_transaction_states.end() )
+                    continue;
+
+                chain_state_key_set written_keys;
+                state_itr->second.changes->get_written_keys( written_keys );
+                for( const auto& key : written_keys )
+                    mark_readers_stale( key );
+            }
+
+            return stale_trx_ids;
+      }
+
+      void chain_database_impl::insert_pending_transaction_state( const transaction_id_type& trx_id, pending_transaction_state&& pending )
+      {
+            erase_pending_transaction_state( trx_id );
+            for( const auto& key : pending.reads )
+                _pending_readers[ key ].insert( trx_id );
+            _pending_by_sequence[ pending.sequence ] = trx_id;
+            _pending_expirations.insert( std::make_pair( pending.eval_state->trx.expiration, trx_id ) );
+            _pending_transaction_states[ trx_id ] = std::move( pending );
+      }
+
+      void chain_database_impl::erase_pending_transaction_state( const transaction_id_type& trx_id )
+      {
+            const auto state_itr = _pending_transaction_states.find( trx_id );
+            if( state_itr == _pending_transaction_states.end() )
+                return;
+
+            const pending_transaction_state& pending = state_itr->second;
+            for( const auto& key : pending.reads )
+            {
+                const auto readers_itr = _pending_readers.find( key );
+                if( readers_itr == _pending_readers.end() )
+                    continue;
+                readers_itr->second.erase( trx_id );
+                if( readers_itr->second.empty() )
+                    _pending_readers.erase( readers_itr );
+            }
+            _pending_by_sequence.erase( pending.sequence );
+            _pending_expirations.erase( std::make_pair( pending.eval_state->trx.expiration, trx_id ) );
+            _pending_transaction_states.erase( state_itr );
+      }
+
+      /**
+       *  Rebuilds the pending state after the chain changed.  The changes of every pending transaction that
+       *  is not stale are applied again as they were, in their original order, and only the stale ones are
+       *  evaluated again on top of them.
+       */
       void chain_database_impl::revalidate_pending()
       {
-            _pending_fee_index.clear();
+            // recover the signing keys of the stale transactions in parallel before touching any state,
+            // this yields and new transactions or blocks may arrive in the meantime
+            const uint64_t next_sequence_before = _next_pending_sequence;
+            const uint64_t invalidation_count_before = _pending_invalidation_count;
+            auto stale = get_stale_pending_transactions();
+
+            vector<transaction_id_type> stale_trx_ids;
+            signed_transactions         stale_trxs;
+            for( const auto& trx_id : stale )
+            {
+                const auto state_itr = _pending_transaction_states.find( trx_id );
+                if( state_itr == _pending_transaction_states.end() ) continue;
+                stale_trx_ids.push_back( trx_id );
+                stale_trxs.push_back( state_itr->second.eval_state->trx );
+            }
+            const auto recovered_signees = recover_signees( stale_trxs );
+            unordered_map<transaction_id_type, optional<vector<public_key_type>>> pending_signees;
+            for( size_t i = 0; i < stale_trx_ids.size(); ++i )
+                pending_signees[ stale_trx_ids[ i ] ] = recovered_signees[ i ];
 
-            vector<transaction_id_type> trx_to_discard;
+            if( _next_pending_sequence != next_sequence_before || _pending_invalidation_count != invalidation_count_before )
+                stale = get_stale_pending_transactions();
+            _pending_invalidated_keys.clear();
+            _pending_state_reset_sequence = uint64_t( -1 );
 
+            _pending_fee_index.clear();
             _pending_trx_state = std::make_shared<pending_chain_state>( self->shared_from_this() );
-            unsigned num_pending_transaction_considered = 0;
-            auto itr = _pending_transaction_db.begin();
-            while( itr.valid() )
+
+            unordered_map<transaction_id_type, pending_transaction_state> previous_states;
+            std::map<uint64_t, transaction_id_type>                       previous_by_sequence;
+            std::swap( previous_states, _pending_transaction_states );
+            std::swap( previous_by_sequence, _pending_by_sequence );
+            _pending_readers.clear();
+            _pending_expirations.clear();
+
+            for( const auto& item : previous_by_sequence )
+            {
+                if( stale.count( item.second ) )
+                    continue;
+                pending_transaction_state& pending = previous_states[ item.second ];
+                pending.changes->set_prev_state( _pending_trx_state );
+                pending.changes->apply_changes();
+                _pending_fee_index[ fee_index( pending.eval_state->get_fees(), item.second ) ] = pending.eval_state;
+                insert_pending_transaction_state( item.second, std::move( pending ) );
+            }
+
+            vector<transaction_id_type> trx_to_discard;
+            for( const auto& item : previous_by_sequence )
             {
-                signed_transaction trx = itr.value();
-                transaction_id_type trx_id = itr.key();
-                assert(trx_id == trx.id());
+                const transaction_id_type& trx_id = item.second;
+                if( !stale.count( trx_id ) )
+                    continue;
+
                 try
                 {
-                  transaction_evaluation_state_ptr eval_state = self->evaluate_transaction( trx, _relay_fee );
-                  share_type fees = eval_state->get_fees();
-                  _pending_fee_index[ fee_index( fees, trx_id ) ] = eval_state;
-                  wlog("revalidated pending transaction id ${id}", ("id", trx_id));
+                  const auto signees_itr = pending_signees.find( trx_id );
+                  transaction_evaluation_state_ptr eval_state = evaluate_transaction( previous_states[ trx_id ].eval_state->trx, _relay_fee,
+                                                                                      signees_itr != pending_signees.end() ? signees_itr->second
+                                                                                                                           : optional<vector<public_key_type>>() );
+                  _pending_fee_index[ fee_index( eval_state->get_fees(), trx_id ) ] = eval_state;
                 }
                 catch ( const fc::canceled_exception& )
                 {
@@ -61,22 +196,461 @@ namespace bts { namespace blockchain {
                 catch ( const fc::exception& e )
                 {
                   trx_to_discard.push_back(trx_id);
-                  wlog( "discarding invalid transaction: ${id} ${e}",
+                  dlog( "discarding invalid transaction: ${id} ${e}",
                         ("id",trx_id)("e",e.to_detail_string()) );
                 }
-                ++num_pending_transaction_considered;
-                ++itr;
             }
 
             for( const auto& item : trx_to_discard )
                 _pending_transaction_db.remove( item );
-            wlog("revalidate_pending complete, there are now ${pending_count} evaluated transactions, ${num_pending_transaction_considered} raw transactions",
-                 ("pending_count", _pending_fee_index.size())
-                 ("num_pending_transaction_considered", num_pending_transaction_considered));
+            ilog( "revalidate_pending complete, ${evaluated} of ${pending_count} pending transactions evaluated again, ${discarded} discarded",
+                  ("evaluated", stale.size())
+                  ("pending_count", _pending_fee_index.size() + trx_to_discard.size())
+                  ("discarded", trx_to_discard.size()) );
+      }
+
+      vector<public_key_type> chain_database_impl::recover_signees( const signed_transaction& trx )const
+      {
+         vector<public_key_type> signees;
+         signees.reserve( trx.signatures.size() );
+         const auto digest = trx.digest( _chain_id );
+         for( const auto& sig : trx.signatures )
+            signees.push_back( fc::ecc::public_key( sig, digest ) );
+         return signees;
+      }
+
+      /**
+       *  Recovers the signing keys of every transaction on the signature recovery threads, each
+       *  thread takes every Nth transaction so that only one task per thread is scheduled.
+       *
+       *  The calling task yields until all threads are done, so this must not be called from a
+       *  non-preemptable scope such as push_block() once it holds the lock.  The threads share the
+       *  transactions and the results with the caller, so canceling the caller cannot free them
+       *  while the threads still use them.
+       */
+      vector<optional<vector<public_key_type>>> chain_database_impl::recover_signees( const signed_transactions& trxs )
+      {
+         const auto shared_trxs = std::make_shared<const signed_transactions>( trxs );
+         const auto signees = std::make_shared<vector<optional<vector<public_key_type>>>>( trxs.size() );
+         const size_t num_threads = std::min( _signature_recovery_threads.size(), trxs.size() );
+
+         vector<fc::future<void>> recovery_progress;
+         recovery_progress.reserve( num_threads );
+         for( size_t t = 0; t < num_threads; ++t )
+         {
+            recovery_progress.push_back( _signature_recovery_threads[ t ]->async( [this,t,num_threads,shared_trxs,signees]()
+            {
+               for( size_t i = t; i < shared_trxs->size(); i += num_threads )
+               {
+                  try
+                  {
+                     (*signees)[ i ] = recover_signees( (*shared_trxs)[ i ] );
+                  }
+                  catch( const fc::exception& )
+                  {
+                     // leave it unset, evaluation will try again and reject the transaction
+                  }
+               }
+            }, "recover_signees" ) );
+         }
+
+         for( auto& progress : recovery_progress )
+            progress.wait();
+
+         return *signees;
+      }
+
+      block_signee_data chain_database_impl::recover_signees( const full_block& block, bool include_transactions )
+      {
+         block_signee_data signees;
+
+         const signed_block_header header = block;
+         auto block_signee_progress = _signature_recovery_threads.back()->async( [header]() -> optional<public_key_type>
+         {
+            try
+            {
+               return header.signee();
+            }
+            catch( const fc::exception& )
+            {
+               return optional<public_key_type>();
+            }
+         }, "recover_block_signee" );
+
+         if( include_transactions )
+            signees.transaction_signees = recover_signees( block.user_transactions );
+
+         signees.block_signee = block_signee_progress.wait();
+         return signees;
+      }
+
+      /**
+       *  Recovers the signing keys of a run of consecutive blocks, used when reindexing.  Each
+       *  thread takes every Nth block and recovers its block and transaction signees serially,
+       *  which keeps all threads busy without scheduling a task per signature.
+       *
+       *  Blocks before the last checkpoint are left unset because their signatures are not
+       *  checked anyway.  Like the transaction version, the threads share the blocks and the results.
+       */
+      vector<optional<block_signee_data>> chain_database_impl::recover_signees( const vector<full_block>& blocks,
+                                                                                bool include_transactions )
+      {
+         const auto shared_blocks = std::make_shared<const vector<full_block>>( blocks );
+         const auto signees = std::make_shared<vector<optional<block_signee_data>>>( blocks.size() );
+         const size_t num_threads = std::min( _signature_recovery_threads.size(), blocks.size() );
+
+         vector<fc::future<void>> recovery_progress;
+         recovery_progress.reserve( num_threads );
+         for( size_t t = 0; t < num_threads; ++t )
+         {
+            recovery_progress.push_back( _signature_recovery_threads[ t ]->async( [this,t,num_threads,include_transactions,shared_blocks,signees]()
+            {
+               for( size_t i = t; i < shared_blocks->size(); i += num_threads )
+               {
+                  const full_block& block = (*shared_blocks)[ i ];
+                  if( is_before_last_checkpoint( block.block_num ) )
+                     continue;
+
+                  block_signee_data block_signees;
+                  try
+                  {
+                     block_signees.block_signee = block.signee();
+                  }
+                  catch( const fc::exception& )
+                  {
+                  }
+
+                  if( include_transactions )
+                  {
+                     block_signees.transaction_signees.resize( block.user_transactions.size() );
+                     for( size_t j = 0; j < block.user_transactions.size(); ++j )
+                     {
+                        try
+                        {
+                           block_signees.transaction_signees[ j ] = recover_signees( block.user_transactions[ j ] );
+                        }
+                        catch( const fc::exception& )
+                        {
+                        }
+                     }
+                  }
+
+                  (*signees)[ i ] = std::move( block_signees );
+               }
+            }, "recover_block_signees" ) );
+         }
+
+         for( auto& progress : recovery_progress )
+            progress.wait();
+
+         return *signees;
       }
 
+      bool chain_database_impl::is_before_last_checkpoint( uint32_t block_num )const
+      {
+         return !CHECKPOINT_BLOCKS.empty() && (--CHECKPOINT_BLOCKS.end())->first > block_num;
+      }
+
+/** the databases under index/, each one is a keyspace of _index_db named after the member */
+#define CHAIN_DB_INDEX_MAPS (_market_transactions_db)(_slate_db)(_fork_number_db)(_fork_db)(_property_db)(_undo_state_db) \
+                            (_block_id_to_block_record_db)(_id_to_transaction_record_db)(_pending_transaction_db)(_asset_db) \
+                            (_symbol_index_db)(_balance_db)(_address_to_balance_db)(_account_db)(_account_index_db) \
+                            (_address_to_account_db)(_delegate_vote_index_db)(_slot_record_db)(_burn_db)(_ask_db)(_bid_db)(_relative_ask_db) \
+                            (_relative_bid_db)(_short_db)(_collateral_db)(_feed_db)(_market_status_db)(_market_history_db) \
+                            (_asset_totals_db)(_order_index_db)(_owner_to_order_id_db)
+
+      /**
+       *  Only the index databases are buffered.  The raw chain is written through as usual because the
+       *  chain_server worker threads read blocks from it while the chain thread writes, and the buffered
+       *  writes of a level_map are not synchronized.
+       *
+       *  The marker file exists for as long as bulk write mode is on.  Buffered writes are lost if the
+       *  process dies, so if the marker is still there on startup the index is rebuilt from the raw chain.
+       */
+      void chain_database_impl::begin_bulk_write()
+      { try {
+         const fc::path marker = _data_dir / "index/bulk_write_in_progress";
+         if( !fc::exists( marker ) )
+         {
+            std::ofstream marker_file( marker.string() );
+            marker_file << _head_block_header.block_num << "\n";
+         }
+
+#define BEGIN_BATCH(r, data, elem) elem.begin_batch();
+         BOOST_PP_SEQ_FOR_EACH(BEGIN_BATCH, _, CHAIN_DB_INDEX_MAPS)
+#undef BEGIN_BATCH
+         _blocks_since_bulk_commit = 0;
+      } FC_CAPTURE_AND_RETHROW() }
+
+      /** the index databases are committed together as one atomic write to _index_db */
+      void chain_database_impl::commit_bulk_write()
+      { try {
+         _index_db.begin_write_group();
+#define COMMIT_BATCH(r, data, elem) elem.commit_batch();
+         BOOST_PP_SEQ_FOR_EACH(COMMIT_BATCH, _, CHAIN_DB_INDEX_MAPS)
+#undef COMMIT_BATCH
+         _index_db.commit_write_group( true );
+         _blocks_since_bulk_commit = 0;
+      } FC_CAPTURE_AND_RETHROW() }
+
+      /** must be called outside of push_block()'s non-preemptable scope */
+      void chain_database_impl::bulk_write_block_pushed()
+      { try {
+         if( _bulk_write_blocks == 0 || ++_blocks_since_bulk_commit < _bulk_write_blocks )
+            return;
+
+         commit_bulk_write();
+         begin_bulk_write();
+      } FC_CAPTURE_AND_RETHROW() }
+
+      void chain_database_impl::adjust_asset_totals( const asset_id_type& asset_id, share_type supply_delta, share_type debt_delta )
+      { try {
+         if( supply_delta == 0 && debt_delta == 0 )
+            return;
+
+         fc::optional<asset_totals> totals = _asset_totals_db.fetch_optional( asset_id );
+         if( !totals.valid() ) totals = asset_totals();
+
+         totals->supply += supply_delta;
+         totals->debt += debt_delta;
+         _asset_totals_db.store( asset_id, *totals );
+      } FC_CAPTURE_AND_RETHROW( (asset_id)(supply_delta)(debt_delta) ) }
+
+      /**
+       *  Recomputes the totals of every asset from the records themselves, this is what
+       *  calculate_supply() and calculate_debt() used to do on every call and is now only
+       *  used by sanity_check() to verify _asset_totals_db.
+       */
+      map<asset_id_type, asset_totals> chain_database_impl::scan_asset_totals()
+      { try {
+         map<asset_id_type, asset_totals> totals;
+
+         for( auto itr = _balance_db.begin(); itr.valid(); ++itr )
+         {
+            const balance_record balance = itr.value();
+            totals[ balance.asset_id() ].supply += balance.balance;
+         }
+
+         for( auto itr = _ask_db.begin(); itr.valid(); ++itr )
+            totals[ itr.key().order_price.base_asset_id ].supply += itr.value().balance;
+         for( auto itr = _relative_ask_db.begin(); itr.valid(); ++itr )
+            totals[ itr.key().order_price.base_asset_id ].supply += itr.value().balance;
+
+         for( auto itr = _bid_db.begin(); itr.valid(); ++itr )
+         {
+            if( itr.key().order_price.quote_asset_id != asset_id_type( 0 ) )
+               totals[ itr.key().order_price.quote_asset_id ].supply += itr.value().balance;
+         }
+         for( auto itr = _relative_bid_db.begin(); itr.valid(); ++itr )
+         {
+            if( itr.key().order_price.quote_asset_id != asset_id_type( 0 ) )
+               totals[ itr.key().order_price.quote_asset_id ].supply += itr.value().balance;
+         }
+
+         for( auto itr = _short_db.begin(); itr.valid(); ++itr )
+            totals[ asset_id_type( 0 ) ].supply += itr.value().balance;
+
+         for( auto itr = _collateral_db.begin(); itr.valid(); ++itr )
+         {
+            const collateral_record collateral = itr.value();
+            totals[ asset_id_type( 0 ) ].supply += collateral.collateral_balance;
+            totals[ itr.key().order_price.quote_asset_id ].debt += collateral.payoff_balance;
+         }
+
+         for( auto itr = _account_db.begin(); itr.valid(); ++itr )
+         {
+            const account_record account = itr.value();
+            if( account.delegate_info.valid() )
+               totals[ asset_id_type( 0 ) ].supply += account.delegate_info->pay_balance;
+         }
+
+         return totals;
+      } FC_CAPTURE_AND_RETHROW() }
+
+      /**
+       *  Called by the store methods of every order book, orders are removed from the books when they become null.
+       *  The index only depends on the key, so it is written when an order is created or removed and not when its
+       *  balance changes.
+       */
+      void chain_database_impl::index_market_order( order_type_enum type, const market_index_key& key, bool existed, bool is_null )
+      { try {
+         if( existed != is_null )
+            return;
+
+         const order_id_type id = market_order( type, key, order_record() ).get_id();
+         if( is_null )
+         {
+            _order_index_db.remove( id );
+            _owner_to_order_id_db.remove( std::make_pair( key.owner, id ) );
+         }
+         else
+         {
+            market_order_index index;
+            index.type = type;
+            index.market_index = key;
+            _order_index_db.store( id, index );
+            _owner_to_order_id_db.store( std::make_pair( key.owner, id ), 0 );
+         }
+      } FC_CAPTURE_AND_RETHROW( (type)(key)(existed)(is_null) ) }
+
+      /** the orders of a market pair are a contiguous range of every book because keys are ordered by quote and base first */
+      vector<market_order> chain_database_impl::scan_market_orders( const optional<std::pair<asset_id_type, asset_id_type>>& pair,
+                                                                     const std::function<bool( const market_order& )>& filter,
+                                                                     uint32_t limit, order_type_enum type )
+      { try {
+         vector<market_order> orders;
+         if( limit == 0 ) return orders;
+
+         const auto in_range = [&]( const market_index_key& key ) -> bool
+         {
+             return !pair.valid() || (key.order_price.quote_asset_id == pair->first && key.order_price.base_asset_id == pair->second);
+         };
+
+         const auto add_order = [&]( const market_order& order ) -> bool
+         {
+             if( !filter || filter( order ) )
+                 orders.push_back( order );
+             return orders.size() < limit;
+         };
+
+         const auto first = [&]( bts::db::cached_level_map<market_index_key, order_record>& book )
+         {
+             return pair.valid() ? book.lower_bound( market_index_key( price( 0, pair->first, pair->second ) ) ) : book.begin();
+         };
+
+         const auto scan_book = [&]( bts::db::cached_level_map<market_index_key, order_record>& book,
+                                     order_type_enum book_type ) -> bool
+         {
+             if( type != null_order && type != book_type ) return true;
+             for( auto itr = first( book ); itr.valid() && in_range( itr.key() ); ++itr )
+             {
+                 if( !add_order( market_order( book_type, itr.key(), itr.value() ) ) )
+                     return false;
+             }
+             return true;
+         };
+
+         if( !scan_book( _ask_db, ask_order ) ) return orders;
+         if( !scan_book( _bid_db, bid_order ) ) return orders;
+         if( !scan_book( _relative_ask_db, relative_ask_order ) ) return orders;
+         if( !scan_book( _relative_bid_db, relative_bid_order ) ) return orders;
+         if( !scan_book( _short_db, short_order ) ) return orders;
+
+         if( type == null_order || type == cover_order )
+         {
+             auto itr = pair.valid() ? _collateral_db.lower_bound( market_index_key( price( 0, pair->first, pair->second ) ) )
+                                     : _collateral_db.begin();
+             for( ; itr.valid() && in_range( itr.key() ); ++itr )
+             {
+                 const auto collateral_rec = itr.value();
+                 if( !add_order( market_order( cover_order,
+                                               itr.key(),
+                                               order_record( collateral_rec.payoff_balance ),
+                                               collateral_rec.collateral_balance,
+                                               collateral_rec.interest_rate,
+                                               collateral_rec.expiration ) ) )
+                     return orders;
+             }
+         }
+
+         return orders;
+      } FC_CAPTURE_AND_RETHROW( (pair)(limit)(type) ) }
+
+      omarket_order chain_database_impl::fetch_market_order( order_type_enum type, const market_index_key& key )
+      { try {
+         switch( type )
+         {
+            case bid_order:
+            {
+               const auto order = _bid_db.fetch_optional( key );
+               if( order.valid() ) return market_order( type, key, *order );
+               break;
+            }
+            case ask_order:
+            {
+               const auto order = _ask_db.fetch_optional( key );
+               if( order.valid() ) return market_order( type, key, *order );
+               break;
+            }
+            case relative_bid_order:
+            {
+               const auto order = _relative_bid_db.fetch_optional( key );
+               if( order.valid() ) return market_order( type, key, *order );
+               break;
+            }
+            case relative_ask_order:
+            {
+               const auto order = _relative_ask_db.fetch_optional( key );
+               if( order.valid() ) return market_order( type, key, *order );
+               break;
+            }
+            case short_order:
+            {
+               const auto order = _short_db.fetch_optional( key );
+               if( order.valid() ) return market_order( type, key, *order );
+               break;
+            }
+            case cover_order:
+            {
+               const auto collateral = _collateral_db.fetch_optional( key );
+               if( collateral.valid() )
+               {
+                  return market_order( type, key, order_record( collateral->payoff_balance ),
+                                       collateral->collateral_balance, collateral->interest_rate, collateral->expiration );
+               }
+               break;
+            }
+            default:
+               break;
+         }
+         return omarket_order();
+      } FC_CAPTURE_AND_RETHROW( (type)(key) ) }
+
+      transaction_evaluation_state_ptr chain_database_impl::evaluate_transaction( const signed_transaction& trx,
+                                                                                  const share_type& required_fees,
+                                                                                  const optional<vector<public_key_type>>& signees )
+      { try {
+         if( !_pending_trx_state )
+            _pending_trx_state = std::make_shared<pending_chain_state>( self->shared_from_this() );
+
+         // Evaluate into a state of its own rather than a nested scope of _pending_trx_state like generate_block()
+         // does.  A nested scope only journals the values it replaced, but revalidate_pending() replays the
+         // values the transaction wrote, which is exactly what this child state holds.
+         pending_transaction_state pending;
+         pending.changes = std::make_shared<pending_chain_state>( _pending_trx_state );
+         pending.eval_state = std::make_shared<transaction_evaluation_state>( pending.changes.get(), _chain_id );
+
+         pending.changes->track_reads( &pending.reads );
+         try
+         {
+            pending.eval_state->_recovered_signees = signees;
+            pending.eval_state->evaluate( trx );
+         }
+         catch( ... )
+         {
+            pending.changes->track_reads( nullptr );
+            throw;
+         }
+         pending.changes->track_reads( nullptr );
+
+         auto fees = pending.eval_state->get_fees() + pending.eval_state->alt_fees_paid.amount;
+         if( fees < required_fees )
+         {
+             wlog("Transaction ${id} needed relay fee ${required_fees} but only had ${fees}", ("id", trx.id())("required_fees",required_fees)("fees",fees));
+             FC_CAPTURE_AND_THROW( insufficient_relay_fee, (fees)(required_fees) );
+         }
+         // apply changes from this transaction to _pending_trx_state
+         pending.changes->apply_changes();
+
+         const transaction_evaluation_state_ptr trx_eval_state = pending.eval_state;
+         pending.sequence = _next_pending_sequence++;
+         insert_pending_transaction_state( trx.id(), std::move( pending ) );
+         return trx_eval_state;
+      } FC_CAPTURE_AND_RETHROW( (trx) ) }
+
       void chain_database_impl::open_database( const fc::path& data_dir )
       { try {
+          _data_dir = data_dir;
           bool rebuild_index = false;
 
           if( !fc::exists(data_dir / "index" ) )
@@ -86,17 +660,17 @@ namespace bts { namespace blockchain {
               rebuild_index = true;
           }
 
-          _property_db.open( data_dir / "index/property_db" );
+          open_index_database( data_dir );
           auto database_version = _property_db.fetch_optional( chain_property_enum::database_version );
           if( !database_version || database_version->as_int64() < BTS_BLOCKCHAIN_DATABASE_VERSION )
           {
               if ( !rebuild_index )
               {
                 wlog( "old database version, upgrade and re-sync" );
-                _property_db.close();
+                close_index_database();
                 fc::remove_all( data_dir / "index" );
                 fc::create_directories( data_dir / "index" );
-                _property_db.open( data_dir / "index/property_db" );
+                open_index_database( data_dir );
                 rebuild_index = true;
               }
               self->set_property( chain_property_enum::database_version, BTS_BLOCKCHAIN_DATABASE_VERSION );
@@ -105,52 +679,41 @@ namespace bts { namespace blockchain {
           {
              FC_CAPTURE_AND_THROW( new_database_version, (database_version)(BTS_BLOCKCHAIN_DATABASE_VERSION) );
           }
-          _market_transactions_db.open( data_dir / "index/market_transactions_db" );
-          _fork_number_db.open( data_dir / "index/fork_number_db" );
-          _fork_db.open( data_dir / "index/fork_db" );
-          _slate_db.open( data_dir / "index/slate_db" );
-#if 0
-          _proposal_db.open( data_dir / "index/proposal_db" );
-          _proposal_vote_db.open( data_dir / "index/proposal_vote_db" );
-#endif
 
-          _undo_state_db.open( data_dir / "index/undo_state_db" );
-
-          _block_id_to_block_record_db.open( data_dir / "index/block_id_to_block_record_db" );
-          _block_num_to_id_db.open( data_dir / "raw_chain/block_num_to_id_db" );
-          _block_id_to_block_data_db.open( data_dir / "raw_chain/block_id_to_block_data_db" );
-          _id_to_transaction_record_db.open( data_dir / "index/id_to_transaction_record_db" );
+          _block_num_to_id_db.open( data_dir / "raw_chain/block_num_to_id_db", get_database_options( "_block_num_to_id_db" ) );
+          _block_id_to_block_data_db.open( data_dir / "raw_chain/block_id_to_block_data_db",
+                                           get_database_options( "_block_id_to_block_data_db" ) );
 
           for( auto itr = _id_to_transaction_record_db.begin(); itr.valid(); ++itr )
              _known_transactions.insert( itr.key() );
 
-          _pending_transaction_db.open( data_dir / "index/pending_transaction_db" );
-
-          _asset_db.open( data_dir / "index/asset_db" );
-          _balance_db.open( data_dir / "index/balance_db" );
-          _burn_db.open( data_dir / "index/burn_db" );
-          _account_db.open( data_dir / "index/account_db" );
-          _address_to_account_db.open( data_dir / "index/address_to_account_db" );
-
-          _account_index_db.open( data_dir / "index/account_index_db" );
-          _symbol_index_db.open( data_dir / "index/symbol_index_db" );
-          _delegate_vote_index_db.open( data_dir / "index/delegate_vote_index_db" );
-
-          _slot_record_db.open( data_dir / "index/slot_record_db" );
+          _pending_trx_state = std::make_shared<pending_chain_state>( self->shared_from_this() );
+      } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
-          _ask_db.open( data_dir / "index/ask_db" );
-          _bid_db.open( data_dir / "index/bid_db" );
-          _relative_ask_db.open( data_dir / "index/relative_ask_db" );
-          _relative_bid_db.open( data_dir / "index/relative_bid_db" );
-          _short_db.open( data_dir / "index/short_db" );
-          _collateral_db.open( data_dir / "index/collateral_db" );
-          _feed_db.open( data_dir / "index/feed_db" );
+      void chain_database_impl::open_index_database( const fc::path& data_dir )
+      { try {
+#define OPEN_KEYSPACE(r, data, elem) elem.open( _index_db, BOOST_PP_STRINGIZE(elem), get_database_options( BOOST_PP_STRINGIZE(elem) ) );
+         BOOST_PP_SEQ_FOR_EACH(OPEN_KEYSPACE, _, CHAIN_DB_INDEX_MAPS)
+#undef OPEN_KEYSPACE
+         _index_db.open( data_dir / "index/chain_index", _options.index_database );
+      } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
-          _market_status_db.open( data_dir / "index/market_status_db" );
-          _market_history_db.open( data_dir / "index/market_history_db" );
+      void chain_database_impl::close_index_database()
+      { try {
+#define CLOSE_KEYSPACE(r, data, elem) elem.close();
+         BOOST_PP_SEQ_FOR_EACH(CLOSE_KEYSPACE, _, CHAIN_DB_INDEX_MAPS)
+#undef CLOSE_KEYSPACE
+         _index_db.close();
+      } FC_CAPTURE_AND_RETHROW() }
 
-          _pending_trx_state = std::make_shared<pending_chain_state>( self->shared_from_this() );
-      } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
+      /** profiles are named like the database directories, which is the member name without the underscore */
+      bts::db::level_map_options chain_database_impl::get_database_options( const std::string& member_name )const
+      {
+         const auto itr = _options.databases.find( member_name.substr( 1 ) );
+         if( itr != _options.databases.end() )
+            return itr->second;
+         return bts::db::level_map_options();
+      }
 
       digest_type chain_database_impl::initialize_genesis( const optional<path>& genesis_file, bool chain_id_only )
       { try {
@@ -380,7 +943,7 @@ namespace bts { namespace blockchain {
          return current_blocks;
       }
 
-      void chain_database_impl::clear_pending( const full_block& blk )
+      void chain_database_impl::clear_pending( const full_block& blk, const pending_chain_state_ptr& block_changes )
       {
          std::unordered_set<transaction_id_type> confirmed_trx_ids;
 
@@ -389,9 +952,19 @@ namespace bts { namespace blockchain {
             auto id = trx.id();
             confirmed_trx_ids.insert( id );
             _pending_transaction_db.remove( id );
+            erase_pending_transaction_state( id );
          }
 
          _pending_fee_index.clear();
+         ++_pending_invalidation_count;
+
+         // only the transactions that are already pending can be invalidated by this block
+         if( !_pending_transaction_states.empty() )
+         {
+            block_changes->get_written_keys( _pending_invalidated_keys );
+            _pending_invalidated_keys.insert( pending_chain_state::make_state_key( pending_chain_state::head_block_key, uint8_t( 0 ) ) );
+         }
+         _pending_state_reset_sequence = std::min( _pending_state_reset_sequence, _next_pending_sequence );
 
          // this schedules the revalidate-pending-transactions task to execute in this thread
          // as soon as this current task (probably pushing a block) gets around to yielding.
@@ -603,7 +1176,9 @@ namespace bts { namespace blockchain {
       } FC_CAPTURE_AND_RETHROW( (block_id) ) }
 
       void chain_database_impl::apply_transactions( const full_block& block,
-                                                    const pending_chain_state_ptr& pending_state )
+                                                    const pending_chain_state_ptr& pending_state,
+                                                    const optional<block_signee_data>& signees,
+                                                    bool skip_signature_verification )
       {
          //ilog( "apply transactions from block: ${block_num}  ${trxs}", ("block_num",block.block_num)("trxs",user_transactions) );
          ilog( "Applying transactions from block: ${n}", ("n",block.block_num) );
@@ -616,7 +1191,9 @@ namespace bts { namespace blockchain {
                //ilog( "applying   ${trx}", ("trx",trx) );
                transaction_evaluation_state_ptr trx_eval_state =
                       std::make_shared<transaction_evaluation_state>(pending_state.get(), _chain_id);
-               trx_eval_state->evaluate( trx, _skip_signature_verification );
+               if( signees.valid() && signees->transaction_signees.size() == block.user_transactions.size() )
+                  trx_eval_state->_recovered_signees = signees->transaction_signees[ trx_num ];
+               trx_eval_state->evaluate( trx, skip_signature_verification );
                //ilog( "evaluation: ${e}", ("e",*trx_eval_state) );
                // TODO:  capture the evaluation state with a callback for wallets...
                // summary.transaction_states.emplace_back( std::move(trx_eval_state) );
@@ -858,16 +1435,20 @@ namespace bts { namespace blockchain {
       /**
        *  Performs all of the block validation steps and throws if error.
        */
-      void chain_database_impl::extend_chain( const full_block& block_data )
+      void chain_database_impl::extend_chain( const full_block& block_data, const optional<block_signee_data>& signees )
       { try {
          auto block_id = block_data.id();
          block_summary summary;
          try
          {
+            const bool before_last_checkpoint = is_before_last_checkpoint( block_data.block_num );
+
             public_key_type block_signee;
-            if( CHECKPOINT_BLOCKS.size() > 0 && (--CHECKPOINT_BLOCKS.end())->first > block_data.block_num )
+            if( before_last_checkpoint )
                //Skip signature validation
                block_signee = self->get_slot_signee( block_data.timestamp, self->get_active_delegates() ).active_key();
+            else if( signees.valid() && signees->block_signee.valid() )
+               block_signee = *signees->block_signee;
             else
                /* We need the block_signee's key in several places and computing it is expensive, so compute it here and pass it down */
                block_signee = block_data.signee();
@@ -897,7 +1478,7 @@ namespace bts { namespace blockchain {
 
             execute_markets( block_data.timestamp, pending_state );
 
-            apply_transactions( block_data, pending_state );
+            apply_transactions( block_data, pending_state, signees, _skip_signature_verification || before_last_checkpoint );
 
             update_active_delegate_list( block_data, pending_state );
 
@@ -914,7 +1495,7 @@ namespace bts { namespace blockchain {
 
             update_head_block( block_data );
 
-            clear_pending( block_data );
+            clear_pending( block_data, pending_state );
 
             _block_num_to_id_db.store( block_data.block_num, block_id );
 
@@ -972,6 +1553,68 @@ namespace bts { namespace blockchain {
          return history;
       } FC_RETHROW_EXCEPTIONS( warn, "", ("block_id",id) ) }
 
+      /**
+       *  Adds the block to the database and manages any reorganizations as a result.
+       *
+       *  Returns the block_fork_data of the new block, not necessarily the head block
+       */
+      block_fork_data chain_database_impl::push_block( const full_block& block_data, const optional<block_signee_data>& signees )
+      { try {
+         // only allow a single fiber attempt to push blocks at any given time,
+         // this method is not re-entrant.
+         fc::unique_lock<fc::mutex> lock( _push_block_mutex );
+
+         // The above check probably isn't enough.  We need to make certain that
+         // no other code sees the chain_database in an inconsistent state.
+         // The lock above prevents two push_blocks from happening at the same time,
+         // but we also need to ensure the wallet, blockchain, delegate, &c. loops don't
+         // see partially-applied blocks
+         ASSERT_TASK_NOT_PREEMPTED();
+
+         auto processing_start_time = time_point::now();
+         auto block_id = block_data.id();
+         auto current_head_id = _head_block_id;
+
+         std::pair<block_id_type, block_fork_data> longest_fork = store_and_index( block_id, block_data );
+         optional<block_fork_data> new_fork_data = self->get_block_fork_data(block_id);
+         FC_ASSERT(new_fork_data, "can't get fork data for a block we just successfully pushed");
+
+         //ilog( "previous ${p} ==? current ${c}", ("p",block_data.previous)("c",current_head_id) );
+         if( block_data.previous == current_head_id )
+         {
+            // attempt to extend chain
+            extend_chain( block_data, signees );
+            new_fork_data = self->get_block_fork_data(block_id);
+            FC_ASSERT(new_fork_data, "can't get fork data for a block we just successfully pushed");
+         }
+         else if( longest_fork.second.can_link() &&
+                  _block_id_to_block_record_db.fetch(longest_fork.first).block_num > _head_block_header.block_num )
+         {
+            try {
+               switch_to_fork( longest_fork.first );
+               new_fork_data = self->get_block_fork_data(block_id);
+               FC_ASSERT(new_fork_data, "can't get fork data for a block we just successfully pushed");
+            }
+            catch ( const fc::canceled_exception& )
+            {
+               throw;
+            }
+            catch ( const fc::exception& e )
+            {
+               wlog( "attempt to switch to fork failed: ${e}, reverting", ("e",e.to_detail_string() ) );
+               switch_to_fork( current_head_id );
+            }
+         }
+
+         /* Store processing time */
+         auto record = self->get_block_record( block_id );
+         FC_ASSERT( record.valid() );
+         record->processing_time = time_point::now() - processing_start_time;
+         _block_id_to_block_record_db.store( block_id, *record );
+
+         return *new_fork_data;
+      } FC_CAPTURE_AND_RETHROW( (block_data) )  }
+
       void chain_database_impl::pop_block()
       { try {
          if( _head_block_header.block_num == 0 )
@@ -991,6 +1634,9 @@ namespace bts { namespace blockchain {
          bts::blockchain::pending_chain_state_ptr undo_state = std::make_shared<bts::blockchain::pending_chain_state>(_undo_state_db.fetch( _head_block_id ));
          undo_state->set_prev_state( self->shared_from_this() );
          undo_state->apply_changes();
+         undo_state->get_written_keys( _pending_invalidated_keys );
+         ++_pending_invalidation_count;
+         _pending_invalidated_keys.insert( pending_chain_state::make_state_key( pending_chain_state::head_block_key, uint8_t( 0 ) ) );
 
          _head_block_id = previous_block_id;
          _head_block_header = self->get_block_header( _head_block_id );
@@ -1003,12 +1649,38 @@ namespace bts { namespace blockchain {
 
    } // namespace detail
 
+   chain_database_options::chain_database_options()
+   {
+      // blocks are looked up by id when serving peers and are otherwise read in full scans when re-indexing,
+      // block ids and numbers compare equal only when their bytes are equal so a bloom filter is safe here
+      bts::db::level_map_options block_data;
+      block_data.bloom_filter_bits = 10;
+      block_data.block_cache_size = 16 * 1024 * 1024;
+      block_data.fill_cache_on_scan = false;
+      databases[ "block_id_to_block_data_db" ] = block_data;
+
+      bts::db::level_map_options block_num_to_id;
+      block_num_to_id.bloom_filter_bits = 10;
+      databases[ "block_num_to_id_db" ] = block_num_to_id;
+
+      // scanned in full by get_balances() and when loading the known transactions on startup
+      bts::db::level_map_options scanned;
+      scanned.fill_cache_on_scan = false;
+      databases[ "balance_db" ] = scanned;
+      databases[ "id_to_transaction_record_db" ] = scanned;
+   }
+
    chain_database::chain_database()
    :my( new detail::chain_database_impl() )
    {
       my->self = this;
-      my->_skip_signature_verification = true;
+      my->_skip_signature_verification = false;
       my->_relay_fee = BTS_BLOCKCHAIN_DEFAULT_RELAY_FEE;
+
+      my->_num_signature_recovery_threads = std::max( my->_num_signature_recovery_threads, std::thread::hardware_concurrency() );
+      my->_signature_recovery_threads.reserve( my->_num_signature_recovery_threads );
+      for( uint32_t i = 0; i < my->_num_signature_recovery_threads; ++i )
+          my->_signature_recovery_threads.push_back( std::unique_ptr<fc::thread>( new fc::thread( "signature_recovery_" + std::to_string( i ) ) ) );
    }
 
    chain_database::~chain_database()
@@ -1051,6 +1723,16 @@ namespace bts { namespace blockchain {
    void chain_database::open( const fc::path& data_dir, fc::optional<fc::path> genesis_file, std::function<void(float)> reindex_status_callback )
    { try {
       bool must_rebuild_index = !fc::exists( data_dir / "index" );
+      if( fc::exists( data_dir / "index/bulk_write_in_progress" ) )
+      {
+         wlog( "database was closed during a bulk write, rebuilding index" );
+         must_rebuild_index = true;
+      }
+      if( fc::is_directory( data_dir / "raw_chain/id_to_data_orig" ) )
+      {
+         wlog( "previous re-index did not complete, rebuilding index" );
+         must_rebuild_index = true;
+      }
       std::exception_ptr error_opening_database;
       try
       {
@@ -1088,20 +1770,16 @@ namespace bts { namespace blockchain {
 
              //During reindexing we implement stop-and-copy garbage collection on the raw chain
              decltype(my->_block_id_to_block_data_db) id_to_data_orig;
-             id_to_data_orig.open( data_dir / "raw_chain/id_to_data_orig" );
+             id_to_data_orig.open( data_dir / "raw_chain/id_to_data_orig", my->get_database_options( "_block_id_to_block_data_db" ) );
              auto orig_chain_size = fc::directory_size( data_dir / "raw_chain/id_to_data_orig" );
 
              my->open_database( data_dir );
 
-             // TODO: This was causing sync failures after re-indexing
-             //For the duration of reindexing, we allow certain databases to postpone flushing until we finish.
-             //my->_account_db.set_flush_on_store( false );
-             //my->_address_to_account_db.set_flush_on_store( false );
-             //my->_account_index_db.set_flush_on_store( false );
-             //my->_delegate_vote_index_db.set_flush_on_store( false );
-
              my->initialize_genesis( genesis_file );
 
+             // Group the index writes of many blocks into a single commit per database
+             set_bulk_write_mode( BTS_BLOCKCHAIN_BULK_WRITE_BLOCKS );
+
              map<uint32_t, block_id_type> num_to_id;
              for (auto itr = my->_block_num_to_id_db.begin(); itr.valid(); ++itr)
                  num_to_id[itr.key()] = itr.value();
@@ -1116,48 +1794,126 @@ namespace bts { namespace blockchain {
              auto genesis_time = get_genesis_timestamp();
              auto start_time = blockchain::now();
 
-             auto insert_block = [&](const full_block& block) {
-                 if( blocks_indexed % 200 == 0 ) {
-                     float progress;
-                     if (total_blocks)
-                         progress = blocks_indexed / total_blocks;
-                     else
-                         progress = float(blocks_indexed*BTS_BLOCKCHAIN_BLOCK_INTERVAL_SEC) / (start_time - genesis_time).to_seconds();
-                     progress *= 100;
-
-                     if( !reindex_status_callback )
-                         std::cout << "\rRe-indexing database... "
-                                      "Approximately " << std::setprecision(2) << progress << "% complete." << std::flush;
-                     else
-                         reindex_status_callback(progress);
+             // Reindexing is pipelined in batches: while one batch is applied on this thread, the next
+             // batch has its signing keys recovered and the one after that is read and unpacked from
+             // the raw chain.  Only the apply stage has to run in order.
+             const size_t reindex_batch_size = 200;
+             struct reindex_batch
+             {
+                vector<full_block>                    blocks;
+                vector<optional<block_signee_data>>   signees;
+                fc::microseconds                      read_time;
+                fc::microseconds                      verify_time;
+             };
+
+             fc::microseconds read_time;
+             fc::microseconds verify_time;
+             fc::microseconds apply_time;
+             auto blocks_per_second = [&]( const fc::microseconds& elapsed ) -> uint64_t
+             {
+                 if( elapsed.count() <= 0 ) return 0;
+                 return uint64_t( blocks_indexed * 1000000.0 / elapsed.count() );
+             };
+
+             auto report_progress = [&]() {
+                 float progress;
+                 if (total_blocks)
+                     progress = blocks_indexed / total_blocks;
+                 else
+                     progress = float(blocks_indexed*BTS_BLOCKCHAIN_BLOCK_INTERVAL_SEC) / (start_time - genesis_time).to_seconds();
+                 progress *= 100;
+
+                 if( !reindex_status_callback )
+                     std::cout << "\rRe-indexing database... "
+                                  "Approximately " << std::setprecision(2) << progress << "% complete. "
+                                  "Blocks/sec read: " << blocks_per_second( read_time )
+                               << ", verify: " << blocks_per_second( verify_time )
+                               << ", apply: " << blocks_per_second( apply_time ) << "   " << std::flush;
+                 else
+                     reindex_status_callback(progress);
+             };
+
+             auto block_itr = id_to_data_orig.begin();
+             auto num_id_itr = num_to_id.begin();
+             auto read_batch = [&]() -> reindex_batch {
+                 const auto stage_start = time_point::now();
+                 reindex_batch batch;
+                 batch.blocks.reserve( reindex_batch_size );
+                 if (num_to_id.empty()) {
+                     for( ; block_itr.valid() && batch.blocks.size() < reindex_batch_size; ++block_itr )
+                         batch.blocks.push_back( block_itr.value() );
+                 }
+                 else
+                 {
+                     for( ; num_id_itr != num_to_id.end() && batch.blocks.size() < reindex_batch_size; ++num_id_itr ) {
+                         auto oblock = id_to_data_orig.fetch_optional(num_id_itr->second);
+                         if (oblock)
+                             batch.blocks.push_back( std::move( *oblock ) );
+                     }
                  }
+                 batch.read_time = time_point::now() - stage_start;
+                 return batch;
+             };
 
-                 push_block(block);
-                 ++blocks_indexed;
+             auto verify_batch = [&]( reindex_batch& batch ) {
+                 const auto stage_start = time_point::now();
+                 batch.signees = my->recover_signees( batch.blocks, !my->_skip_signature_verification );
+                 batch.verify_time = time_point::now() - stage_start;
              };
 
-             if (num_to_id.empty()) {
-                 auto block_itr = id_to_data_orig.begin();
-                 while( block_itr.valid() ) {
-                     insert_block(block_itr.value());
-                     ++block_itr;
+             reindex_batch             verifying_batch;
+             fc::future<void>          verifying;
+             fc::future<reindex_batch> reading;
+
+             // declared after the batch and futures the stages write to, so the threads are joined first on unwind
+             fc::thread reindex_read_thread( "reindex_read" );
+             fc::thread reindex_verify_thread( "reindex_verify" );
+
+             // an exception from push_block must not unwind while a stage is still writing to verifying_batch
+             auto wait_for_stages = [&]()
+             {
+                 try { if( verifying.valid() ) verifying.wait(); } catch( ... ) {}
+                 try { if( reading.valid() ) reading.wait(); } catch( ... ) {}
+             };
+
+             try
+             {
+                 verifying_batch = reindex_read_thread.async( read_batch, "reindex_read_batch" ).wait();
+                 verifying = reindex_verify_thread.async( [&](){ verify_batch( verifying_batch ); }, "reindex_verify_batch" );
+                 reading = reindex_read_thread.async( read_batch, "reindex_read_batch" );
+
+                 while( !verifying_batch.blocks.empty() )
+                 {
+                     verifying.wait();
+                     reindex_batch applying_batch = std::move( verifying_batch );
+
+                     verifying_batch = reading.wait();
+                     verifying = reindex_verify_thread.async( [&](){ verify_batch( verifying_batch ); }, "reindex_verify_batch" );
+                     reading = reindex_read_thread.async( read_batch, "reindex_read_batch" );
+
+                     read_time += applying_batch.read_time;
+                     verify_time += applying_batch.verify_time;
+                     report_progress();
+
+                     const auto apply_start = time_point::now();
+                     for( size_t i = 0; i < applying_batch.blocks.size(); ++i )
+                     {
+                         my->push_block( applying_batch.blocks[ i ], applying_batch.signees[ i ] );
+                         my->bulk_write_block_pushed();
+                         ++blocks_indexed;
+                     }
+                     apply_time += time_point::now() - apply_start;
                  }
+                 verifying.wait();
+                 reading.wait();
              }
-             else
+             catch( ... )
              {
-                 for (const auto& num_id : num_to_id) {
-                     auto oblock = id_to_data_orig.fetch_optional(num_id.second);
-                     if (oblock)
-                         insert_block(*oblock);
-                 }
+                 wait_for_stages();
+                 throw;
              }
 
-             // TODO: See above
-             //Re-enable flushing on all databases we disabled it on above
-             //my->_account_db.set_flush_on_store( true );
-             //my->_address_to_account_db.set_flush_on_store( true );
-             //my->_account_index_db.set_flush_on_store( true );
-             //my->_delegate_vote_index_db.set_flush_on_store( true );
+             set_bulk_write_mode( 0 );
 
              id_to_data_orig.close();
              fc::remove_all( data_dir / "raw_chain/id_to_data_orig" );
@@ -1168,6 +1924,9 @@ namespace bts { namespace blockchain {
                                                                            "\nBlockchain size changed from "
                        << orig_chain_size / 1024 / 1024 << "MiB to "
                        << final_chain_size / 1024 / 1024 << "MiB.\n" << std::flush;
+             ilog( "reindexed ${n} blocks, blocks/sec read: ${read}, verify: ${verify}, apply: ${apply}",
+                   ("n",blocks_indexed)("read",blocks_per_second( read_time ))
+                   ("verify",blocks_per_second( verify_time ))("apply",blocks_per_second( apply_time )) );
           }
           const auto db_chain_id = get_property( bts::blockchain::chain_id ).as<digest_type>();
           const auto genesis_chain_id = my->initialize_genesis( genesis_file, true );
@@ -1178,6 +1937,8 @@ namespace bts { namespace blockchain {
           //  process the pending transactions to cache by fees
           auto pending_itr = my->_pending_transaction_db.begin();
           wlog( "loading pending trx..." );
+          // revalidate_pending() only finds pending transactions through their evaluation state, so the invalid ones are dropped here
+          vector<transaction_id_type> invalid_pending_trx_ids;
           while( pending_itr.valid() )
           {
              try {
@@ -1192,9 +1953,12 @@ namespace bts { namespace blockchain {
              catch ( const fc::exception& e )
              {
                 wlog( "error processing pending transaction: ${e}", ("e",e.to_detail_string() ) );
+                invalid_pending_trx_ids.push_back( pending_itr.key() );
              }
              ++pending_itr;
           }
+          for( const auto& trx_id : invalid_pending_trx_ids )
+             my->_pending_transaction_db.remove( trx_id );
       }
       catch (...)
       {
@@ -1213,47 +1977,13 @@ namespace bts { namespace blockchain {
 
    void chain_database::close()
    { try {
-      my->_market_transactions_db.close();
-      my->_fork_number_db.close();
-      my->_fork_db.close();
-      my->_slate_db.close();
-      my->_property_db.close();
-#if 0
-      my->_proposal_db.close();
-      my->_proposal_vote_db.close();
-#endif
+      if( my->_bulk_write_blocks )
+         set_bulk_write_mode( 0 );
 
-      my->_undo_state_db.close();
+      my->close_index_database();
 
       my->_block_num_to_id_db.close();
-      my->_block_id_to_block_record_db.close();
       my->_block_id_to_block_data_db.close();
-      my->_id_to_transaction_record_db.close();
-
-      my->_pending_transaction_db.close();
-
-      my->_asset_db.close();
-      my->_balance_db.close();
-      my->_burn_db.close();
-      my->_account_db.close();
-      my->_address_to_account_db.close();
-
-      my->_account_index_db.close();
-      my->_symbol_index_db.close();
-      my->_delegate_vote_index_db.close();
-
-      my->_slot_record_db.close();
-
-      my->_ask_db.close();
-      my->_bid_db.close();
-      my->_relative_ask_db.close();
-      my->_relative_bid_db.close();
-      my->_short_db.close();
-      my->_collateral_db.close();
-      my->_feed_db.close();
-
-      my->_market_history_db.close();
-      my->_market_status_db.close();
    } FC_RETHROW_EXCEPTIONS( warn, "" ) }
 
    account_record chain_database::get_delegate_record_for_signee( const public_key_type& block_signee )const
@@ -1310,25 +2040,9 @@ namespace bts { namespace blockchain {
    } FC_CAPTURE_AND_RETHROW( (delegate_ids) ) }
 
    transaction_evaluation_state_ptr chain_database::evaluate_transaction( const signed_transaction& trx, const share_type& required_fees )
-   { try {
-      if( !my->_pending_trx_state )
-         my->_pending_trx_state = std::make_shared<pending_chain_state>( shared_from_this() );
-
-      pending_chain_state_ptr          pend_state = std::make_shared<pending_chain_state>(my->_pending_trx_state);
-      transaction_evaluation_state_ptr trx_eval_state = std::make_shared<transaction_evaluation_state>(pend_state.get(), my->_chain_id);
-
-      trx_eval_state->evaluate( trx );
-      auto fees = trx_eval_state->get_fees() + trx_eval_state->alt_fees_paid.amount;
-      if( fees < required_fees )
-      {
-          wlog("Transaction ${id} needed relay fee ${required_fees} but only had ${fees}", ("id", trx.id())("required_fees",required_fees)("fees",fees));
-          FC_CAPTURE_AND_THROW( insufficient_relay_fee, (fees)(required_fees) );
-      }
-      // apply changes from this transaction to _pending_trx_state
-      pend_state->apply_changes();
-
-      return trx_eval_state;
-   } FC_CAPTURE_AND_RETHROW( (trx) ) }
+   {
+      return my->evaluate_transaction( trx, required_fees, optional<vector<public_key_type>>() );
+   }
 
    optional<fc::exception> chain_database::get_transaction_error( const signed_transaction& transaction, const share_type& min_fee )
    { try {
@@ -1418,6 +2132,17 @@ namespace bts { namespace blockchain {
       return get_block( block_id );
    } FC_RETHROW_EXCEPTIONS( warn, "", ("block_num",block_num) ) }
 
+   vector<char> chain_database::get_packed_block( const block_id_type& block_id )const
+   { try {
+      return my->_block_id_to_block_data_db.fetch_raw( block_id );
+   } FC_CAPTURE_AND_RETHROW( (block_id) ) }
+
+   vector<char> chain_database::get_packed_block( uint32_t block_num )const
+   { try {
+      auto block_id = my->_block_num_to_id_db.fetch( block_num );
+      return get_packed_block( block_id );
+   } FC_RETHROW_EXCEPTIONS( warn, "", ("block_num",block_num) ) }
+
    signed_block_header chain_database::get_head_block()const
    {
       return my->_head_block_header;
@@ -1438,59 +2163,15 @@ namespace bts { namespace blockchain {
                            ("new_block_hash", block_data.id())("new_block_num", block_data.block_num)
                            ("head_block_num", get_head_block_num())("undo_history", BTS_BLOCKCHAIN_MAX_UNDO_HISTORY));
 
-      // only allow a single fiber attempt to push blocks at any given time,
-      // this method is not re-entrant.
-      fc::unique_lock<fc::mutex> lock( my->_push_block_mutex );
-
-      // The above check probably isn't enough.  We need to make certain that
-      // no other code sees the chain_database in an inconsistent state.
-      // The lock above prevents two push_blocks from happening at the same time,
-      // but we also need to ensure the wallet, blockchain, delegate, &c. loops don't
-      // see partially-applied blocks
-      ASSERT_TASK_NOT_PREEMPTED();
-
-      auto processing_start_time = time_point::now();
-      auto block_id = block_data.id();
-      auto current_head_id = my->_head_block_id;
-
-      std::pair<block_id_type, block_fork_data> longest_fork = my->store_and_index( block_id, block_data );
-      optional<block_fork_data> new_fork_data = get_block_fork_data(block_id);
-      FC_ASSERT(new_fork_data, "can't get fork data for a block we just successfully pushed");
-
-      //ilog( "previous ${p} ==? current ${c}", ("p",block_data.previous)("c",current_head_id) );
-      if( block_data.previous == current_head_id )
-      {
-         // attempt to extend chain
-         my->extend_chain( block_data );
-         new_fork_data = get_block_fork_data(block_id);
-         FC_ASSERT(new_fork_data, "can't get fork data for a block we just successfully pushed");
-      }
-      else if( longest_fork.second.can_link() &&
-               my->_block_id_to_block_record_db.fetch(longest_fork.first).block_num > my->_head_block_header.block_num )
-      {
-         try {
-            my->switch_to_fork( longest_fork.first );
-            new_fork_data = get_block_fork_data(block_id);
-            FC_ASSERT(new_fork_data, "can't get fork data for a block we just successfully pushed");
-         }
-         catch ( const fc::canceled_exception& )
-         {
-            throw;
-         }
-         catch ( const fc::exception& e )
-         {
-            wlog( "attempt to switch to fork failed: ${e}, reverting", ("e",e.to_detail_string() ) );
-            my->switch_to_fork( current_head_id );
-         }
-      }
-
-      /* Store processing time */
-      auto record = get_block_record( block_id );
-      FC_ASSERT( record.valid() );
-      record->processing_time = time_point::now() - processing_start_time;
-      my->_block_id_to_block_record_db.store( block_id, *record );
+      // Recover the block and transaction signing keys in parallel while we are still allowed to
+      // yield, extend_chain() consumes them instead of recovering each key in turn
+      optional<block_signee_data> signees;
+      if( !my->is_before_last_checkpoint( block_data.block_num ) )
+         signees = my->recover_signees( block_data, !my->_skip_signature_verification );
 
-      return *new_fork_data;
+      const auto fork_data = my->push_block( block_data, signees );
+      my->bulk_write_block_pushed();
+      return fork_data;
    } FC_CAPTURE_AND_RETHROW( (block_data) )  }
 
   std::vector<block_id_type> chain_database::get_fork_history( const block_id_type& id )
@@ -1593,14 +2274,33 @@ namespace bts { namespace blockchain {
           my->_balance_db.store( r.id(), r );
        }
 #endif
+       const obalance_record prev_record = my->_balance_db.fetch_optional( r.id() );
+       const share_type prev_balance = prev_record.valid() ? prev_record->balance : 0;
+       my->adjust_asset_totals( r.asset_id(), r.balance - prev_balance );
+
        /* Currently we keep all balance records forever so we know the owner and asset ID on wallet rescan */
        my->_balance_db.store( r.id(), r );
 
+       /* The id is derived from the condition so the owners never change, they are indexed when the record is
+        * first stored and stay indexed because the record is never removed */
+       if( !prev_record.valid() )
+       {
+          for( const auto& owner : r.owners() )
+             my->_address_to_balance_db.store( std::make_pair( owner, r.id() ), 0 );
+       }
+
    } FC_RETHROW_EXCEPTIONS( warn, "", ("record", r) ) }
 
    void chain_database::store_account_record( const account_record& record_to_store )
    { try {
        const oaccount_record prev_account_record = get_account_record( record_to_store.id );
+
+       share_type pay_balance_delta = 0;
+       if( prev_account_record.valid() && prev_account_record->is_delegate() )
+           pay_balance_delta -= prev_account_record->delegate_info->pay_balance;
+       if( !record_to_store.is_null() && record_to_store.is_delegate() )
+           pay_balance_delta += record_to_store.delegate_info->pay_balance;
+       my->adjust_asset_totals( asset_id_type( 0 ), pay_balance_delta );
        if( prev_account_record.valid() )
        {
            if( prev_account_record->is_delegate() )
@@ -1744,7 +2444,28 @@ namespace bts { namespace blockchain {
    }
 
    /** this should throw if the trx is invalid */
+   optional<vector<public_key_type>> chain_database::prevalidate_transaction( const signed_transaction& trx )
+   { try {
+      const size_t trx_size = fc::raw::pack_size( trx );
+      if( trx_size > BTS_BLOCKCHAIN_MAX_BLOCK_SIZE )
+         FC_CAPTURE_AND_THROW( oversized_transaction, (trx_size) );
+
+      transaction_evaluation_state::validate_expiration( trx, now() );
+
+      if( trx.signatures.empty() )
+         FC_CAPTURE_AND_THROW( missing_signature, (trx.signatures) );
+
+      return my->recover_signees( signed_transactions{ trx } ).front();
+   } FC_CAPTURE_AND_RETHROW( (trx) ) }
+
    transaction_evaluation_state_ptr chain_database::store_pending_transaction( const signed_transaction& trx, bool override_limits )
+   {
+      // a single transaction is not worth a round trip to the signature recovery threads, evaluation recovers its signees
+      return store_pending_transaction( trx, override_limits, optional<vector<public_key_type>>() );
+   }
+
+   transaction_evaluation_state_ptr chain_database::store_pending_transaction( const signed_transaction& trx, bool override_limits,
+                                                                               const optional<vector<public_key_type>>& signees )
    { try {
       auto trx_id = trx.id();
       if (override_limits)
@@ -1764,7 +2485,7 @@ namespace bts { namespace blockchain {
          }
       }
 
-      transaction_evaluation_state_ptr eval_state = evaluate_transaction( trx, relay_fee );
+      transaction_evaluation_state_ptr eval_state = my->evaluate_transaction( trx, relay_fee, signees );
       share_type fees = eval_state->get_fees();
 
       //if( fees < my->_relay_fee )
@@ -1787,6 +2508,23 @@ namespace bts { namespace blockchain {
       return trxs;
    }
 
+   vector<transaction_id_type> chain_database::get_pending_transaction_ids()const
+   {
+      vector<transaction_id_type> trx_ids;
+      trx_ids.reserve( my->_pending_transaction_states.size() );
+      for( const auto& item : my->_pending_transaction_states )
+          trx_ids.push_back( item.first );
+      return trx_ids;
+   }
+
+   optional<signed_transaction> chain_database::get_pending_transaction( const transaction_id_type& trx_id )const
+   {
+      const auto itr = my->_pending_transaction_states.find( trx_id );
+      if( itr == my->_pending_transaction_states.end() )
+          return optional<signed_transaction>();
+      return itr->second.eval_state->trx;
+   }
+
    full_block chain_database::generate_block( const time_point_sec& timestamp )
    { try {
       auto start_time = time_point::now();
@@ -1806,25 +2544,26 @@ namespace bts { namespace blockchain {
          if( block_size + trx_size > BTS_BLOCKCHAIN_MAX_BLOCK_SIZE ) break;
          block_size += trx_size;
 
-         /* Make modifications to temporary state */
-         auto pending_trx_state = std::make_shared<pending_chain_state>( pending_state );
-         auto trx_eval_state = std::make_shared<transaction_evaluation_state>( pending_trx_state.get(), my->_chain_id );
+         /* Make modifications directly to the block state, they are undone if the transaction fails */
+         auto trx_eval_state = std::make_shared<transaction_evaluation_state>( pending_state.get(), my->_chain_id );
+         pending_state->begin_nested();
 
          try
          {
             trx_eval_state->evaluate( item->trx );
             // TODO: what about fees in other currencies?
             total_fees += trx_eval_state->get_fees( 0 );
-            /* Apply temporary state to block state */
-            pending_trx_state->apply_changes();
+            pending_state->commit_nested();
             next_block.user_transactions.push_back( item->trx );
          }
          catch ( const fc::canceled_exception& )
          {
+            pending_state->undo_nested();
             throw;
          }
          catch( const fc::exception& e )
          {
+            pending_state->undo_nested();
             wlog( "Pending transaction was found to be invalid in context of block\n ${trx} \n${e}",
                   ("trx",fc::json::to_pretty_string(item->trx))("e",e.to_detail_string()) );
          }
@@ -1904,33 +2643,52 @@ namespace bts { namespace blockchain {
         return balances;
     } FC_RETHROW_EXCEPTIONS( warn, "", ("first",first)("limit",limit) )  }
 
-    vector<balance_record> chain_database::get_balances_for_address( const address& addr )const
-    {
+    vector<balance_record> chain_database::get_balances_for_address( const address& addr, const balance_id_type& first,
+                                                                     uint32_t limit )const
+    { try {
         vector<balance_record> ret;
-        for( auto pair : get_balances( "", -1 ) )
+        for( auto itr = my->_address_to_balance_db.lower_bound( std::make_pair( addr, first ) ); itr.valid(); ++itr )
         {
-            auto bal = pair.second;
-            if( bal.is_owner( addr ) )
-            {
-                ret.push_back(bal);
-            }
+            if( ret.size() >= limit )
+                break;
+
+            const auto key = itr.key();
+            if( key.first != addr )
+                break;
+
+            const obalance_record bal = my->_balance_db.fetch_optional( key.second );
+            if( bal.valid() )
+                ret.push_back( *bal );
         }
         return ret;
-    }
+    } FC_CAPTURE_AND_RETHROW( (addr)(first)(limit) ) }
+
+    vector<balance_record> chain_database::get_balances_for_key( const public_key_type& key, const balance_id_type& first,
+                                                                 uint32_t limit )const
+    { try {
+        /* The same addresses that balance_record::is_owner() accepts for a key */
+        const vector<address> owners{ address( key ),
+                                      address( pts_address( key, false, 56 ) ),
+                                      address( pts_address( key, true, 56 ) ),
+                                      address( pts_address( key, false, 0 ) ),
+                                      address( pts_address( key, true, 0 ) ) };
+
+        map<balance_id_type, balance_record> balances;
+        for( const auto& owner : owners )
+        {
+            for( const auto& bal : get_balances_for_address( owner, first, limit ) )
+                balances[ bal.id() ] = bal;
+        }
 
-    vector<balance_record> chain_database::get_balances_for_key( const public_key_type& key )const
-    {
         vector<balance_record> ret;
-        for( auto pair : get_balances( "", -1 ) )
+        for( const auto& item : balances )
         {
-            auto bal = pair.second;
-            if( bal.is_owner(key) )
-            {
-                ret.push_back( bal );
-            }
+            if( ret.size() >= limit )
+                break;
+            ret.push_back( item.second );
         }
         return ret;
-    }
+    } FC_CAPTURE_AND_RETHROW( (key)(first)(limit) ) }
 
 
     std::vector<account_record> chain_database::get_accounts( const string& first, uint32_t limit )const
@@ -2294,8 +3052,21 @@ namespace bts { namespace blockchain {
       return my->_collateral_db.fetch_optional(key);
    }
 
+   /** the change in the balance of an order, used to keep the asset totals up to date */
+   static share_type order_balance_delta( const oorder_record& prev_order, const order_record& order )
+   {
+      const share_type prev_balance = prev_order.valid() ? prev_order->balance : 0;
+      return order.balance - prev_balance;
+   }
+
    void chain_database::store_bid_record( const market_index_key& key, const order_record& order )
    {
+      const oorder_record prev_order = my->_bid_db.fetch_optional( key );
+      if( key.order_price.quote_asset_id != asset_id_type( 0 ) )
+         my->adjust_asset_totals( key.order_price.quote_asset_id, order_balance_delta( prev_order, order ) );
+
+      my->index_market_order( bid_order, key, prev_order.valid(), order.is_null() );
+
       if( order.is_null() )
          my->_bid_db.remove( key );
       else
@@ -2303,6 +3074,12 @@ namespace bts { namespace blockchain {
    }
    void chain_database::store_relative_bid_record( const market_index_key& key, const order_record& order )
    {
+      const oorder_record prev_order = my->_relative_bid_db.fetch_optional( key );
+      if( key.order_price.quote_asset_id != asset_id_type( 0 ) )
+         my->adjust_asset_totals( key.order_price.quote_asset_id, order_balance_delta( prev_order, order ) );
+
+      my->index_market_order( relative_bid_order, key, prev_order.valid(), order.is_null() );
+
       if( order.is_null() )
          my->_relative_bid_db.remove( key );
       else
@@ -2311,6 +3088,11 @@ namespace bts { namespace blockchain {
 
    void chain_database::store_ask_record( const market_index_key& key, const order_record& order )
    {
+      const oorder_record prev_order = my->_ask_db.fetch_optional( key );
+      my->adjust_asset_totals( key.order_price.base_asset_id, order_balance_delta( prev_order, order ) );
+
+      my->index_market_order( ask_order, key, prev_order.valid(), order.is_null() );
+
       if( order.is_null() )
          my->_ask_db.remove( key );
       else
@@ -2319,6 +3101,11 @@ namespace bts { namespace blockchain {
 
    void chain_database::store_relative_ask_record( const market_index_key& key, const order_record& order )
    {
+      const oorder_record prev_order = my->_relative_ask_db.fetch_optional( key );
+      my->adjust_asset_totals( key.order_price.base_asset_id, order_balance_delta( prev_order, order ) );
+
+      my->index_market_order( relative_ask_order, key, prev_order.valid(), order.is_null() );
+
       if( order.is_null() )
          my->_relative_ask_db.remove( key );
       else
@@ -2327,6 +3114,11 @@ namespace bts { namespace blockchain {
 
    void chain_database::store_short_record( const market_index_key& key, const order_record& order )
    {
+      const oorder_record prev_order = my->_short_db.fetch_optional( key );
+      my->adjust_asset_totals( asset_id_type( 0 ), order_balance_delta( prev_order, order ) );
+
+      my->index_market_order( short_order, key, prev_order.valid(), order.is_null() );
+
       if( order.is_null() )
          my->_short_db.remove( key );
       else
@@ -2335,6 +3127,13 @@ namespace bts { namespace blockchain {
 
    void chain_database::store_collateral_record( const market_index_key& key, const collateral_record& collateral )
    {
+      const ocollateral_record prev_collateral = my->_collateral_db.fetch_optional( key );
+      const collateral_record prev = prev_collateral.valid() ? *prev_collateral : collateral_record();
+      my->adjust_asset_totals( asset_id_type( 0 ), collateral.collateral_balance - prev.collateral_balance );
+      my->adjust_asset_totals( key.order_price.quote_asset_id, 0, collateral.payoff_balance - prev.payoff_balance );
+
+      my->index_market_order( cover_order, key, prev_collateral.valid(), collateral.is_null() );
+
       if( collateral.is_null() )
          my->_collateral_db.remove( key );
       else
@@ -2388,6 +3187,21 @@ namespace bts { namespace blockchain {
       FC_ASSERT( ar.valid() );
       FC_ASSERT( ar->current_share_supply == total.amount, "", ("ar",ar)("total",total)("delta",ar->current_share_supply-total.amount) );
       FC_ASSERT( ar->current_share_supply <= ar->maximum_share_supply );
+
+      const auto scanned_totals = my->scan_asset_totals();
+      for( auto itr = my->_asset_totals_db.begin(); itr.valid(); ++itr )
+      {
+         const auto scanned = scanned_totals.find( itr.key() );
+         const asset_totals expected = scanned != scanned_totals.end() ? scanned->second : asset_totals();
+         FC_ASSERT( itr.value().supply == expected.supply && itr.value().debt == expected.debt,
+                    "Running totals do not match the records", ("asset_id",itr.key())("totals",itr.value())("expected",expected) );
+      }
+      for( const auto& item : scanned_totals )
+      {
+         if( item.second.supply == 0 && item.second.debt == 0 ) continue;
+         FC_ASSERT( my->_asset_totals_db.fetch_optional( item.first ).valid(),
+                    "Running totals are missing", ("asset_id",item.first)("expected",item.second) );
+      }
       //std::cerr << "Total Balances: " << to_pretty_asset( total ) << "\n";
    } FC_RETHROW_EXCEPTIONS( warn, "" ) }
 
@@ -2682,118 +3496,55 @@ namespace bts { namespace blockchain {
        return results;
    } FC_CAPTURE_AND_RETHROW( (quote_symbol)(base_symbol)(limit) ) }
 
-   vector<market_order> chain_database::get_market_orders( std::function<bool( const market_order& )> filter,
-                                                           uint32_t limit, order_type_enum type )const
+   optional<market_order> chain_database::get_market_order( const order_id_type& order_id, order_type_enum type )const
    { try {
-       vector<market_order> orders;
-       if( limit == 0 ) return orders;
+       const auto index = my->_order_index_db.fetch_optional( order_id );
+       if( !index.valid() )
+           return optional<market_order>();
 
-       if( type == null_order || type == ask_order )
-       {
-           for( auto itr = my->_ask_db.begin(); itr.valid(); ++itr )
-           {
-               const auto order = market_order( ask_order, itr.key(), itr.value() );
-               if( filter( order ) )
-               {
-                   orders.push_back( order );
-                   if( orders.size() >= limit )
-                       return orders;
-               }
-           }
-       }
-
-       if( type == null_order || type == bid_order )
-       {
-           for( auto itr = my->_bid_db.begin(); itr.valid(); ++itr )
-           {
-               const auto order = market_order( bid_order, itr.key(), itr.value() );
-               if( filter( order ) )
-               {
-                   orders.push_back( order );
-                   if( orders.size() >= limit )
-                       return orders;
-               }
-           }
-       }
+       if( type != null_order && type != order_type_enum( index->type ) )
+           return optional<market_order>();
 
-       if( type == null_order || type == relative_ask_order )
-       {
-           for( auto itr = my->_relative_ask_db.begin(); itr.valid(); ++itr )
-           {
-               const auto order = market_order( relative_ask_order, itr.key(), itr.value() );
-               if( filter( order ) )
-               {
-                   orders.push_back( order );
-                   if( orders.size() >= limit )
-                       return orders;
-               }
-           }
-       }
+       return my->fetch_market_order( index->type, index->market_index );
+   } FC_CAPTURE_AND_RETHROW( (order_id)(type) ) }
 
-       if( type == null_order || type == relative_bid_order )
+   vector<market_order> chain_database::get_market_orders_for_owner( const address& owner, uint32_t limit, order_type_enum type )const
+   { try {
+       vector<market_order> orders;
+       for( auto itr = my->_owner_to_order_id_db.lower_bound( std::make_pair( owner, order_id_type() ) ); itr.valid(); ++itr )
        {
-           for( auto itr = my->_relative_bid_db.begin(); itr.valid(); ++itr )
-           {
-               const auto order = market_order( relative_bid_order, itr.key(), itr.value() );
-               if( filter( order ) )
-               {
-                   orders.push_back( order );
-                   if( orders.size() >= limit )
-                       return orders;
-               }
-           }
-       }
+           if( orders.size() >= limit )
+               break;
 
-       if( type == null_order || type == short_order )
-       {
-           for( auto itr = my->_short_db.begin(); itr.valid(); ++itr )
-           {
-               const auto order = market_order( short_order, itr.key(), itr.value() );
-               if( filter( order ) )
-               {
-                   orders.push_back( order );
-                   if( orders.size() >= limit )
-                       return orders;
-               }
-           }
-       }
+           const auto key = itr.key();
+           if( key.first != owner )
+               break;
 
-       if( type == null_order || type == cover_order ) {
-           for( auto itr = my->_collateral_db.begin(); itr.valid(); ++itr )
-           {
-               const auto collateral_rec = itr.value();
-               const auto order_rec = order_record( collateral_rec.payoff_balance );
-               const auto order = market_order( cover_order,
-                                                itr.key(),
-                                                order_rec,
-                                                collateral_rec.collateral_balance,
-                                                collateral_rec.interest_rate,
-                                                collateral_rec.expiration );
-               if( filter( order ) )
-               {
-                   orders.push_back( order );
-                   if( orders.size() >= limit )
-                       return orders;
-               }
-           }
+           const auto order = get_market_order( key.second, type );
+           if( order.valid() )
+               orders.push_back( *order );
        }
-
        return orders;
-   } FC_RETHROW_EXCEPTIONS( warn, "" ) }
+   } FC_CAPTURE_AND_RETHROW( (owner)(limit)(type) ) }
 
-   optional<market_order> chain_database::get_market_order( const order_id_type& order_id, order_type_enum type )const
+   vector<market_order> chain_database::get_market_orders( std::function<bool( const market_order& )> filter,
+                                                           uint32_t limit, order_type_enum type )const
    { try {
-       const auto filter = [&]( const market_order& order ) -> bool
-       {
-           return order.get_id() == order_id;
-       };
+       return my->scan_market_orders( optional<std::pair<asset_id_type, asset_id_type>>(), filter, limit, type );
+   } FC_CAPTURE_AND_RETHROW( (limit)(type) ) }
 
-       const auto orders = get_market_orders( filter, 1, type );
-       if( !orders.empty() )
-           return orders.front();
+   vector<market_order> chain_database::get_market_orders( const asset_id_type& quote_id, const asset_id_type& base_id,
+                                                           std::function<bool( const market_order& )> filter,
+                                                           uint32_t limit, order_type_enum type )const
+   { try {
+       return my->scan_market_orders( std::make_pair( quote_id, base_id ), filter, limit, type );
+   } FC_CAPTURE_AND_RETHROW( (quote_id)(base_id)(limit)(type) ) }
 
-       return optional<market_order>();
-   } FC_RETHROW_EXCEPTIONS( warn, "" ) }
+   vector<market_order> chain_database::get_market_orders_for_pair( const asset_id_type& quote_id, const asset_id_type& base_id,
+                                                                    uint32_t limit, order_type_enum type )const
+   {
+       return get_market_orders( quote_id, base_id, nullptr, limit, type );
+   }
 
    pending_chain_state_ptr chain_database::get_pending_state()const
    {
@@ -2902,6 +3653,30 @@ namespace bts { namespace blockchain {
    {
       return my->_known_transactions.find( id ) != my->_known_transactions.end();
    }
+
+   void chain_database::set_bulk_write_mode( uint32_t blocks_per_commit )
+   { try {
+      if( blocks_per_commit == my->_bulk_write_blocks )
+         return;
+
+      if( my->_bulk_write_blocks == 0 )
+      {
+         my->begin_bulk_write();
+      }
+      else if( blocks_per_commit == 0 )
+      {
+         my->commit_bulk_write();
+         fc::remove( my->_data_dir / "index/bulk_write_in_progress" );
+      }
+
+      my->_bulk_write_blocks = blocks_per_commit;
+   } FC_CAPTURE_AND_RETHROW( (blocks_per_commit) ) }
+
+   void chain_database::set_database_options( const chain_database_options& options )
+   {
+      my->_options = options;
+   }
+
    void chain_database::skip_signature_verification( bool state )
    {
       my->_skip_signature_verification = state;
@@ -3035,109 +3810,44 @@ namespace bts { namespace blockchain {
    }
 
    asset chain_database::calculate_supply( const asset_id_type& asset_id )const
-   {
+   { try {
        const auto record = get_asset_record( asset_id );
        FC_ASSERT( record.valid() );
 
-       // Add fees
+       // Balances, orders, collateral and delegate pay are tracked in _asset_totals_db, fees are in the record
        asset total( record->collected_fees, asset_id );
-
-       // Add balances
-       for( auto balance_itr = my->_balance_db.begin(); balance_itr.valid(); ++balance_itr )
-       {
-           const balance_record balance = balance_itr.value();
-           if( balance.asset_id() == total.asset_id )
-               total.amount += balance.balance;
-       }
-
-       // Add ask balances
-       for( auto ask_itr = my->_ask_db.begin(); ask_itr.valid(); ++ask_itr )
-       {
-           const market_index_key market_index = ask_itr.key();
-           if( market_index.order_price.base_asset_id == total.asset_id )
-           {
-               const order_record ask = ask_itr.value();
-               total.amount += ask.balance;
-           }
-       }
-       for( auto ask_itr = my->_relative_ask_db.begin(); ask_itr.valid(); ++ask_itr )
-       {
-           const market_index_key market_index = ask_itr.key();
-           if( market_index.order_price.base_asset_id == total.asset_id )
-           {
-               const order_record ask = ask_itr.value();
-               total.amount += ask.balance;
-           }
-       }
-
-       // If base asset
-       if( asset_id == asset_id_type( 0 ) )
-       {
-           // Add short balances
-           for( auto short_itr = my->_short_db.begin(); short_itr.valid(); ++short_itr )
-           {
-               const order_record sh = short_itr.value();
-               total.amount += sh.balance;
-           }
-
-           // Add collateral balances
-           for( auto collateral_itr = my->_collateral_db.begin(); collateral_itr.valid(); ++collateral_itr )
-           {
-               const collateral_record collateral = collateral_itr.value();
-               total.amount += collateral.collateral_balance;
-           }
-
-           // Add pay balances
-           for( auto account_itr = my->_account_db.begin(); account_itr.valid(); ++account_itr )
-           {
-               const account_record account = account_itr.value();
-               if( account.delegate_info.valid() )
-                   total.amount += account.delegate_info->pay_balance;
-           }
-       }
-       else // If non-base asset
-       {
-           // Add bid balances
-           for( auto bid_itr = my->_bid_db.begin(); bid_itr.valid(); ++bid_itr )
-           {
-               const market_index_key market_index = bid_itr.key();
-               if( market_index.order_price.quote_asset_id == total.asset_id )
-               {
-                   const order_record bid = bid_itr.value();
-                   total.amount += bid.balance;
-               }
-           }
-           for( auto bid_itr = my->_relative_bid_db.begin(); bid_itr.valid(); ++bid_itr )
-           {
-               const market_index_key market_index = bid_itr.key();
-               if( market_index.order_price.quote_asset_id == total.asset_id )
-               {
-                   const order_record bid = bid_itr.value();
-                   total.amount += bid.balance;
-               }
-           }
-       }
+       const auto totals = my->_asset_totals_db.fetch_optional( asset_id );
+       if( totals.valid() )
+           total.amount += totals->supply;
 
        return total;
-   }
+   } FC_CAPTURE_AND_RETHROW( (asset_id) ) }
 
    asset chain_database::calculate_debt( const asset_id_type& asset_id, bool include_interest )const
-   {
+   { try {
        const auto record = get_asset_record( asset_id );
        FC_ASSERT( record.valid() && record->is_market_issued() );
 
        asset total( 0, asset_id );
+       if( !include_interest )
+       {
+           const auto totals = my->_asset_totals_db.fetch_optional( asset_id );
+           if( totals.valid() )
+               total.amount += totals->debt;
+           return total;
+       }
 
-       for( auto itr = my->_collateral_db.begin(); itr.valid(); ++itr )
+       // Interest depends on the current time so it cannot be tracked, but only this market has to be walked
+       for( auto itr = my->_collateral_db.lower_bound( market_index_key( price( 0, asset_id, asset_id_type( 0 ) ) ) );
+            itr.valid(); ++itr )
        {
            const market_index_key& market_index = itr.key();
-           if( market_index.order_price.quote_asset_id != asset_id ) continue;
+           if( market_index.order_price.quote_asset_id != asset_id ) break;
            FC_ASSERT( market_index.order_price.base_asset_id == asset_id_type( 0 ) );
 
            const collateral_record& record = itr.value();
            const asset principle( record.payoff_balance, asset_id );
            total += principle;
-           if( !include_interest ) continue;
 
            const time_point_sec position_start_time = record.expiration - BTS_BLOCKCHAIN_MAX_SHORT_PERIOD_SEC;
            const uint32_t position_age = (now() - position_start_time).to_seconds();
@@ -3145,7 +3855,7 @@ namespace bts { namespace blockchain {
        }
 
        return total;
-   }
+   } FC_CAPTURE_AND_RETHROW( (asset_id)(include_interest) ) }
 
    asset chain_database::unclaimed_genesis()
    {
@@ -3384,10 +4094,10 @@ namespace bts { namespace blockchain {
      fc::mutable_variant_object stats;
 #define CHAIN_DB_DATABASES (_market_transactions_db)(_slate_db)(_fork_number_db)(_fork_db)(_property_db)(_undo_state_db) \
                            (_block_num_to_id_db)(_block_id_to_block_record_db)(_block_id_to_block_data_db)(_known_transactions) \
-                           (_id_to_transaction_record_db)(_pending_transaction_db)(_pending_fee_index)(_asset_db)(_balance_db) \
+                           (_id_to_transaction_record_db)(_pending_transaction_db)(_pending_fee_index)(_asset_db)(_balance_db)(_address_to_balance_db) \
                            (_burn_db)(_account_db)(_address_to_account_db)(_account_index_db)(_symbol_index_db)(_delegate_vote_index_db) \
                            (_slot_record_db)(_ask_db)(_bid_db)(_short_db)(_collateral_db)(_feed_db)(_market_status_db)(_market_history_db) \
-                           (_recent_operations)
+                           (_asset_totals_db)(_order_index_db)(_owner_to_order_id_db)(_recent_operations)
 #define GET_DATABASE_SIZE(r, data, elem) stats[BOOST_PP_STRINGIZE(elem)] = my->elem.size();
      BOOST_PP_SEQ_FOR_EACH(GET_DATABASE_SIZE, _, CHAIN_DB_DATABASES)
      return stats;
@@ -108,19 +108,37 @@ namespace bts { namespace blockchain {
 
   extended_private_key extended_private_key::child( const fc::sha256& child_idx, derivation_type derivation )const
   { try {
+    if( derivation == public_derivation )
+       return child( child_idx, get_public_key() );
+
     extended_private_key child_key;
 
     fc::sha512::encoder enc;
-    if( derivation == public_derivation )
-    {
-      fc::raw::pack( enc, get_public_key() );
-    }
-    else
-    {
-      uint8_t pad = 0;
-      fc::raw::pack( enc, pad );
-      fc::raw::pack( enc, priv_key );
-    }
+    uint8_t pad = 0;
+    fc::raw::pack( enc, pad );
+    fc::raw::pack( enc, priv_key );
+    fc::raw::pack( enc, child_idx );
+    fc::raw::pack( enc, chain_code );
+    fc::sha512 ikey = enc.result();
+
+    fc::sha256 ikey_left;
+    fc::sha256 ikey_right;
+
+    memcpy( (char*)&ikey_left, (char*)&ikey, sizeof(ikey_left) );
+    memcpy( (char*)&ikey_right, ((char*)&ikey) + sizeof(ikey_left), sizeof(ikey_right) );
+
+    child_key.priv_key  = fc::ecc::private_key::generate_from_seed( priv_key, ikey_left ).get_secret();
+    child_key.chain_code = ikey_right;
+
+    return child_key;
+  } FC_RETHROW_EXCEPTIONS( warn, "child index ${child_idx}", ("child_idx", child_idx ) ) }
+
+  extended_private_key extended_private_key::child( const fc::sha256& child_idx, const fc::ecc::public_key& public_key )const
+  { try {
+    extended_private_key child_key;
+
+    fc::sha512::encoder enc;
+    fc::raw::pack( enc, public_key );
     fc::raw::pack( enc, child_idx );
     fc::raw::pack( enc, chain_code );
     fc::sha512 ikey = enc.result();
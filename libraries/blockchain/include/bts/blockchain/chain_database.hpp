@@ -3,6 +3,9 @@
 #include <bts/blockchain/chain_interface.hpp>
 #include <bts/blockchain/pending_chain_state.hpp>
 
+#include <bts/db/level_database.hpp>
+#include <bts/db/level_map.hpp>
+
 namespace bts { namespace blockchain {
 
    namespace detail { class chain_database_impl; }
@@ -47,6 +50,21 @@ namespace bts { namespace blockchain {
       bool                         is_known; ///< do we know the content of this block
    };
 
+   /** storage tuning for the chain database, read from the client's config.json */
+   struct chain_database_options
+   {
+      chain_database_options();
+
+      /** the shared LevelDB instance that holds all index databases */
+      bts::db::level_database_options                     index_database;
+
+      /**
+       *  Tuning profiles by database name, such as "block_id_to_block_data_db".  The raw chain
+       *  databases use the whole profile, index databases only fill_cache_on_scan.
+       */
+      std::map<std::string, bts::db::level_map_options>   databases;
+   };
+
    struct fork_record
    {
        fork_record()
@@ -118,6 +136,19 @@ namespace bts { namespace blockchain {
           */
          void skip_signature_verification( bool state );
 
+         /**
+          *  While syncing or re-indexing, buffer all database writes in memory and commit them
+          *  every @a blocks_per_commit blocks instead of writing each one as it happens.  Passing
+          *  0 commits anything buffered and returns to writing immediately.
+          *
+          *  The buffered writes are not durable.  If the process dies while bulk write mode is on, the
+          *  whole index is rebuilt from the raw chain the next time the database is opened.
+          */
+         void set_bulk_write_mode( uint32_t blocks_per_commit );
+
+         /** takes effect the next time the database is opened */
+         void set_database_options( const chain_database_options& options );
+
          /**
           * The state of the blockchain after applying all pending transactions.
           */
@@ -130,8 +161,25 @@ namespace bts { namespace blockchain {
           */
          transaction_evaluation_state_ptr         store_pending_transaction( const signed_transaction& trx,
                                                                              bool override_limits = true );
+         /** Same as above, but uses signees already recovered by prevalidate_transaction() */
+         transaction_evaluation_state_ptr         store_pending_transaction( const signed_transaction& trx,
+                                                                             bool override_limits,
+                                                                             const optional<vector<public_key_type>>& signees );
+
+         /**
+          *  Performs the checks that don't depend on chain state (size, expiration window, presence of
+          *  signatures) and recovers the signing keys on the signature recovery threads.  Does not touch
+          *  the database, so transactions can be prevalidated concurrently before being stored.
+          *
+          *  @throws if the transaction can never be valid
+          *  @return the recovered signees, unset if recovery failed
+          */
+         optional<vector<public_key_type>>        prevalidate_transaction( const signed_transaction& trx );
 
          vector<transaction_evaluation_state_ptr> get_pending_transactions()const;
+         /** ids of the pending transactions, cheaper than get_pending_transactions() when only the ids are needed */
+         vector<transaction_id_type>              get_pending_transaction_ids()const;
+         optional<signed_transaction>             get_pending_transaction( const transaction_id_type& trx_id )const;
          bool                                     is_known_transaction( const transaction_id_type& trx_id );
 
          /** Produce a block for the given timeslot, the block is not signed because that is the
@@ -168,6 +216,9 @@ namespace bts { namespace blockchain {
          digest_block                get_block_digest( uint32_t block_num )const;
          full_block                  get_block( const block_id_type& )const;
          full_block                  get_block( uint32_t block_num )const;
+         /** the block as it is stored, fc::raw packed, for passing it along without unpacking it */
+         vector<char>                get_packed_block( const block_id_type& )const;
+         vector<char>                get_packed_block( uint32_t block_num )const;
          vector<transaction_record>  get_transactions_for_block( const block_id_type& )const;
          signed_block_header         get_head_block()const;
          virtual uint32_t            get_head_block_num()const override;
@@ -200,8 +251,13 @@ namespace bts { namespace blockchain {
          map<balance_id_type, balance_record>  get_balances( const string& first,
                                                              uint32_t limit )const;
 
-         vector<balance_record> get_balances_for_address( const address& addr )const;
-         vector<balance_record> get_balances_for_key( const public_key_type& key )const;
+         /** balances owned by @a addr in balance id order, starting at @a first */
+         vector<balance_record> get_balances_for_address( const address& addr,
+                                                          const balance_id_type& first = balance_id_type(),
+                                                          uint32_t limit = -1 )const;
+         vector<balance_record> get_balances_for_key( const public_key_type& key,
+                                                      const balance_id_type& first = balance_id_type(),
+                                                      uint32_t limit = -1 )const;
          vector<account_record>  get_accounts( const string& first,
                                                uint32_t limit )const;
 
@@ -264,9 +320,18 @@ namespace bts { namespace blockchain {
                                                              const string& base_symbol,
                                                              uint32_t limit = uint32_t(-1) );
 
+         optional<market_order>             get_market_order( const order_id_type& order_id, order_type_enum type = null_order )const;
+         vector<market_order>               get_market_orders_for_owner( const address& owner,
+                                                                         uint32_t limit = -1, order_type_enum type = null_order )const;
+         vector<market_order>               get_market_orders_for_pair( const asset_id_type& quote_id, const asset_id_type& base_id,
+                                                                        uint32_t limit = -1, order_type_enum type = null_order )const;
+         /** the orders of every market that pass @a filter, @a limit counts only the orders that pass */
          vector<market_order>               get_market_orders( std::function<bool( const market_order& )> filter,
                                                                uint32_t limit = -1, order_type_enum type = null_order )const;
-         optional<market_order>             get_market_order( const order_id_type& order_id, order_type_enum type = null_order )const;
+         /** the orders of one market pair that pass @a filter, walking only that pair's range of each book */
+         vector<market_order>               get_market_orders( const asset_id_type& quote_id, const asset_id_type& base_id,
+                                                               std::function<bool( const market_order& )> filter,
+                                                               uint32_t limit = -1, order_type_enum type = null_order )const;
 
          void                               scan_assets( function<void( const asset_record& )> callback );
          void                               scan_balances( function<void( const balance_record& )> callback );
@@ -365,4 +430,5 @@ namespace bts { namespace blockchain {
 } } // bts::blockchain
 
 FC_REFLECT( bts::blockchain::block_fork_data, (next_blocks)(is_linked)(is_valid)(invalid_reason)(is_included)(is_known) )
+FC_REFLECT( bts::blockchain::chain_database_options, (index_database)(databases) )
 FC_REFLECT( bts::blockchain::fork_record, (block_id)(signing_delegate)(transaction_count)(latency)(size)(timestamp)(is_valid)(invalid_reason)(is_current_fork) )
@@ -11,6 +11,7 @@
 #include <bts/blockchain/time.hpp>
 
 #include <bts/db/cached_level_map.hpp>
+#include <bts/db/level_database.hpp>
 #include <bts/db/level_map.hpp>
 
 #include <fc/io/fstream.hpp>
@@ -18,6 +19,7 @@
 #include <fc/io/raw_variant.hpp>
 #include <fc/thread/mutex.hpp>
 #include <fc/thread/non_preemptable_scope_check.hpp>
+#include <fc/thread/thread.hpp>
 #include <fc/thread/unique_lock.hpp>
 
 #include <algorithm>
@@ -25,6 +27,8 @@
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <set>
 
 namespace bts { namespace blockchain {
 
@@ -62,25 +66,71 @@ namespace bts { namespace blockchain {
       }
    };
 
+   /** what evaluating a pending transaction read and changed, see chain_database_impl::revalidate_pending() */
+   struct pending_transaction_state
+   {
+      transaction_evaluation_state_ptr   eval_state;
+      pending_chain_state_ptr            changes;      ///< only the changes made by this transaction
+      chain_state_key_set                reads;
+      uint64_t                           sequence = 0; ///< the order the changes were applied to the pending state
+   };
+
+   /**
+    *  Running totals of an asset, updated by the store methods of chain_database as records change
+    *  so that undoing a block reverses them too.
+    */
+   struct asset_totals
+   {
+      share_type   supply = 0; ///< everything counted by calculate_supply() except the collected fees
+      share_type   debt   = 0; ///< the payoff balance of every short position, without interest
+   };
+
+   /** where an open order is stored, see chain_database::get_market_order() */
+   struct market_order_index
+   {
+      fc::enum_type<uint8_t, order_type_enum>   type = null_order;
+      market_index_key                          market_index;
+   };
+
+   /**
+    *  Public keys recovered from the signatures of a block and its transactions before
+    *  the block is applied.  Entries are left unset if recovery failed so that evaluation
+    *  can repeat it and report the error in the usual place.
+    */
+   struct block_signee_data
+   {
+      optional<public_key_type>                   block_signee;
+      vector<optional<vector<public_key_type>>>   transaction_signees; ///< parallel to full_block::user_transactions
+   };
+
    namespace detail
    {
       class chain_database_impl
       {
          public:
             void                                        open_database(const fc::path& data_dir );
+            void                                        open_index_database( const fc::path& data_dir );
+            void                                        close_index_database();
+            bts::db::level_map_options                  get_database_options( const std::string& member_name )const;
             digest_type                                 initialize_genesis( const optional<path>& genesis_file, bool chain_id_only = false );
 
+            block_fork_data                             push_block( const full_block& block_data,
+                                                                        const optional<block_signee_data>& signees );
             std::pair<block_id_type, block_fork_data>   store_and_index( const block_id_type& id, const full_block& blk );
-            void                                        clear_pending(  const full_block& blk );
+            void                                        clear_pending( const full_block& blk,
+                                                                           const pending_chain_state_ptr& block_changes );
             void                                        switch_to_fork( const block_id_type& block_id );
-            void                                        extend_chain( const full_block& blk );
+            void                                        extend_chain( const full_block& blk,
+                                                                          const optional<block_signee_data>& signees = optional<block_signee_data>() );
             vector<block_id_type>                       get_fork_history( const block_id_type& id );
             void                                        pop_block();
             void                                        mark_invalid( const block_id_type& id, const fc::exception& reason );
             void                                        mark_included( const block_id_type& id, bool state );
             void                                        verify_header( const full_block&, const public_key_type& block_signee );
             void                                        apply_transactions( const full_block& block,
-                                                                            const pending_chain_state_ptr& );
+                                                                            const pending_chain_state_ptr&,
+                                                                            const optional<block_signee_data>& signees,
+                                                                            bool skip_signature_verification );
             void                                        pay_delegate( const pending_chain_state_ptr& pending_state,
                                                                       const public_key_type& block_signee )const;
             void                                        save_undo_state( const block_id_type& id,
@@ -101,6 +151,39 @@ namespace bts { namespace blockchain {
                                                                                          const public_key_type& block_signee );
 
             void                                        revalidate_pending();
+            unordered_set<transaction_id_type>          get_stale_pending_transactions()const;
+            void                                        insert_pending_transaction_state( const transaction_id_type& trx_id,
+                                                                                          pending_transaction_state&& pending );
+            void                                        erase_pending_transaction_state( const transaction_id_type& trx_id );
+
+            vector<public_key_type>                     recover_signees( const signed_transaction& trx )const;
+            vector<optional<vector<public_key_type>>>   recover_signees( const signed_transactions& trxs );
+            block_signee_data                           recover_signees( const full_block& block, bool include_transactions );
+            vector<optional<block_signee_data>>         recover_signees( const vector<full_block>& blocks, bool include_transactions );
+            bool                                        is_before_last_checkpoint( uint32_t block_num )const;
+
+            void                                        adjust_asset_totals( const asset_id_type& asset_id,
+                                                                                 share_type supply_delta,
+                                                                                 share_type debt_delta = 0 );
+            map<asset_id_type, asset_totals>            scan_asset_totals();
+
+            void                                        index_market_order( order_type_enum type,
+                                                                                const market_index_key& key,
+                                                                                bool existed, bool is_null );
+            omarket_order                               fetch_market_order( order_type_enum type,
+                                                                                const market_index_key& key );
+            /** walks the range of @a pair in every order book, or every order when @a pair is unset */
+            vector<market_order>                        scan_market_orders( const optional<std::pair<asset_id_type, asset_id_type>>& pair,
+                                                                                const std::function<bool( const market_order& )>& filter,
+                                                                                uint32_t limit, order_type_enum type );
+
+            void                                        begin_bulk_write();
+            void                                        commit_bulk_write();
+            void                                        bulk_write_block_pushed();
+
+            transaction_evaluation_state_ptr            evaluate_transaction( const signed_transaction& trx,
+                                                                              const share_type& required_fees,
+                                                                              const optional<vector<public_key_type>>& signees );
 
             fc::future<void> _revalidate_pending;
             fc::mutex        _push_block_mutex;
@@ -114,12 +197,41 @@ namespace bts { namespace blockchain {
              */
             pending_chain_state_ptr                                                     _pending_trx_state;
 
+            /**
+             *  How each pending transaction was evaluated, and the records changed by blocks since then.  Only
+             *  the transactions that read one of those records are evaluated again by revalidate_pending().
+             */
+            unordered_map<transaction_id_type, pending_transaction_state>               _pending_transaction_states;
+            /** the pending transactions that read each record, so a block's changes find them without a scan */
+            unordered_map<chain_state_key, unordered_set<transaction_id_type>>          _pending_readers;
+            std::map<uint64_t, transaction_id_type>                                     _pending_by_sequence;
+            std::set<std::pair<fc::time_point_sec, transaction_id_type>>                _pending_expirations;
+            chain_state_key_set                                                         _pending_invalidated_keys;
+            /** counts the blocks pushed or popped, revalidate_pending() checks it to see if one arrived while it yielded */
+            uint64_t                                                                    _pending_invalidation_count = 0;
+            uint64_t                                                                    _next_pending_sequence = 0;
+            /** transactions evaluated from this sequence on did not see the other pending transactions */
+            uint64_t                                                                    _pending_state_reset_sequence = uint64_t( -1 );
+
             chain_database*                                                             self = nullptr;
+            fc::path                                                                    _data_dir;
+            chain_database_options                                                      _options;
             unordered_set<chain_observer*>                                              _observers;
             digest_type                                                                 _chain_id;
             bool                                                                        _skip_signature_verification;
+
+            /** ECDSA public key recovery is farmed out to these threads, see recover_signees() */
+            unsigned                                                                    _num_signature_recovery_threads = 1;
+            vector<std::unique_ptr<fc::thread>>                                         _signature_recovery_threads;
             share_type                                                                  _relay_fee;
 
+            /** while non-zero, database writes are buffered and committed every this many blocks */
+            uint32_t                                                                    _bulk_write_blocks = 0;
+            uint32_t                                                                    _blocks_since_bulk_commit = 0;
+
+            /** every database under index/ is a keyspace of this one */
+            bts::db::level_database                                                     _index_db;
+
             bts::db::cached_level_map<uint32_t, std::vector<market_transaction>>        _market_transactions_db;
             bts::db::level_map<slate_id_type, delegate_slate>                           _slate_db;
             bts::db::level_map<uint32_t, std::vector<block_id_type>>                    _fork_number_db;
@@ -153,6 +265,8 @@ namespace bts { namespace blockchain {
             bts::db::level_map<string, asset_id_type>                                   _symbol_index_db;
 
             bts::db::level_map<balance_id_type, balance_record>                         _balance_db;
+            /** every owner of every balance, see balance_record::owners() */
+            bts::db::level_map<std::pair<address, balance_id_type>, int>                _address_to_balance_db;
 
             bts::db::cached_level_map<account_id_type, account_record>                  _account_db;
             bts::db::cached_level_map<string, account_id_type>                          _account_index_db;
@@ -172,6 +286,12 @@ namespace bts { namespace blockchain {
             bts::db::cached_level_map<market_index_key, collateral_record>              _collateral_db;
             bts::db::cached_level_map<feed_index, feed_record>                          _feed_db;
 
+            bts::db::cached_level_map<asset_id_type, asset_totals>                      _asset_totals_db;
+
+            /** every open order in the books above by id, and the ids of the orders of each owner */
+            bts::db::level_map<order_id_type, market_order_index>                       _order_index_db;
+            bts::db::level_map<std::pair<address, order_id_type>, int>                  _owner_to_order_id_db;
+
             bts::db::level_map<std::pair<asset_id_type,asset_id_type>, market_status>   _market_status_db;
             bts::db::level_map<market_history_key, market_history_record>               _market_history_db;
 
@@ -183,3 +303,5 @@ namespace bts { namespace blockchain {
 FC_REFLECT_TYPENAME( std::vector<bts::blockchain::block_id_type> )
 FC_REFLECT( bts::blockchain::vote_del, (votes)(delegate_id) )
 FC_REFLECT( bts::blockchain::fee_index, (_fees)(_trx) )
+FC_REFLECT( bts::blockchain::asset_totals, (supply)(debt) )
+FC_REFLECT( bts::blockchain::market_order_index, (type)(market_index) )
@@ -11,7 +11,7 @@
  *  @brief Defines global constants that determine blockchain behavior
  */
 #define BTS_BLOCKCHAIN_VERSION                              109
-#define BTS_BLOCKCHAIN_DATABASE_VERSION                     164
+#define BTS_BLOCKCHAIN_DATABASE_VERSION                     169
 
 /**
  *  The address prepended to string representation of
@@ -40,6 +40,9 @@
 #define BTS_BLOCKCHAIN_MIN_FEEDS                            ((BTS_BLOCKCHAIN_NUM_DELEGATES/2) + 1)
 #define BTS_BLOCKCHAIN_MAX_UNDO_HISTORY                     (BTS_BLOCKCHAIN_NUM_DELEGATES*4)
 
+#define BTS_BLOCKCHAIN_BULK_WRITE_BLOCKS                    500 // blocks per database commit while syncing or re-indexing
+#define BTS_BLOCKCHAIN_BULK_WRITE_SYNC_THRESHOLD            1000 // blocks left to sync before bulk writes are used
+
 #define BTS_BLOCKCHAIN_ENABLE_NEGATIVE_VOTES                false
 
 #define BTS_MAX_DELEGATE_PAY_PER_BLOCK                      int64_t( 50 * BTS_BLOCKCHAIN_PRECISION ) // 50 XTS
@@ -75,6 +75,9 @@ namespace bts { namespace blockchain {
           extended_private_key child( const fc::sha256& secret,
                                       derivation_type derivation = private_derivation )const;
 
+          /** public derivation, for callers that already know this key's public key and derive many children */
+          extended_private_key child( const fc::sha256& secret, const fc::ecc::public_key& public_key )const;
+
           operator fc::ecc::private_key()const;
           fc::ecc::public_key get_public_key()const;
 
@@ -23,7 +23,8 @@ namespace bts { namespace blockchain {
 
       friend bool operator == ( const market_index_key& a, const market_index_key& b )
       {
-         return a.order_price == b.order_price && a.owner == b.owner;
+         // price's operator== only compares the ratio, keys of different markets must not be equal
+         return a.order_price.asset_pair() == b.order_price.asset_pair() && a.order_price == b.order_price && a.owner == b.owner;
       }
       friend bool operator < ( const market_index_key& a, const market_index_key& b )
       {
@@ -1,10 +1,19 @@
 #pragma once
 #include <bts/blockchain/chain_interface.hpp>
+#include <fc/io/raw.hpp>
 #include <fc/reflect/reflect.hpp>
 #include <deque>
+#include <functional>
 
 namespace bts { namespace blockchain {
 
+   /**
+    *  Identifies a record of the chain state by its kind followed by its packed key, so that the
+    *  records a pending transaction read can be compared with the records a block wrote.
+    */
+   typedef std::string                       chain_state_key;
+   typedef unordered_set<chain_state_key>    chain_state_key_set;
+
    class pending_chain_state : public chain_interface, public std::enable_shared_from_this<pending_chain_state>
    {
       public:
@@ -13,6 +22,42 @@ namespace bts { namespace blockchain {
 
          void                           set_prev_state( chain_interface_ptr prev_state );
 
+         enum state_key_kind
+         {
+            asset_key,
+            asset_symbol_key,
+            balance_key,
+            account_key,
+            account_name_key,
+            account_address_key,
+            slate_key,
+            transaction_key,
+            order_key,
+            market_key,
+            property_key,
+            feed_key,
+            burn_key,
+            head_block_key ///< the head block number and the random seed, which change with every block
+         };
+
+         template<typename Key>
+         static chain_state_key         make_state_key( state_key_kind kind, const Key& key )
+         {
+            const auto packed_key = fc::raw::pack( key );
+            chain_state_key state_key( 1, char( kind ) );
+            state_key.append( packed_key.begin(), packed_key.end() );
+            return state_key;
+         }
+
+         /**
+          *  While set, the key of every record looked up through this state is added to @a reads.  Reading
+          *  the head block number or the random seed adds head_block_key.  Every transaction reads the time,
+          *  so it is not tracked, expired transactions are found by their expiration instead.
+          */
+         void                           track_reads( chain_state_key_set* reads );
+         /** adds the key of every record this state changes to @a keys */
+         void                           get_written_keys( chain_state_key_set& keys )const;
+
          fc::ripemd160                  get_current_random_seed()const override;
 
          virtual void                   set_feed( const feed_record&  ) override;
@@ -97,6 +142,18 @@ namespace bts { namespace blockchain {
          /** apply changes from this pending state to the previous state */
          virtual void                   apply_changes()const;
 
+         /**
+          *  Starts a nested scope, an alternative to evaluating into a child state and applying it.
+          *  Until the scope is committed or undone, changes are written directly into this state and
+          *  the values they replace are journaled, so opening and committing a scope copies nothing
+          *  and reads made inside it do not go through an extra layer.  Scopes may be nested and
+          *  must be closed in reverse order.
+          */
+         void                           begin_nested();
+         void                           commit_nested();
+         /** restores every entry changed since the matching begin_nested() */
+         void                           undo_nested();
+
          /** populate undo state with everything that would be necessary to revert this
           * pending state to the previous state.
           */
@@ -143,6 +200,23 @@ namespace bts { namespace blockchain {
          std::set<std::pair<asset_id_type, asset_id_type>>              _dirty_markets;
 
          chain_interface_weak_ptr                                       _prev_state;
+
+      private:
+         template<typename Key>
+         void                           record_read( state_key_kind kind, const Key& key )const;
+
+         template<typename Index>
+         void                           journal_entry( Index pending_chain_state::* index,
+                                                       const typename Index::key_type& key );
+         template<typename Set>
+         void                           journal_set_entry( Set pending_chain_state::* set,
+                                                           const typename Set::key_type& key );
+
+         /** undo actions for the open nested scopes, _nested_scopes holds the journal size at each begin */
+         vector<std::function<void( pending_chain_state& )>>           _journal;
+         vector<size_t>                                                 _nested_scopes;
+
+         chain_state_key_set*                                           _reads = nullptr;
    };
 
    typedef std::shared_ptr<pending_chain_state> pending_chain_state_ptr;
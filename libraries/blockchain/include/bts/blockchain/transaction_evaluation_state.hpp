@@ -33,6 +33,8 @@ namespace bts { namespace blockchain {
          virtual void reset();
 
          virtual void evaluate( const signed_transaction& trx, bool skip_signature_check = false );
+         /** throws if trx has already expired or expires too far past now, shared with chain_database::prevalidate_transaction() */
+         static void validate_expiration( const signed_transaction& trx, const fc::time_point_sec& now );
          virtual void evaluate_operation( const operation& op );
 
          /** perform any final operations based upon the current state of
@@ -52,6 +54,9 @@ namespace bts { namespace blockchain {
 
          bool check_signature( const address& a )const;
 
+         /** marks every address form of key as having signed this transaction */
+         void add_signed_key( const public_key_type& key );
+
          bool any_parent_has_signed( const string& account_name )const;
          bool account_or_any_parent_has_signed( const account_record& record )const;
 
@@ -131,6 +136,12 @@ namespace bts { namespace blockchain {
          digest_type                                _chain_id;
          bool                                       _skip_signature_check = false;
 
+         /**
+          *  Public keys recovered ahead of time from trx.signatures, in signature order.  When
+          *  set, evaluate() uses these instead of recovering each key on the calling thread.
+          */
+         optional<vector<public_key_type>>          _recovered_signees;
+
          uint32_t                                   _current_op_index = 0;
    };
 
@@ -107,6 +107,9 @@ namespace bts { namespace blockchain {
       :owner(owner_arg){}
 
       omemo_status decrypt_memo_data( const fc::ecc::private_key& receiver_key )const;
+      /** same as above, but takes the receiver's public key instead of recomputing it, for scanning many memos */
+      omemo_status decrypt_memo_data( const fc::ecc::private_key& receiver_key,
+                                      const fc::ecc::public_key& receiver_public_key )const;
       void         encrypt_memo_data( const fc::ecc::private_key& one_time_private_key,
                                       const fc::ecc::public_key&  to_public_key,
                                       const fc::ecc::private_key& from_private_key,
@@ -22,8 +22,109 @@ namespace bts { namespace blockchain {
       _prev_state = prev_state;
    }
 
+   void pending_chain_state::track_reads( chain_state_key_set* reads )
+   {
+      _reads = reads;
+   }
+
+   template<typename Key>
+   void pending_chain_state::record_read( state_key_kind kind, const Key& key )const
+   {
+      if( _reads != nullptr )
+         _reads->insert( make_state_key( kind, key ) );
+   }
+
+   void pending_chain_state::get_written_keys( chain_state_key_set& keys )const
+   {
+      for( const auto& item : assets )
+      {
+         keys.insert( make_state_key( asset_key, item.first ) );
+         keys.insert( make_state_key( asset_symbol_key, item.second.symbol ) );
+      }
+      for( const auto& item : symbol_id_index )  keys.insert( make_state_key( asset_symbol_key, item.first ) );
+      for( const auto& item : balances )         keys.insert( make_state_key( balance_key, item.first ) );
+      for( const auto& item : accounts )
+      {
+         keys.insert( make_state_key( account_key, item.first ) );
+         keys.insert( make_state_key( account_name_key, item.second.name ) );
+      }
+      for( const auto& item : account_id_index ) keys.insert( make_state_key( account_name_key, item.first ) );
+      for( const auto& item : key_to_account )   keys.insert( make_state_key( account_address_key, item.first ) );
+      for( const auto& item : slates )           keys.insert( make_state_key( slate_key, item.first ) );
+      for( const auto& item : transactions )     keys.insert( make_state_key( transaction_key, item.first ) );
+      for( const auto& item : properties )       keys.insert( make_state_key( property_key, item.first ) );
+      for( const auto& book : { &bids, &asks, &shorts, &relative_bids, &relative_asks } )
+      {
+         for( const auto& item : *book )
+         {
+            keys.insert( make_state_key( order_key, item.first ) );
+            keys.insert( make_state_key( market_key, item.first.order_price.asset_pair() ) );
+         }
+      }
+      for( const auto& item : collateral )
+      {
+         keys.insert( make_state_key( order_key, item.first ) );
+         keys.insert( make_state_key( market_key, item.first.order_price.asset_pair() ) );
+      }
+      for( const auto& item : market_statuses )  keys.insert( make_state_key( market_key, item.first ) );
+      for( const auto& item : feeds )            keys.insert( make_state_key( feed_key, item.first.feed_id ) );
+      for( const auto& item : burns )            keys.insert( make_state_key( burn_key, item.first ) );
+   }
+
+   /** called before @a key of @a index is written so that undo_nested() can put it back */
+   template<typename Index>
+   void pending_chain_state::journal_entry( Index pending_chain_state::* index, const typename Index::key_type& key )
+   {
+      if( _nested_scopes.empty() ) return;
+
+      const auto itr = (this->*index).find( key );
+      if( itr == (this->*index).end() )
+      {
+         _journal.push_back( [index, key]( pending_chain_state& state ) { (state.*index).erase( key ); } );
+      }
+      else
+      {
+         const auto prev_value = itr->second;
+         _journal.push_back( [index, key, prev_value]( pending_chain_state& state ) { (state.*index)[ key ] = prev_value; } );
+      }
+   }
+
+   template<typename Set>
+   void pending_chain_state::journal_set_entry( Set pending_chain_state::* set, const typename Set::key_type& key )
+   {
+      if( _nested_scopes.empty() ) return;
+
+      if( (this->*set).find( key ) == (this->*set).end() )
+         _journal.push_back( [set, key]( pending_chain_state& state ) { (state.*set).erase( key ); } );
+   }
+
+   void pending_chain_state::begin_nested()
+   {
+      _nested_scopes.push_back( _journal.size() );
+   }
+
+   void pending_chain_state::commit_nested()
+   {
+      FC_ASSERT( !_nested_scopes.empty() );
+      _nested_scopes.pop_back();
+      if( _nested_scopes.empty() )
+         _journal.clear();
+   }
+
+   void pending_chain_state::undo_nested()
+   {
+      FC_ASSERT( !_nested_scopes.empty() );
+      while( _journal.size() > _nested_scopes.back() )
+      {
+         _journal.back()( *this );
+         _journal.pop_back();
+      }
+      _nested_scopes.pop_back();
+   }
+
    uint32_t pending_chain_state::get_head_block_num()const
    {
+      record_read( head_block_key, uint8_t( 0 ) );
       const chain_interface_ptr prev_state = _prev_state.lock();
       FC_ASSERT( prev_state );
       return prev_state->get_head_block_num();
@@ -38,6 +139,7 @@ namespace bts { namespace blockchain {
 
    fc::ripemd160 pending_chain_state::get_current_random_seed()const
    {
+      record_read( head_block_key, uint8_t( 0 ) );
       const chain_interface_ptr prev_state = _prev_state.lock();
       FC_ASSERT( prev_state );
       return prev_state->get_current_random_seed();
@@ -56,6 +158,7 @@ namespace bts { namespace blockchain {
    /** Apply changes from this pending state to the previous state */
    void pending_chain_state::apply_changes()const
    {
+      FC_ASSERT( _nested_scopes.empty(), "Nested scopes must be closed before applying changes" );
       chain_interface_ptr prev_state = _prev_state.lock();
       if( !prev_state ) return;
       for( const auto& item : properties )      prev_state->set_property( (chain_property_enum)item.first, item.second );
@@ -90,6 +193,7 @@ namespace bts { namespace blockchain {
    otransaction_record pending_chain_state::get_transaction( const transaction_id_type& trx_id,
                                                               bool exact  )const
    {
+      record_read( transaction_key, trx_id );
       auto itr = transactions.find( trx_id );
       if( itr != transactions.end() ) return itr->second;
       chain_interface_ptr prev_state = _prev_state.lock();
@@ -98,6 +202,7 @@ namespace bts { namespace blockchain {
 
    bool pending_chain_state::is_known_transaction( const transaction_id_type& id )
    { try {
+      record_read( transaction_key, id );
       auto itr = transactions.find( id );
       if( itr != transactions.end() ) return true;
       chain_interface_ptr prev_state = _prev_state.lock();
@@ -107,6 +212,7 @@ namespace bts { namespace blockchain {
    void pending_chain_state::store_transaction( const transaction_id_type& id,
                                                 const transaction_record& rec )
    {
+      journal_entry( &pending_chain_state::transactions, id );
       transactions[id] = rec;
 
       for( const auto& op : rec.trx.operations )
@@ -255,6 +361,7 @@ namespace bts { namespace blockchain {
 
    oasset_record pending_chain_state::get_asset_record( const asset_id_type& asset_id )const
    {
+      record_read( asset_key, asset_id );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto itr = assets.find( asset_id );
       if( itr != assets.end() )
@@ -266,6 +373,7 @@ namespace bts { namespace blockchain {
 
    oasset_record pending_chain_state::get_asset_record( const std::string& symbol )const
    {
+      record_read( asset_symbol_key, symbol );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto itr = symbol_id_index.find( symbol );
       if( itr != symbol_id_index.end() )
@@ -277,6 +385,7 @@ namespace bts { namespace blockchain {
 
    obalance_record pending_chain_state::get_balance_record( const balance_id_type& balance_id )const
    {
+      record_read( balance_key, balance_id );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto itr = balances.find( balance_id );
       if( itr != balances.end() )
@@ -288,6 +397,7 @@ namespace bts { namespace blockchain {
 
    odelegate_slate pending_chain_state::get_delegate_slate( slate_id_type id )const
    {
+      record_read( slate_key, id );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto itr = slates.find(id);
       if( itr != slates.end() ) return itr->second;
@@ -297,11 +407,13 @@ namespace bts { namespace blockchain {
 
    void pending_chain_state::store_delegate_slate( slate_id_type id, const delegate_slate& slate )
    {
+      journal_entry( &pending_chain_state::slates, id );
       slates[id] = slate;
    }
 
    oaccount_record pending_chain_state::get_account_record( const address& owner )const
    {
+      record_read( account_address_key, owner );
       auto itr = key_to_account.find(owner);
       if( itr != key_to_account.end() ) return get_account_record( itr->second );
       chain_interface_ptr prev_state = _prev_state.lock();
@@ -311,6 +423,7 @@ namespace bts { namespace blockchain {
 
    oaccount_record pending_chain_state::get_account_record( const account_id_type& account_id )const
    {
+      record_read( account_key, account_id );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto itr = accounts.find( account_id );
       if( itr != accounts.end() )
@@ -322,6 +435,7 @@ namespace bts { namespace blockchain {
 
    oaccount_record pending_chain_state::get_account_record( const std::string& name )const
    {
+      record_read( account_name_key, name );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto itr = account_id_index.find( name );
       if( itr != account_id_index.end() )
@@ -333,23 +447,29 @@ namespace bts { namespace blockchain {
 
    void pending_chain_state::store_asset_record( const asset_record& r )
    {
+      journal_entry( &pending_chain_state::assets, r.id );
       assets[r.id] = r;
    }
 
    void pending_chain_state::store_balance_record( const balance_record& r )
    {
+      journal_entry( &pending_chain_state::balances, r.id() );
       balances[r.id()] = r;
    }
 
    void pending_chain_state::store_account_record( const account_record& r )
    {
+      journal_entry( &pending_chain_state::accounts, r.id );
       accounts[ r.id ] = r;
+      journal_entry( &pending_chain_state::account_id_index, r.name );
       account_id_index[ r.name ] = r.id;
+      journal_entry( &pending_chain_state::key_to_account, address( r.owner_key ) );
       key_to_account[ address(r.owner_key) ] = r.id;
       for( const auto& item : r.active_key_history )
       {
           const public_key_type& active_key = item.second;
           if( active_key == public_key_type() ) continue;
+          journal_entry( &pending_chain_state::key_to_account, address( active_key ) );
           key_to_account[ address( active_key ) ] = r.id;
       }
       if( r.is_delegate() )
@@ -358,6 +478,7 @@ namespace bts { namespace blockchain {
           {
               const public_key_type& signing_key = item.second;
               if( signing_key == public_key_type() ) continue;
+              journal_entry( &pending_chain_state::key_to_account, address( signing_key ) );
               key_to_account[ address( signing_key ) ] = r.id;
           }
       }
@@ -373,14 +494,36 @@ namespace bts { namespace blockchain {
 
    void pending_chain_state::store_recent_operation(const operation& o)
    {
-      auto& recent_op_queue = recent_operations[o.type];
+      const operation_type_enum type = operation_type_enum( o.type );
+      const bool new_queue = recent_operations.find( type ) == recent_operations.end();
+      auto& recent_op_queue = recent_operations[type];
       recent_op_queue.push_back(o);
+      optional<operation> dropped_op;
       if( recent_op_queue.size() > MAX_RECENT_OPERATIONS )
+      {
+        dropped_op = recent_op_queue.front();
         recent_op_queue.pop_front();
+      }
+
+      // the queue can be long, so only the appended operation and the one it pushed out are journaled
+      if( _nested_scopes.empty() ) return;
+      _journal.push_back( [type, new_queue, dropped_op]( pending_chain_state& state )
+      {
+         if( new_queue )
+         {
+            state.recent_operations.erase( type );
+            return;
+         }
+         auto& queue = state.recent_operations[ type ];
+         queue.pop_back();
+         if( dropped_op.valid() )
+            queue.push_front( *dropped_op );
+      } );
    }
 
    fc::variant pending_chain_state::get_property( chain_property_enum property_id )const
    {
+      record_read( property_key, chain_property_type( property_id ) );
       auto property_itr = properties.find( property_id );
       if( property_itr != properties.end()  ) return property_itr->second;
       chain_interface_ptr prev_state = _prev_state.lock();
@@ -391,6 +534,7 @@ namespace bts { namespace blockchain {
    void pending_chain_state::set_property( chain_property_enum property_id,
                                                      const fc::variant& property_value )
    {
+      journal_entry( &pending_chain_state::properties, property_id );
       properties[property_id] = property_value;
    }
 
@@ -426,6 +570,7 @@ namespace bts { namespace blockchain {
 
    oorder_record pending_chain_state::get_bid_record( const market_index_key& key )const
    {
+      record_read( order_key, key );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto rec_itr = bids.find( key );
       if( rec_itr != bids.end() ) return rec_itr->second;
@@ -434,6 +579,7 @@ namespace bts { namespace blockchain {
    }
    oorder_record pending_chain_state::get_relative_bid_record( const market_index_key& key )const
    {
+      record_read( order_key, key );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto rec_itr = relative_bids.find( key );
       if( rec_itr != relative_bids.end() ) return rec_itr->second;
@@ -443,6 +589,7 @@ namespace bts { namespace blockchain {
 
    omarket_order pending_chain_state::get_lowest_ask_record( const asset_id_type& quote_id, const asset_id_type& base_id )
    {
+      record_read( market_key, std::make_pair( quote_id, base_id ) );
       chain_interface_ptr prev_state = _prev_state.lock();
       omarket_order result;
       if( prev_state )
@@ -459,6 +606,7 @@ namespace bts { namespace blockchain {
 
    oorder_record pending_chain_state::get_ask_record( const market_index_key& key )const
    {
+      record_read( order_key, key );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto rec_itr = asks.find( key );
       if( rec_itr != asks.end() ) return rec_itr->second;
@@ -468,6 +616,7 @@ namespace bts { namespace blockchain {
 
    oorder_record pending_chain_state::get_relative_ask_record( const market_index_key& key )const
    {
+      record_read( order_key, key );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto rec_itr = relative_asks.find( key );
       if( rec_itr != relative_asks.end() ) return rec_itr->second;
@@ -477,6 +626,7 @@ namespace bts { namespace blockchain {
 
    oorder_record pending_chain_state::get_short_record( const market_index_key& key )const
    {
+      record_read( order_key, key );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto rec_itr = shorts.find( key );
       if( rec_itr != shorts.end() ) return rec_itr->second;
@@ -486,6 +636,7 @@ namespace bts { namespace blockchain {
 
    ocollateral_record pending_chain_state::get_collateral_record( const market_index_key& key )const
    {
+      record_read( order_key, key );
       chain_interface_ptr prev_state = _prev_state.lock();
       auto rec_itr = collateral.find( key );
       if( rec_itr != collateral.end() ) return rec_itr->second;
@@ -495,47 +646,61 @@ namespace bts { namespace blockchain {
 
    void pending_chain_state::store_bid_record( const market_index_key& key, const order_record& rec )
    {
+      journal_entry( &pending_chain_state::bids, key );
       bids[ key ] = rec;
+      journal_set_entry( &pending_chain_state::_dirty_markets, key.order_price.asset_pair() );
       _dirty_markets.insert( key.order_price.asset_pair() );
    }
 
    void pending_chain_state::store_ask_record( const market_index_key& key, const order_record& rec )
    {
+      journal_entry( &pending_chain_state::asks, key );
       asks[ key ] = rec;
+      journal_set_entry( &pending_chain_state::_dirty_markets, key.order_price.asset_pair() );
       _dirty_markets.insert( key.order_price.asset_pair() );
    }
 
    void pending_chain_state::store_relative_bid_record( const market_index_key& key, const order_record& rec )
    {
+      journal_entry( &pending_chain_state::relative_bids, key );
       relative_bids[ key ] = rec;
+      journal_set_entry( &pending_chain_state::_dirty_markets, key.order_price.asset_pair() );
       _dirty_markets.insert( key.order_price.asset_pair() );
    }
 
    void pending_chain_state::store_relative_ask_record( const market_index_key& key, const order_record& rec )
    {
+      journal_entry( &pending_chain_state::relative_asks, key );
       relative_asks[ key ] = rec;
+      journal_set_entry( &pending_chain_state::_dirty_markets, key.order_price.asset_pair() );
       _dirty_markets.insert( key.order_price.asset_pair() );
    }
 
    void pending_chain_state::store_short_record( const market_index_key& key, const order_record& rec )
    {
+      journal_entry( &pending_chain_state::shorts, key );
       shorts[ key ] = rec;
+      journal_set_entry( &pending_chain_state::_dirty_markets, key.order_price.asset_pair() );
       _dirty_markets.insert( key.order_price.asset_pair() );
    }
 
    void pending_chain_state::set_market_dirty( const asset_id_type& quote_id, const asset_id_type& base_id )
    {
+      journal_set_entry( &pending_chain_state::_dirty_markets, std::make_pair( quote_id, base_id ) );
       _dirty_markets.insert( std::make_pair( quote_id, base_id ) );
    }
 
    void pending_chain_state::store_collateral_record( const market_index_key& key, const collateral_record& rec )
    {
+      journal_entry( &pending_chain_state::collateral, key );
       collateral[ key ] = rec;
+      journal_set_entry( &pending_chain_state::_dirty_markets, key.order_price.asset_pair() );
       _dirty_markets.insert( key.order_price.asset_pair() );
    }
 
    void pending_chain_state::store_slot_record( const slot_record& r )
    {
+      journal_entry( &pending_chain_state::slots, r.start_time );
       slots[ r.start_time ] = r;
    }
 
@@ -550,6 +715,7 @@ namespace bts { namespace blockchain {
 
    void pending_chain_state::store_market_history_record(const market_history_key& key, const market_history_record& record)
    {
+     journal_entry( &pending_chain_state::market_history, key );
      market_history[ key ] = record;
    }
 
@@ -562,11 +728,17 @@ namespace bts { namespace blockchain {
 
    void pending_chain_state::set_market_transactions( vector<market_transaction> trxs )
    {
+      if( !_nested_scopes.empty() )
+      {
+         const auto prev_transactions = market_transactions;
+         _journal.push_back( [prev_transactions]( pending_chain_state& state ) { state.market_transactions = prev_transactions; } );
+      }
       market_transactions = std::move(trxs);
    }
 
    omarket_status pending_chain_state::get_market_status( const asset_id_type& quote_id, const asset_id_type& base_id )
    {
+      record_read( market_key, std::make_pair( quote_id, base_id ) );
       auto itr = market_statuses.find( std::make_pair(quote_id,base_id) );
       if( itr != market_statuses.end() )
          return itr->second;
@@ -576,16 +748,19 @@ namespace bts { namespace blockchain {
 
    void pending_chain_state::store_market_status( const market_status& s )
    {
+      journal_entry( &pending_chain_state::market_statuses, std::make_pair( s.quote_id, s.base_id ) );
       market_statuses[std::make_pair(s.quote_id,s.base_id)] = s;
    }
 
    void pending_chain_state::set_feed( const feed_record& r )
    {
+      journal_entry( &pending_chain_state::feeds, r.feed );
       feeds[r.feed] = r;
    }
 
    ofeed_record pending_chain_state::get_feed( const feed_index& i )const
    {
+      record_read( feed_key, i.feed_id );
       auto itr = feeds.find(i);
       if( itr != feeds.end() ) return itr->second;
 
@@ -595,17 +770,20 @@ namespace bts { namespace blockchain {
 
    oprice pending_chain_state::get_median_delegate_price( const asset_id_type& quote_id, const asset_id_type& base_id )const
    {
+      record_read( feed_key, feed_id_type( quote_id ) );
       chain_interface_ptr prev_state = _prev_state.lock();
       return prev_state->get_median_delegate_price( quote_id, base_id );
    }
 
    void pending_chain_state::store_burn_record( const burn_record& br )
    {
+      journal_entry( &pending_chain_state::burns, burn_record_key( br ) );
       burns[br] = br;
    }
 
    oburn_record pending_chain_state::fetch_burn_record( const burn_record_key& key )const
    {
+      record_read( burn_key, key );
       auto itr = burns.find(key);
       if( itr == burns.end() )
       {
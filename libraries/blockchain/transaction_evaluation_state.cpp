@@ -29,6 +29,16 @@ namespace bts { namespace blockchain {
       return  _skip_signature_check || signed_keys.find( a ) != signed_keys.end();
    } FC_CAPTURE_AND_RETHROW( (a) ) }
 
+   void transaction_evaluation_state::add_signed_key( const public_key_type& key )
+   {
+      const fc::ecc::public_key_data key_data = key;
+      signed_keys.insert( address(key_data) );
+      signed_keys.insert( address(pts_address(key_data,false,56) ) );
+      signed_keys.insert( address(pts_address(key_data,true,56) )  );
+      signed_keys.insert( address(pts_address(key_data,false,0) )  );
+      signed_keys.insert( address(pts_address(key_data,true,0) )   );
+   }
+
    bool transaction_evaluation_state::any_parent_has_signed( const string& account_name )const
    { try {
        for( optional<string> parent_name = _current_state->get_parent_account_name( account_name );
@@ -172,18 +182,23 @@ namespace bts { namespace blockchain {
 
    } FC_RETHROW_EXCEPTIONS( warn, "" ) }
 
+   void transaction_evaluation_state::validate_expiration( const signed_transaction& trx, const fc::time_point_sec& now )
+   {
+      if( now >= trx.expiration )
+      {
+         const auto expired_by_sec = (now - trx.expiration).to_seconds();
+         FC_CAPTURE_AND_THROW( expired_transaction, (trx.expiration)(now)(expired_by_sec) );
+      }
+      if( (now + BTS_BLOCKCHAIN_MAX_TRANSACTION_EXPIRATION_SEC) < trx.expiration )
+         FC_CAPTURE_AND_THROW( invalid_transaction_expiration, (trx.expiration)(now) );
+   }
+
    void transaction_evaluation_state::evaluate( const signed_transaction& trx_arg, bool skip_signature_check )
    { try {
       reset();
       _skip_signature_check = skip_signature_check;
       try {
-        if( _current_state->now() >= trx_arg.expiration )
-        {
-           const auto expired_by_sec = (_current_state->now() - trx_arg.expiration).to_seconds();
-           FC_CAPTURE_AND_THROW( expired_transaction, (trx_arg)(_current_state->now())(expired_by_sec) );
-        }
-        if( (_current_state->now() + BTS_BLOCKCHAIN_MAX_TRANSACTION_EXPIRATION_SEC) < trx_arg.expiration )
-           FC_CAPTURE_AND_THROW( invalid_transaction_expiration, (trx_arg)(_current_state->now()) );
+        validate_expiration( trx_arg, _current_state->now() );
 
         auto trx_id = trx_arg.id();
 
@@ -193,15 +208,17 @@ namespace bts { namespace blockchain {
         trx = trx_arg;
         if( !_skip_signature_check )
         {
-           auto digest = trx_arg.digest( _chain_id );
-           for( const auto& sig : trx.signatures )
+           if( _recovered_signees.valid() )
+           {
+              FC_ASSERT( _recovered_signees->size() == trx.signatures.size() );
+              for( const auto& key : *_recovered_signees )
+                 add_signed_key( key );
+           }
+           else
            {
-              auto key = fc::ecc::public_key( sig, digest ).serialize();
-              signed_keys.insert( address(key) );
-              signed_keys.insert( address(pts_address(key,false,56) ) );
-              signed_keys.insert( address(pts_address(key,true,56) )  );
-              signed_keys.insert( address(pts_address(key,false,0) )  );
-              signed_keys.insert( address(pts_address(key,true,0) )   );
+              auto digest = trx_arg.digest( _chain_id );
+              for( const auto& sig : trx.signatures )
+                 add_signed_key( fc::ecc::public_key( sig, digest ) );
            }
         }
         _current_op_index = 0;
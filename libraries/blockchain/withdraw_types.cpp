@@ -38,15 +38,21 @@ namespace bts { namespace blockchain {
    }
 
    omemo_status withdraw_with_signature::decrypt_memo_data( const fc::ecc::private_key& receiver_key )const
+   {
+      return decrypt_memo_data( receiver_key, receiver_key.get_public_key() );
+   }
+
+   omemo_status withdraw_with_signature::decrypt_memo_data( const fc::ecc::private_key& receiver_key,
+                                                            const fc::ecc::public_key& receiver_public_key )const
    { try {
       FC_ASSERT( memo.valid() );
       auto secret = receiver_key.get_shared_secret( memo->one_time_key );
       extended_private_key ext_receiver_key(receiver_key);
 
-      fc::ecc::private_key secret_private_key = ext_receiver_key.child( fc::sha256::hash(secret),
-                                                                        extended_private_key::public_derivation );
+      fc::ecc::private_key secret_private_key = ext_receiver_key.child( fc::sha256::hash(secret), receiver_public_key );
       auto secret_public_key = secret_private_key.get_public_key();
 
+      // nearly every memo we try isn't ours, reject it before doing any AES work
       if( owner != address(secret_public_key) )
          return omemo_status();
 
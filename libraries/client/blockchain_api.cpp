@@ -259,14 +259,20 @@ account_balance_summary_type detail::client_impl::blockchain_get_account_public_
   return ret;
 } FC_RETHROW_EXCEPTIONS( warn, "", ("account_name",account_name) ) }
 
-vector<balance_record> detail::client_impl::blockchain_list_address_balances( const address& addr )const
+vector<balance_record> detail::client_impl::blockchain_list_address_balances( const address& addr,
+                                                                             const string& first_balance_id,
+                                                                             uint32_t limit )const
 {
-    return _chain_db->get_balances_for_address( addr );
+    const balance_id_type first = first_balance_id.empty() ? balance_id_type() : balance_id_type( first_balance_id );
+    return _chain_db->get_balances_for_address( addr, first, limit );
 }
 
-vector<balance_record> detail::client_impl::blockchain_list_key_balances( const public_key_type& key )const
+vector<balance_record> detail::client_impl::blockchain_list_key_balances( const public_key_type& key,
+                                                                         const string& first_balance_id,
+                                                                         uint32_t limit )const
 {
-    return _chain_db->get_balances_for_key( key );
+    const balance_id_type first = first_balance_id.empty() ? balance_id_type() : balance_id_type( first_balance_id );
+    return _chain_db->get_balances_for_key( key, first, limit );
 }
 
 vector<account_record> detail::client_impl::blockchain_list_accounts( const string& first, int32_t limit )const
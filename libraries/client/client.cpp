@@ -687,9 +687,12 @@ void client_impl::rebroadcast_pending_loop()
       {
          signed_transactions pending = blockchain_list_pending_transactions();
          wlog( "rebroadcasting ${trx_count}", ("trx_count",pending.size()) );
-         for( auto trx : pending )
+         // these are already in our pending queue, so hand them straight to the p2p node instead of going
+         // through network_broadcast_transaction().  The node only re-announces a transaction to peers
+         // it hasn't exchanged it with, and announces them in batches limited by each peer's relay rate
+         for( const signed_transaction& trx : pending )
          {
-            network_broadcast_transaction( trx );
+            _p2p_node->broadcast( trx_message( trx ) );
          }
       }
       catch ( const fc::canceled_exception& )
@@ -800,10 +803,13 @@ block_fork_data client_impl::on_new_block(const full_block& block,
    }
 }
 
-bool client_impl::on_new_transaction(const signed_transaction& trx)
+bool client_impl::on_new_transaction(const signed_transaction& trx,
+                                     const fc::optional<std::vector<public_key_type>>& signees)
 {
    try {
       // throws exception if invalid trx, don't override limits
+      if (signees)
+         return !!_chain_db->store_pending_transaction(trx, false, signees);
       return !!_chain_db->store_pending_transaction(trx, false);
    }
    catch ( const duplicate_transaction& )
@@ -817,6 +823,162 @@ bool client_impl::on_new_transaction(const signed_transaction& trx)
    }
 }
 
+///////////////////////////////////////////////////////
+// Chain apply queue                                 //
+///////////////////////////////////////////////////////
+/**
+ * Queues a block or transaction for chain_apply_loop() and waits for it to be applied.  The p2p node's
+ * call to handle_message() is blocked until then, so while the queue is full it stops feeding us.
+ */
+bool client_impl::enqueue_chain_apply_request(std::function<bool()> apply, bool is_block)
+{
+   // once the loop is stopped nothing would ever apply the request, so refuse it rather than wait forever
+   if (_chain_apply_loop_stopped)
+      FC_THROW_EXCEPTION(fc::canceled_exception, "client is shutting down");
+
+   while (_pending_block_applies.size() + _pending_transaction_applies.size() >= _chain_apply_queue_size_limit)
+   {
+      ++_chain_apply_times_queue_full;
+      fc::promise<void>::ptr space_available(new fc::promise<void>("chain_apply_queue_space_available"));
+      _chain_apply_queue_space_waiters.push_back(space_available);
+      space_available->wait();
+      if (_chain_apply_loop_stopped)
+         FC_THROW_EXCEPTION(fc::canceled_exception, "client is shutting down");
+   }
+
+   chain_apply_request request;
+   request.apply = std::move(apply);
+   request.result = fc::promise<bool>::ptr(new fc::promise<bool>("chain_apply_request"));
+   request.enqueue_time = fc::time_point::now();
+   fc::future<bool> result(request.result);
+
+   if (is_block)
+      _pending_block_applies.push_back(std::move(request));
+   else
+      _pending_transaction_applies.push_back(std::move(request));
+   _chain_apply_queue_max_depth = std::max<uint32_t>(_chain_apply_queue_max_depth,
+                                                     _pending_block_applies.size() + _pending_transaction_applies.size());
+
+   if (_chain_apply_loop_wakeup)
+   {
+      _chain_apply_loop_wakeup->set_value();
+      _chain_apply_loop_wakeup.reset();
+   }
+
+   return result.wait();
+}
+
+void client_impl::start_chain_apply_loop()
+{
+   if (!_chain_apply_loop_done.valid() || _chain_apply_loop_done.ready())
+      _chain_apply_loop_done = fc::async([=](){ chain_apply_loop(); }, "chain_apply_loop");
+   _chain_apply_loop_stopped = false;
+}
+
+void client_impl::cancel_chain_apply_loop()
+{
+   // set before waiting on the loop so nothing can be queued behind it while it winds down
+   _chain_apply_loop_stopped = true;
+   try
+   {
+      if (_chain_apply_loop_done.valid())
+         _chain_apply_loop_done.cancel_and_wait(__FUNCTION__);
+   }
+   catch (const fc::exception& e)
+   {
+      wlog("Unexpected error from chain_apply_loop(): ${e}", ("e", e));
+   }
+
+   // nothing will apply these any more, release everyone still waiting on the queue
+   for (std::deque<chain_apply_request>* queue : {&_pending_block_applies, &_pending_transaction_applies})
+   {
+      for (chain_apply_request& request : *queue)
+         request.result->set_exception(std::make_shared<fc::canceled_exception>(FC_LOG_MESSAGE(warn, "client is shutting down")));
+      queue->clear();
+   }
+   for (const fc::promise<void>::ptr& waiter : _chain_apply_queue_space_waiters)
+      waiter->set_exception(std::make_shared<fc::canceled_exception>(FC_LOG_MESSAGE(warn, "client is shutting down")));
+   _chain_apply_queue_space_waiters.clear();
+}
+
+/**
+ * The only place blocks and transactions from the network are applied to _chain_db.  Requests are applied
+ * one at a time, blocks first, so RPC calls and the delegate loop only ever wait behind a single block
+ * instead of behind every message the p2p node has received.
+ */
+void client_impl::chain_apply_loop()
+{
+   while (!_chain_apply_loop_done.canceled())
+   {
+      if (_pending_block_applies.empty() && _pending_transaction_applies.empty())
+      {
+         fc::promise<void>::ptr wakeup(new fc::promise<void>("chain_apply_loop_wakeup"));
+         _chain_apply_loop_wakeup = wakeup;
+         try
+         {
+            wakeup->wait();
+         }
+         catch (...)
+         {
+            _chain_apply_loop_wakeup.reset();
+            throw;
+         }
+         continue;
+      }
+
+      const bool is_block = !_pending_block_applies.empty();
+      std::deque<chain_apply_request>& queue = is_block ? _pending_block_applies : _pending_transaction_applies;
+      chain_apply_request request = std::move(queue.front());
+      queue.pop_front();
+
+      if (!_chain_apply_queue_space_waiters.empty())
+      {
+         _chain_apply_queue_space_waiters.front()->set_value();
+         _chain_apply_queue_space_waiters.pop_front();
+      }
+
+      _chain_apply_total_wait_time += fc::time_point::now() - request.enqueue_time;
+      if (is_block)
+         ++_chain_apply_blocks_applied;
+      else
+         ++_chain_apply_transactions_applied;
+
+      try
+      {
+         request.result->set_value(request.apply());
+      }
+      catch (const fc::canceled_exception&)
+      {
+         request.result->set_exception(std::make_shared<fc::canceled_exception>(FC_LOG_MESSAGE(warn, "client is shutting down")));
+         throw;
+      }
+      catch (const fc::exception& e)
+      {
+         request.result->set_exception(e.dynamic_copy_exception());
+      }
+      catch (const std::exception& e)
+      {
+         request.result->set_exception(std::make_shared<fc::exception>(FC_LOG_MESSAGE(error, "${what}", ("what", e.what()))));
+      }
+   }
+}
+
+fc::variant_object client_impl::get_chain_apply_queue_stats() const
+{
+   const uint64_t total_applied = _chain_apply_blocks_applied + _chain_apply_transactions_applied;
+   fc::mutable_variant_object stats;
+   stats["blocks_queued"] = _pending_block_applies.size();
+   stats["transactions_queued"] = _pending_transaction_applies.size();
+   stats["queue_size_limit"] = _chain_apply_queue_size_limit;
+   stats["max_queue_depth"] = _chain_apply_queue_max_depth;
+   stats["blocks_applied"] = _chain_apply_blocks_applied;
+   stats["transactions_applied"] = _chain_apply_transactions_applied;
+   stats["transactions_rejected_before_queueing"] = _chain_apply_transactions_rejected_early;
+   stats["times_queue_full"] = _chain_apply_times_queue_full;
+   stats["average_wait_usec"] = total_applied ? _chain_apply_total_wait_time.count() / (int64_t)total_applied : 0;
+   return stats;
+}
+
 ///////////////////////////////////////////////////////
 // Implement node_delegate                           //
 ///////////////////////////////////////////////////////
@@ -842,17 +1004,34 @@ bool client_impl::handle_message(const bts::net::message& message_to_handle, boo
       {
       case block_message_type:
       {
-         block_message block_message_to_handle(message_to_handle.as<block_message>());
-         ilog("CLIENT: just received block ${id}", ("id", block_message_to_handle.block.id()));
-         bts::blockchain::block_id_type old_head_block = _chain_db->get_head_block_id();
-         block_fork_data fork_data = on_new_block(block_message_to_handle.block, block_message_to_handle.block_id, sync_mode);
-         return fork_data.is_included ^ (block_message_to_handle.block.previous == old_head_block);  // TODO is this right?
+         std::shared_ptr<block_message> block_message_to_handle = std::make_shared<block_message>(message_to_handle.as<block_message>());
+         ilog("CLIENT: just received block ${id}", ("id", block_message_to_handle->block_id));
+         return enqueue_chain_apply_request([=]() -> bool {
+            bts::blockchain::block_id_type old_head_block = _chain_db->get_head_block_id();
+            block_fork_data fork_data = on_new_block(block_message_to_handle->block, block_message_to_handle->block_id, sync_mode);
+            return fork_data.is_included ^ (block_message_to_handle->block.previous == old_head_block);  // TODO is this right?
+         }, true);
       }
       case trx_message_type:
       {
-         trx_message trx_message_to_handle(message_to_handle.as<trx_message>());
-         ilog("CLIENT: just received transaction ${id}", ("id", trx_message_to_handle.trx.id()));
-         return on_new_transaction(trx_message_to_handle.trx);
+         std::shared_ptr<trx_message> trx_message_to_handle = std::make_shared<trx_message>(message_to_handle.as<trx_message>());
+         ilog("CLIENT: just received transaction ${id}", ("id", trx_message_to_handle->trx.id()));
+         // reject transactions that can never be valid and recover their signing keys before they take
+         // a place in the queue; this runs concurrently for every transaction the p2p node hands us
+         fc::optional<std::vector<public_key_type>> signees;
+         try
+         {
+            signees = _chain_db->prevalidate_transaction(trx_message_to_handle->trx);
+         }
+         catch (const fc::exception& e)
+         {
+            ++_chain_apply_transactions_rejected_early;
+            _exception_db.store(e);
+            throw;
+         }
+         return enqueue_chain_apply_request([=]() -> bool {
+            return on_new_transaction(trx_message_to_handle->trx, signees);
+         }, false);
       }
       }
       return false;
@@ -1065,10 +1244,14 @@ bts::net::message client_impl::get_item(const bts::net::item_id& id)
 {
    if (id.item_type == block_message_type)
    {
-      //   uint32_t block_number = _chain_db->get_block_num(id.item_hash);
-      bts::client::block_message block_message_to_send(_chain_db->get_block(id.item_hash));
-      FC_ASSERT(id.item_hash == block_message_to_send.block_id); //.id());
-      //   block_message_to_send.signature = block_message_to_send.block.delegate_signature;
+      // a block_message packs as the block followed by its id, and the chain database stores the block
+      // packed, so build the message from the stored bytes instead of unpacking and repacking the block
+      bts::net::message block_message_to_send;
+      block_message_to_send.msg_type = block_message_type;
+      block_message_to_send.data = _chain_db->get_packed_block(id.item_hash);
+      const std::vector<char> packed_block_id = fc::raw::pack(id.item_hash);
+      block_message_to_send.data.insert(block_message_to_send.data.end(), packed_block_id.begin(), packed_block_id.end());
+      block_message_to_send.size = (uint32_t)block_message_to_send.data.size();
       return block_message_to_send;
    }
 
@@ -1083,11 +1266,31 @@ bts::net::message client_impl::get_item(const bts::net::item_id& id)
    FC_THROW_EXCEPTION(fc::key_not_found_exception, "I don't have the item you're looking for");
 }
 
+std::vector<bts::blockchain::transaction_id_type> client_impl::get_pending_transaction_ids()
+{
+   return _chain_db->get_pending_transaction_ids();
+}
+
+std::vector<fc::optional<bts::blockchain::signed_transaction> > client_impl::get_pending_transactions( const std::vector<bts::blockchain::transaction_id_type>& ids )
+{
+   std::vector<fc::optional<signed_transaction>> pending_transactions;
+   pending_transactions.reserve( ids.size() );
+   for( const transaction_id_type& id : ids )
+      pending_transactions.push_back( _chain_db->get_pending_transaction( id ) );
+   return pending_transactions;
+}
+
 void client_impl::sync_status(uint32_t item_type, uint32_t item_count)
 {
    const bool in_sync = item_count == 0;
    _remaining_items_to_sync = item_count;
 
+   // while far behind, let the chain database group its writes; committing as soon as we are in sync
+   if( in_sync )
+      _chain_db->set_bulk_write_mode( 0 );
+   else if( item_count >= BTS_BLOCKCHAIN_BULK_WRITE_SYNC_THRESHOLD )
+      _chain_db->set_bulk_write_mode( BTS_BLOCKCHAIN_BULK_WRITE_BLOCKS );
+
    fc::time_point now = fc::time_point::now();
    if (_cli)
    {
@@ -1285,6 +1488,8 @@ void client::open( const path& data_dir, fc::optional<fc::path> genesis_file_pat
          //FIXME: is it really correct to continue here without rethrowing?
       }
 
+      my->_chain_db->set_database_options( my->_config.database );
+
       bool attempt_to_recover_database = false;
       try
       {
@@ -1325,6 +1530,7 @@ void client::open( const path& data_dir, fc::optional<fc::path> genesis_file_pat
       //if we are using a simulated network, _p2p_node will already be set by client's constructor
       if (!my->_p2p_node)
          my->_p2p_node = std::make_shared<bts::net::node>(my->_user_agent);
+      my->start_chain_apply_loop();
       my->_p2p_node->set_node_delegate(my.get());
 
       my->start_rebroadcast_pending_loop();
@@ -1403,6 +1609,7 @@ void client::start_networking(std::function<void()> network_started_callback)
       bts::net::chain_downloader* chain_downloader = new bts::net::chain_downloader();
       for( const auto& server : my->_config.chain_servers )
          chain_downloader->add_chain_server(fc::ip::endpoint::from_string(server));
+      chain_downloader->set_compression_enabled(my->_config.chain_download_compression);
       my->_chain_downloader_running = true;
       my->_chain_downloader_future = chain_downloader->get_all_blocks([this](const full_block& new_block, uint32_t blocks_left) {
          my->_chain_db->push_block(new_block);
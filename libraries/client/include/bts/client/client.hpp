@@ -68,6 +68,7 @@ namespace bts { namespace client {
     {
        config( ) :
           default_peers(vector<string>{ BTS_NET_TEST_SEED_IP, BTS_NET_TEST_SEED_IP, BTS_NET_TEST_SEED_IP }),
+          chain_download_compression(false),
           mail_server_enabled(false),
           wallet_enabled(true),
           ignore_console(false),
@@ -91,6 +92,7 @@ namespace bts { namespace client {
           vector<string>      default_peers;
           vector<string>      chain_servers;
           chain_server_config chain_server;
+          bool                chain_download_compression; ///< ask chain_servers to compress blocks, for slow links
           bool                mail_server_enabled;
           bool                wallet_enabled;
           bool                ignore_console;
@@ -101,6 +103,7 @@ namespace bts { namespace client {
           fc::ip::endpoint    delegate_server;
           vector<string>      default_delegate_peers;
           string              wallet_callback_url;
+          chain_database_options database;
 
           fc::optional<std::string> growl_notify_endpoint;
           fc::optional<std::string> growl_password;
@@ -196,11 +199,12 @@ FC_REFLECT(bts::client::client_notification, (timestamp)(message)(signature) )
 FC_REFLECT( bts::client::rpc_server_config, (enable)(rpc_user)(rpc_password)(rpc_endpoint)(httpd_endpoint)(htdocs) )
 FC_REFLECT( bts::client::chain_server_config, (enabled)(listen_port) )
 FC_REFLECT( bts::client::config,
-            (rpc)(default_peers)(chain_servers)(chain_server)(mail_server_enabled)
+            (rpc)(default_peers)(chain_servers)(chain_server)(chain_download_compression)(mail_server_enabled)
             (wallet_enabled)(ignore_console)(logging)
             (delegate_server)
             (default_delegate_peers)
             (wallet_callback_url)
+            (database)
             (growl_notify_endpoint)
             (growl_password)
             (growl_bitshares_client_identifier) )
@@ -15,6 +15,8 @@
 #include <boost/accumulators/statistics/stats.hpp>
 #include <boost/accumulators/statistics/rolling_mean.hpp>
 
+#include <deque>
+#include <functional>
 #include <iostream>
 #include <fstream>
 
@@ -132,6 +134,7 @@ public:
       _connection_count_notification_interval(fc::minutes(5)),
       _connection_count_always_notify_threshold(5),
       _connection_count_last_value_displayed(0),
+      _chain_apply_queue_size_limit(1000),
       _blockchain_synopsis_size_limit((unsigned)(log2(BTS_BLOCKCHAIN_BLOCKS_PER_YEAR * 20)))
    {
       try
@@ -150,6 +153,7 @@ public:
 
    virtual ~client_impl() override
    {
+      cancel_chain_apply_loop();
       cancel_blocks_too_old_monitor_task();
       cancel_rebroadcast_pending_loop();
       if( _chain_downloader_future.valid() && !_chain_downloader_future.ready() )
@@ -200,7 +204,24 @@ public:
                                 const block_id_type& block_id,
                                 bool sync_mode);
 
-   bool on_new_transaction(const signed_transaction& trx);
+   bool on_new_transaction(const signed_transaction& trx,
+                           const fc::optional<std::vector<public_key_type>>& signees = fc::optional<std::vector<public_key_type>>());
+
+   /**
+    * A block or transaction received from the p2p network, waiting in the chain apply queue
+    * for chain_apply_loop() to apply it to _chain_db
+    */
+   struct chain_apply_request
+   {
+      std::function<bool()>         apply;
+      fc::promise<bool>::ptr        result;
+      fc::time_point                enqueue_time;
+   };
+   bool enqueue_chain_apply_request(std::function<bool()> apply, bool is_block);
+   void start_chain_apply_loop();
+   void cancel_chain_apply_loop();
+   void chain_apply_loop();
+   fc::variant_object get_chain_apply_queue_stats() const;
    void blocks_too_old_monitor_task();
    void cancel_blocks_too_old_monitor_task();
 
@@ -213,6 +234,8 @@ public:
                                                            uint32_t& remaining_item_count,
                                                            uint32_t limit = 2000) override;
    virtual bts::net::message get_item(const bts::net::item_id& id) override;
+   virtual std::vector<bts::blockchain::transaction_id_type> get_pending_transaction_ids() override;
+   virtual std::vector<fc::optional<bts::blockchain::signed_transaction> > get_pending_transactions( const std::vector<bts::blockchain::transaction_id_type>& ids ) override;
    virtual fc::sha256 get_chain_id() const override
    {
       FC_ASSERT( _chain_db != nullptr );
@@ -272,6 +295,23 @@ public:
    bool                                                    _chain_downloader_running = false;
    uint32_t                                                _chain_downloader_blocks_remaining = 0;
 
+   /** blocks are always applied before transactions, so a block never waits behind a flood of transactions */
+   std::deque<chain_apply_request>                         _pending_block_applies;
+   std::deque<chain_apply_request>                         _pending_transaction_applies;
+   /** handle_message() calls wait here while the queue is full, which in turn holds up the p2p node */
+   std::deque<fc::promise<void>::ptr>                      _chain_apply_queue_space_waiters;
+   fc::promise<void>::ptr                                  _chain_apply_loop_wakeup;
+   fc::future<void>                                        _chain_apply_loop_done;
+   /** set once the apply loop is canceled; requests arriving after that are refused instead of queued */
+   bool                                                    _chain_apply_loop_stopped = true;
+   const uint32_t                                          _chain_apply_queue_size_limit;
+   uint32_t                                                _chain_apply_queue_max_depth = 0;
+   uint64_t                                                _chain_apply_blocks_applied = 0;
+   uint64_t                                                _chain_apply_transactions_applied = 0;
+   uint64_t                                                _chain_apply_transactions_rejected_early = 0;
+   uint64_t                                                _chain_apply_times_queue_full = 0;
+   fc::microseconds                                        _chain_apply_total_wait_time;
+
    fc::time_point                                          _last_connection_count_message_time;
    /** display messages about the connection count changing at most once every _connection_count_notification_interval */
    fc::microseconds                                        _connection_count_notification_interval;
@@ -6,10 +6,16 @@ namespace bts { namespace client {
 
    enum message_type_enum
    {
-      trx_message_type          = 1000,
-      block_message_type        = 1001
+      trx_message_type                      = 1000,
+      block_message_type                    = 1001,
+      compact_block_message_type            = 1002,
+      fetch_block_transactions_message_type = 1003,
+      block_transactions_message_type       = 1004,
+      trx_batch_message_type                = 1005
    };
 
+   typedef uint64_t short_transaction_id_type;
+
    struct trx_message
    {
       static const message_type_enum type;
@@ -34,8 +40,72 @@ namespace bts { namespace client {
 
    };
 
+   /**
+    *  A block_message sent as the block header and a short id for each transaction.  Peers relaying a
+    *  block almost always have its transactions already, so they rebuild the block from the transactions
+    *  they have and only fetch the missing ones with a fetch_block_transactions_message.
+    */
+   struct compact_block_message
+   {
+      static const message_type_enum type;
+
+      compact_block_message(){}
+      compact_block_message(const block_message& full_block_message, const fc::uint160_t& block_message_hash);
+
+      /** short ids are salted with the block id so nobody can prepare colliding transactions in advance */
+      static short_transaction_id_type short_transaction_id(const bts::blockchain::block_id_type& block_id,
+                                                            const bts::blockchain::transaction_id_type& transaction_id);
+
+      bts::blockchain::signed_block_header   block_header;
+      std::vector<short_transaction_id_type> short_transaction_ids;
+      /** the id of the block_message this replaces, which is the item id it was requested by */
+      fc::uint160_t                          block_message_hash;
+   };
+
+   /** requests the transactions at the given positions of a block we received in compact form */
+   struct fetch_block_transactions_message
+   {
+      static const message_type_enum type;
+
+      fetch_block_transactions_message(){}
+      fetch_block_transactions_message(const bts::blockchain::block_id_type& block_id,
+                                       std::vector<uint32_t> transaction_indexes) :
+        block_id(block_id),
+        transaction_indexes(std::move(transaction_indexes))
+      {}
+
+      bts::blockchain::block_id_type block_id;
+      std::vector<uint32_t>          transaction_indexes;
+   };
+
+   /** the reply to a fetch_block_transactions_message, transactions are in the order they were requested */
+   struct block_transactions_message
+   {
+      static const message_type_enum type;
+
+      bts::blockchain::block_id_type                   block_id;
+      std::vector<bts::blockchain::signed_transaction> transactions;
+   };
+
+   /**
+    *  Several trx_messages requested in one fetch_items_message, sent back together.  Each transaction is
+    *  handled as if it had arrived in its own trx_message, so it is still identified by that message's hash.
+    */
+   struct trx_batch_message
+   {
+      static const message_type_enum type;
+
+      std::vector<bts::blockchain::signed_transaction> transactions;
+   };
+
 } } // bts::client
 
-FC_REFLECT_ENUM( bts::client::message_type_enum, (trx_message_type)(block_message_type) )
+FC_REFLECT_ENUM( bts::client::message_type_enum, (trx_message_type)(block_message_type)(compact_block_message_type)
+                                                 (fetch_block_transactions_message_type)(block_transactions_message_type)
+                                                 (trx_batch_message_type) )
 FC_REFLECT( bts::client::trx_message, (trx) )
 FC_REFLECT( bts::client::block_message, (block)(block_id) )
+FC_REFLECT( bts::client::compact_block_message, (block_header)(short_transaction_ids)(block_message_hash) )
+FC_REFLECT( bts::client::fetch_block_transactions_message, (block_id)(transaction_indexes) )
+FC_REFLECT( bts::client::block_transactions_message, (block_id)(transactions) )
+FC_REFLECT( bts::client::trx_batch_message, (transactions) )
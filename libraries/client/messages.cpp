@@ -1,7 +1,32 @@
 #include <bts/client/messages.hpp>
+
+#include <fc/crypto/city.hpp>
+
 namespace bts { namespace client {
 
-   const message_type_enum trx_message::type                 = message_type_enum::trx_message_type;
-   const message_type_enum block_message::type               = message_type_enum::block_message_type;
+   const message_type_enum trx_message::type                      = message_type_enum::trx_message_type;
+   const message_type_enum block_message::type                    = message_type_enum::block_message_type;
+   const message_type_enum compact_block_message::type            = message_type_enum::compact_block_message_type;
+   const message_type_enum fetch_block_transactions_message::type = message_type_enum::fetch_block_transactions_message_type;
+   const message_type_enum block_transactions_message::type       = message_type_enum::block_transactions_message_type;
+   const message_type_enum trx_batch_message::type                = message_type_enum::trx_batch_message_type;
+
+   compact_block_message::compact_block_message(const block_message& full_block_message, const fc::uint160_t& block_message_hash) :
+     block_header(full_block_message.block),
+     block_message_hash(block_message_hash)
+   {
+      short_transaction_ids.reserve(full_block_message.block.user_transactions.size());
+      for (const bts::blockchain::signed_transaction& transaction : full_block_message.block.user_transactions)
+         short_transaction_ids.push_back(short_transaction_id(full_block_message.block_id, transaction.id()));
+   }
+
+   short_transaction_id_type compact_block_message::short_transaction_id(const bts::blockchain::block_id_type& block_id,
+                                                                         const bts::blockchain::transaction_id_type& transaction_id)
+   {
+      char salted_id[sizeof(block_id) + sizeof(transaction_id)];
+      memcpy(salted_id, (const char*)&block_id, sizeof(block_id));
+      memcpy(salted_id + sizeof(block_id), (const char*)&transaction_id, sizeof(transaction_id));
+      return fc::city_hash64(salted_id, sizeof(salted_id));
+   }
 
 } } // bts::client
@@ -67,7 +67,9 @@ bts::net::message_propagation_data detail::client_impl::network_get_block_propag
 
 fc::variant_object client_impl::network_get_info() const
 {
-   return _p2p_node->network_get_info();
+   fc::mutable_variant_object info(_p2p_node->network_get_info());
+   info["chain_apply_queue"] = get_chain_apply_queue_stats();
+   return info;
 }
 
 fc::variant_object client_impl::network_get_usage_stats() const
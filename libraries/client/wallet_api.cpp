@@ -548,6 +548,15 @@ vector<pretty_transaction> detail::client_impl::wallet_account_transaction_histo
   }
 } FC_RETHROW_EXCEPTIONS( warn, "") }
 
+pretty_transaction_page detail::client_impl::wallet_account_transaction_history_page( const string& account_name,
+                                                                                      const string& asset_symbol,
+                                                                                      uint32_t limit,
+                                                                                      uint32_t start_block_num,
+                                                                                      const string& start_record_id )const
+{ try {
+  return _wallet->get_pretty_transaction_history_page( account_name, asset_symbol, start_block_num, start_record_id, limit );
+} FC_RETHROW_EXCEPTIONS( warn, "", ("account_name",account_name)("start_block_num",start_block_num)("start_record_id",start_record_id) ) }
+
 void detail::client_impl::wallet_remove_transaction( const string& transaction_id )
 { try {
    _wallet->remove_transaction_record( transaction_id );
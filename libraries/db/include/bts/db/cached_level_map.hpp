@@ -11,13 +11,34 @@ namespace bts { namespace db {
    {
       public:
          void open( const fc::path& dir, bool create = true, bool flush_on_store = true )
+         {
+           open( dir, level_map_options(), create, flush_on_store );
+         }
+
+         /** reads are served from the cache, so the initial scan does not need to fill LevelDB's */
+         void open( const fc::path& dir, level_map_options options, bool create = true, bool flush_on_store = true )
          {
            _flush_on_store = flush_on_store;
-           _db.open( dir, create );
+           options.fill_cache_on_scan = false;
+           _db.open( dir, options, create );
            for( auto itr = _db.begin(); itr.valid(); ++itr )
               _cache[itr.key()]  = itr.value();
          }
 
+         /** the cache is loaded when @a database is opened */
+         void open( level_database& database, const std::string& keyspace,
+                    level_map_options options = level_map_options(), bool flush_on_store = true )
+         {
+           _flush_on_store = flush_on_store;
+           options.fill_cache_on_scan = false;
+           _db.open( database, keyspace, options );
+           database.on_open( [this]()
+           {
+              for( auto itr = _db.begin(); itr.valid(); ++itr )
+                 _cache[itr.key()]  = itr.value();
+           } );
+         }
+
          void close()
          {
             if(_pending_flush.valid() )
@@ -41,8 +62,21 @@ namespace bts { namespace db {
             _flush_on_store = should_flush;
          }
 
+         /** in a batch the writes go to the map's pending writes, so they join its write group when committed */
          void flush()
          {
+            if( _db.in_batch() )
+            {
+               for( const auto& item : _dirty )
+                 _db.store( item, _cache[item] );
+               for( const auto& item : _dirty_remove )
+                 _db.remove( item );
+
+               _dirty.clear();
+               _dirty_remove.clear();
+               return;
+            }
+
             typename level_map<Key, Value>::write_batch batch = _db.create_batch();
             for( const auto& item : _dirty )
               batch.store(item, _cache[item]);
@@ -54,6 +88,42 @@ namespace bts { namespace db {
             _dirty_remove.clear();
          }
 
+         /**
+          *  Defers all writes until commit_batch(), which writes them to the database as a single
+          *  atomic batch.  Reads are served from the cache so they are unaffected.
+          */
+         void begin_batch()
+         {
+            if( _pending_flush.valid() && !_pending_flush.ready() )
+               _pending_flush.wait();
+            flush();
+            _flush_on_store_before_batch = _flush_on_store;
+            _flush_on_store = false;
+            _db.begin_batch();
+         }
+
+         bool in_batch()const { return _db.in_batch(); }
+
+         void commit_batch( bool sync = false )
+         {
+            flush();
+            _db.commit_batch( sync );
+            _flush_on_store = _flush_on_store_before_batch;
+         }
+
+         /** discards the deferred writes and reloads the cache from the database */
+         void abort_batch()
+         {
+            _dirty.clear();
+            _dirty_remove.clear();
+            _db.abort_batch();
+            _flush_on_store = _flush_on_store_before_batch;
+
+            _cache.clear();
+            for( auto itr = _db.begin(); itr.valid(); ++itr )
+               _cache[itr.key()]  = itr.value();
+         }
+
         fc::optional<Value> fetch_optional( const Key& k )
         {
            auto itr = _cache.find(k);
@@ -108,6 +178,7 @@ namespace bts { namespace db {
               _db.remove(key);
               _dirty.erase(key);
            } else {
+              _dirty.erase(key);
               _dirty_remove.insert(key);
            }
         } FC_CAPTURE_AND_RETHROW( (key) ) }
@@ -191,6 +262,7 @@ namespace bts { namespace db {
         std::set<Key>            _dirty_remove;
         level_map<Key,Value>     _db;
         bool                     _flush_on_store;
+        bool                     _flush_on_store_before_batch = true;
         fc::future<void>         _pending_flush;
    };
 
@@ -0,0 +1,80 @@
+#pragma once
+#include <bts/db/exception.hpp>
+#include <leveldb/db.h>
+#include <leveldb/cache.h>
+#include <leveldb/comparator.h>
+#include <leveldb/filter_policy.h>
+#include <leveldb/write_batch.h>
+
+#include <fc/filesystem.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bts { namespace db {
+
+  namespace ldb = leveldb;
+
+  struct level_database_options
+  {
+     uint64_t block_cache_size  = 64 * 1024 * 1024;
+     uint64_t write_buffer_size = 16 * 1024 * 1024;
+     uint32_t max_open_files    = 256;
+     /**
+      *  Bits per key, 0 disables the filter.  The filter hashes the raw key bytes, so it may only be enabled
+      *  when no two keys with different bytes compare equal in any keyspace's comparator.
+      */
+     uint32_t bloom_filter_bits = 0;
+  };
+
+  /**
+   *  @brief a single LevelDB instance shared by many level_maps, each storing its keys in a named keyspace
+   *
+   *  All keyspaces share one memtable, write-ahead log, block cache and set of open files, so the memory
+   *  and file handles used no longer grow with the number of maps.  Writes to several keyspaces can be
+   *  grouped into one atomic batch with begin_write_group() / commit_write_group().
+   *
+   *  Keys are stored as a keyspace prefix followed by the packed key, and the keyspace's own comparator
+   *  orders the keys within it.  Because LevelDB may compare any two keys as soon as it is opened, every
+   *  keyspace must be added before open().
+   */
+  class level_database
+  {
+     public:
+        level_database();
+        ~level_database();
+
+        /** @return the prefix every key in the keyspace starts with */
+        std::string  add_keyspace( const std::string& name, const ldb::Comparator* comparator );
+
+        /** registers a callback to run once the database has been opened, used by maps that load a cache */
+        void         on_open( const std::function<void()>& callback );
+
+        void         open( const fc::path& dir, const level_database_options& options = level_database_options() );
+        void         close();
+        bool         is_open()const;
+        ldb::DB*     get_db()const;
+
+        /** until commit_write_group(), batches committed by level_maps in this database are combined */
+        void         begin_write_group();
+        bool         in_write_group()const;
+        ldb::WriteBatch& get_write_group();
+        void         commit_write_group( bool sync = false );
+
+     private:
+        class keyspace_compare;
+
+        std::unique_ptr<keyspace_compare>    _comparer;
+        std::unique_ptr<ldb::Cache>          _cache;
+        std::unique_ptr<const ldb::FilterPolicy> _filter_policy;
+        std::unique_ptr<ldb::DB>             _db;
+        std::unique_ptr<ldb::WriteBatch>     _write_group;
+        std::vector<std::function<void()>>   _open_callbacks;
+  };
+
+} } // bts::db
+
+FC_REFLECT( bts::db::level_database_options, (block_cache_size)(write_buffer_size)(max_open_files)(bloom_filter_bits) )
@@ -1,8 +1,10 @@
 #pragma once
 #include <bts/db/exception.hpp>
+#include <bts/db/level_database.hpp>
 #include <leveldb/db.h>
 #include <leveldb/comparator.h>
 #include <leveldb/cache.h>
+#include <leveldb/filter_policy.h>
 #include <leveldb/write_batch.h>
 
 #include <fc/filesystem.hpp>
@@ -17,29 +19,60 @@
 #include <fc/io/json.hpp>
 
 #include <fstream>
+#include <map>
 
 namespace bts { namespace db {
 
   namespace ldb = leveldb;
 
+  /**
+   *  Tuning for a level_map with its own LevelDB instance, zero leaves the LevelDB default.  Maps that are a
+   *  keyspace of a level_database share its settings and only use fill_cache_on_scan.
+   */
+  struct level_map_options
+  {
+     uint32_t bloom_filter_bits  = 0; ///< bits per key, speeds up lookups of keys that are not there
+     uint64_t block_cache_size   = 0;
+     uint64_t write_buffer_size  = 0;
+     uint32_t max_open_files     = 0;
+     bool     fill_cache_on_scan = true; ///< false keeps full scans from evicting the blocks used by lookups
+  };
+
   /**
    *  @brief implements a high-level API on top of Level DB that stores items using fc::raw / reflection
    *
+   *  A level_map either owns its own LevelDB instance or is a keyspace inside a shared level_database.
    */
   template<typename Key, typename Value>
   class level_map
   {
      public:
         void open( const fc::path& dir, bool create = true, size_t cache_size = 0 )
+        {
+           level_map_options options;
+           options.block_cache_size = cache_size;
+           open( dir, options, create );
+        }
+
+        void open( const fc::path& dir, const level_map_options& options, bool create = true )
         { try {
            ldb::Options opts;
            opts.comparator = &_comparer;
            opts.create_if_missing = create;
 
-           if (cache_size) {
-               _cache.reset(leveldb::NewLRUCache(cache_size));
+           if( options.block_cache_size ) {
+               _cache.reset(leveldb::NewLRUCache(options.block_cache_size));
                opts.block_cache = _cache.get();
            }
+           if( options.bloom_filter_bits ) {
+               _filter_policy.reset(leveldb::NewBloomFilterPolicy(options.bloom_filter_bits));
+               opts.filter_policy = _filter_policy.get();
+           }
+           if( options.write_buffer_size )
+               opts.write_buffer_size = options.write_buffer_size;
+           if( options.max_open_files )
+               opts.max_open_files = options.max_open_files;
+           _scan_options.fill_cache = options.fill_cache_on_scan;
            /*
            if( ldb::kMajorVersion > 1 || ( leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16 ) )
            {
@@ -47,11 +80,8 @@ namespace bts { namespace db {
                // on corruption in later versions.
                opts.paranoid_checks = true;
            }
-           opts.max_open_files = 64;
 
            _read_options.verify_checksums = true;
-           _iter_options.verify_checksums = true;
-           _iter_options.fill_cache = false;
            _sync_options.sync = true;
            */
 
@@ -73,15 +103,35 @@ namespace bts { namespace db {
            try_upgrade_db( dir,ndb, fc::get_typename<Value>::name(),sizeof(Value) );
         } FC_RETHROW_EXCEPTIONS( warn, "" ) }
 
+        /**
+         *  Stores this map as @a keyspace inside @a database, which must not be open yet.  The map
+         *  becomes usable once the database is opened.
+         */
+        void open( level_database& database, const std::string& keyspace,
+                   const level_map_options& options = level_map_options() )
+        { try {
+           _scan_options.fill_cache = options.fill_cache_on_scan;
+           _key_prefix = database.add_keyspace( keyspace, &_comparer );
+           // the name followed by a zero byte sorts after this keyspace and before any keyspace whose name extends it
+           _key_prefix_end = std::string( 1, char( keyspace.size() + 1 ) ) + keyspace + std::string( 1, '\0' );
+           _shared = &database;
+        } FC_RETHROW_EXCEPTIONS( warn, "", ("keyspace",keyspace) ) }
+
         bool is_open()const
         {
-          return !!_db;
+          return get_db() != nullptr;
         }
 
         void close()
         {
+          _pending_writes.clear();
+          _in_batch = false;
           _db.reset();
           _cache.reset();
+          _filter_policy.reset();
+          _shared = nullptr;
+          _key_prefix.clear();
+          _key_prefix_end.clear();
         }
 
         fc::optional<Value> fetch_optional( const Key& k )
@@ -97,10 +147,17 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           std::vector<char> kslice = fc::raw::pack( k );
-           ldb::Slice ks( kslice.data(), kslice.size() );
+           auto pending_itr = _pending_writes.find( k );
+           if( pending_itr != _pending_writes.end() )
+           {
+             if( !pending_itr->second.valid() )
+               FC_THROW_EXCEPTION( fc::key_not_found_exception, "unable to find key ${key}", ("key",k) );
+             return *pending_itr->second;
+           }
+
+           const std::string kslice = pack_key( k );
            std::string value;
-           auto status = _db->Get( ldb::ReadOptions(), ks, &value );
+           auto status = get_db()->Get( ldb::ReadOptions(), kslice, &value );
            if( status.IsNotFound() )
            {
              FC_THROW_EXCEPTION( fc::key_not_found_exception, "unable to find key ${key}", ("key",k) );
@@ -115,48 +172,189 @@ namespace bts { namespace db {
            return tmp;
         } FC_RETHROW_EXCEPTIONS( warn, "error fetching key ${key}", ("key",k) ); }
 
+        /**
+         *  Returns the value as it is stored, the fc::raw packed Value, without unpacking it.  Lets
+         *  callers that only pass the value along (e.g. blocks served to peers) skip the round trip.
+         */
+        fc::optional<std::vector<char>> fetch_raw_optional( const Key& k )
+        { try {
+           FC_ASSERT( is_open(), "Database is not open!" );
+
+           auto pending_itr = _pending_writes.find( k );
+           if( pending_itr != _pending_writes.end() )
+           {
+             if( !pending_itr->second.valid() )
+               return fc::optional<std::vector<char>>();
+             return fc::raw::pack( *pending_itr->second );
+           }
+
+           const std::string kslice = pack_key( k );
+           std::string value;
+           auto status = get_db()->Get( ldb::ReadOptions(), kslice, &value );
+           if( status.IsNotFound() )
+             return fc::optional<std::vector<char>>();
+           if( !status.ok() )
+           {
+               FC_THROW_EXCEPTION( db_exception, "database error: ${msg}", ("msg", status.ToString() ) );
+           }
+           return std::vector<char>( value.begin(), value.end() );
+        } FC_RETHROW_EXCEPTIONS( warn, "error fetching key ${key}", ("key",k) ); }
+
+        std::vector<char> fetch_raw( const Key& k )
+        { try {
+           fc::optional<std::vector<char>> value = fetch_raw_optional( k );
+           if( !value.valid() )
+             FC_THROW_EXCEPTION( fc::key_not_found_exception, "unable to find key ${key}", ("key",k) );
+           return std::move( *value );
+        } FC_RETHROW_EXCEPTIONS( warn, "error fetching key ${key}", ("key",k) ); }
+
+        /** writes buffered by begin_batch(), an unset value records a removal */
+        typedef std::map< Key, fc::optional<Value> > pending_writes_type;
+
+        /**
+         *  Iterates the database in key order.  While a batch is open the buffered writes are
+         *  merged in, shadowing the values on disk.
+         */
         class iterator
         {
            public:
              iterator(){}
              bool valid()const
              {
-                return _it && _it->Valid();
+                if( _pending ) return _source != none;
+                return db_valid();
              }
 
              Key key()const
              {
-                 Key tmp_key;
-                 fc::datastream<const char*> ds2( _it->key().data(), _it->key().size() );
-                 fc::raw::unpack( ds2, tmp_key );
-                 return tmp_key;
+                 if( _source == from_pending ) return _pending_it->first;
+                 return unpack_key( _it->key() );
              }
 
              Value value()const
              {
+               if( _source == from_pending ) return *_pending_it->second;
                Value tmp_val;
                fc::datastream<const char*> ds( _it->value().data(), _it->value().size() );
                fc::raw::unpack( ds, tmp_val );
                return tmp_val;
              }
 
-             iterator& operator++()    { _it->Next(); return *this; }
-             iterator& operator--()    { _it->Prev(); return *this; }
+             iterator& operator++()
+             {
+                if( !_pending ) { _it->Next(); return *this; }
+
+                const Key k = key();
+                seek( k );
+                if( db_valid() && keys_equal( unpack_key( _it->key() ), k ) ) _it->Next();
+                _pending_it = _pending->upper_bound( k );
+                settle_forward();
+                return *this;
+             }
+
+             iterator& operator--()
+             {
+                if( !_pending ) { _it->Prev(); return *this; }
+
+                const Key k = key();
+                seek( k );
+                if( _it->Valid() ) _it->Prev();
+                else _map->seek_to_last( *_it );
+                _pending_it = _pending->lower_bound( k );
+                if( _pending_it == _pending->begin() ) _pending_it = _pending->end();
+                else --_pending_it;
+                settle_backward();
+                return *this;
+             }
 
            protected:
              friend class level_map;
-             iterator( ldb::Iterator* it )
-             :_it(it){}
+             enum source_type { none, from_db, from_pending };
+
+             iterator( ldb::Iterator* it, const level_map* map )
+             :_it(it),_map(map),_pending( map->_pending_writes.empty() ? nullptr : &map->_pending_writes ){}
+
+             /** the LevelDB iterator is on a key of this map, and not past the end of its keyspace */
+             bool db_valid()const
+             {
+                return _it && _it->Valid() && _it->key().starts_with( _map->_key_prefix );
+             }
+
+             Key unpack_key( const ldb::Slice& key_slice )const
+             {
+                 Key tmp_key;
+                 const size_t prefix_size = _map->_key_prefix.size();
+                 fc::datastream<const char*> ds2( key_slice.data() + prefix_size, key_slice.size() - prefix_size );
+                 fc::raw::unpack( ds2, tmp_key );
+                 return tmp_key;
+             }
+
+             void seek( const Key& k )
+             {
+                 _it->Seek( _map->pack_key( k ) );
+             }
 
-             std::shared_ptr<ldb::Iterator> _it;
+             /** picks the smaller of the two positions, skipping shadowed and removed keys */
+             void settle_forward()
+             {
+                while( true )
+                {
+                   const bool on_db = db_valid();
+                   const bool pending_valid = _pending_it != _pending->end();
+                   if( !pending_valid )
+                   {
+                      _source = on_db ? from_db : none;
+                      return;
+                   }
+                   if( on_db )
+                   {
+                      const Key db_key = unpack_key( _it->key() );
+                      if( db_key < _pending_it->first ) { _source = from_db; return; }
+                      if( keys_equal( db_key, _pending_it->first ) ) _it->Next();
+                   }
+                   if( _pending_it->second.valid() ) { _source = from_pending; return; }
+                   ++_pending_it;
+                }
+             }
+
+             /** mirror of settle_forward(), _pending_it == end() means there is no earlier pending write */
+             void settle_backward()
+             {
+                while( true )
+                {
+                   const bool on_db = db_valid();
+                   const bool pending_valid = _pending_it != _pending->end();
+                   if( !pending_valid )
+                   {
+                      _source = on_db ? from_db : none;
+                      return;
+                   }
+                   if( on_db )
+                   {
+                      const Key db_key = unpack_key( _it->key() );
+                      if( _pending_it->first < db_key ) { _source = from_db; return; }
+                      if( keys_equal( db_key, _pending_it->first ) ) _it->Prev();
+                   }
+                   if( _pending_it->second.valid() ) { _source = from_pending; return; }
+                   if( _pending_it == _pending->begin() ) _pending_it = _pending->end();
+                   else --_pending_it;
+                }
+             }
+
+             std::shared_ptr<ldb::Iterator>                  _it;
+             const level_map*                                _map = nullptr;
+             const pending_writes_type*                      _pending = nullptr;
+             typename pending_writes_type::const_iterator    _pending_it;
+             source_type                                     _source = none;
         };
 
         iterator begin() const
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           iterator itr( _db->NewIterator( ldb::ReadOptions() ) );
-           itr._it->SeekToFirst();
+           iterator itr( get_db()->NewIterator( _scan_options ), this );
+           if( _key_prefix.empty() ) itr._it->SeekToFirst();
+           else itr._it->Seek( _key_prefix );
 
            if( itr._it->status().IsNotFound() )
            {
@@ -167,6 +365,12 @@ namespace bts { namespace db {
                FC_THROW_EXCEPTION( db_exception, "database error: ${msg}", ("msg", itr._it->status().ToString() ) );
            }
 
+           if( itr._pending )
+           {
+              itr._pending_it = _pending_writes.begin();
+              itr.settle_forward();
+           }
+
            if( itr.valid() )
            {
               return itr;
@@ -178,6 +382,17 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
+           if( !_pending_writes.empty() )
+           {
+              auto pending_itr = _pending_writes.find( key );
+              if( pending_itr != _pending_writes.end() && !pending_itr->second.valid() )
+                 return iterator();
+              iterator itr = lower_bound( key );
+              if( itr.valid() && keys_equal( itr.key(), key ) )
+                 return itr;
+              return iterator();
+           }
+
            ldb::Slice key_slice;
 
            /** avoid dynamic memory allocation at this step if possible, most
@@ -185,23 +400,25 @@ namespace bts { namespace db {
             * memory allocation to seralize the key.
             */
            fc::array<char,256+sizeof(Key)>  stack_buffer;
+           std::string                      heap_buffer;
 
-           size_t pack_size = fc::raw::pack_size(key);
+           size_t pack_size = _key_prefix.size() + fc::raw::pack_size(key);
            if( pack_size <= stack_buffer.size() )
            {
               fc::datastream<char*> ds( stack_buffer.data, stack_buffer.size() );
+              ds.write( _key_prefix.data(), _key_prefix.size() );
               fc::raw::pack( ds ,key );
               key_slice = ldb::Slice( stack_buffer.data, pack_size );
            }
            else
            {
-              auto kslice = fc::raw::pack( key );
-              key_slice = ldb::Slice( kslice.data(), kslice.size() );
+              heap_buffer = pack_key( key );
+              key_slice = ldb::Slice( heap_buffer );
            }
 
-           iterator itr( _db->NewIterator( ldb::ReadOptions() ) );
+           iterator itr( get_db()->NewIterator( ldb::ReadOptions() ), this );
            itr._it->Seek( key_slice );
-           if( itr.valid() && itr.key() == key )
+           if( itr.valid() && keys_equal( itr.key(), key ) )
            {
               return itr;
            }
@@ -212,11 +429,13 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           std::vector<char> kslice = fc::raw::pack( key );
-           ldb::Slice key_slice( kslice.data(), kslice.size() );
-
-           iterator itr( _db->NewIterator( ldb::ReadOptions() ) );
-           itr._it->Seek( key_slice );
+           iterator itr( get_db()->NewIterator( _scan_options ), this );
+           itr._it->Seek( pack_key( key ) );
+           if( itr._pending )
+           {
+              itr._pending_it = _pending_writes.lower_bound( key );
+              itr.settle_forward();
+           }
            return itr;
         } FC_RETHROW_EXCEPTIONS( warn, "error finding ${key}", ("key",key) ) }
 
@@ -224,8 +443,13 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           iterator itr( _db->NewIterator( ldb::ReadOptions() ) );
-           itr._it->SeekToLast();
+           iterator itr( get_db()->NewIterator( _scan_options ), this );
+           seek_to_last( *itr._it );
+           if( itr._pending )
+           {
+              itr._pending_it = --_pending_writes.end();
+              itr.settle_backward();
+           }
            return itr;
         } FC_RETHROW_EXCEPTIONS( warn, "error finding last" ) }
 
@@ -233,15 +457,12 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           std::unique_ptr<ldb::Iterator> it( _db->NewIterator( ldb::ReadOptions() ) );
-           FC_ASSERT( it != nullptr );
-           it->SeekToLast();
-           if( !it->Valid() )
+           iterator itr = last();
+           if( !itr.valid() )
            {
              return false;
            }
-           fc::datastream<const char*> ds2( it->key().data(), it->key().size() );
-           fc::raw::unpack( ds2, k );
+           k = itr.key();
            return true;
         } FC_RETHROW_EXCEPTIONS( warn, "error reading last item from database" ); }
 
@@ -249,18 +470,13 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           std::unique_ptr<ldb::Iterator> it( _db->NewIterator( ldb::ReadOptions() ) );
-           FC_ASSERT( it != nullptr );
-           it->SeekToLast();
-           if( !it->Valid() )
+           iterator itr = last();
+           if( !itr.valid() )
            {
              return false;
            }
-           fc::datastream<const char*> ds( it->value().data(), it->value().size() );
-           fc::raw::unpack( ds, v );
-
-           fc::datastream<const char*> ds2( it->key().data(), it->key().size() );
-           fc::raw::unpack( ds2, k );
+           k = itr.key();
+           v = itr.value();
            return true;
         } FC_RETHROW_EXCEPTIONS( warn, "error reading last item from database" ); }
 
@@ -307,7 +523,7 @@ namespace bts { namespace db {
             {
               FC_ASSERT(_map->is_open(), "Database is not open!");
 
-              ldb::Status status = _map->_db->Write(ldb::WriteOptions(), &_batch);
+              ldb::Status status = _map->get_db()->Write(ldb::WriteOptions(), &_batch);
               if (status.IsNotFound())
                 FC_THROW_EXCEPTION(fc::key_not_found_exception, "unable to find key while applying batch");
               if (!status.ok())
@@ -324,20 +540,15 @@ namespace bts { namespace db {
 
           void store(const Key& k, const Value& v)
           {
-            std::vector<char> kslice = fc::raw::pack(k);
-            ldb::Slice ks(kslice.data(), kslice.size());
-
             auto vec = fc::raw::pack(v);
             ldb::Slice vs(vec.data(), vec.size());
 
-            _batch.Put(ks, vs);
+            _batch.Put(_map->pack_key(k), vs);
           }
 
           void remove(const Key& k, bool sync = false)
           {
-            std::vector<char> kslice = fc::raw::pack(k);
-            ldb::Slice ks(kslice.data(), kslice.size());
-            _batch.Delete(ks);
+            _batch.Delete(_map->pack_key(k));
           }
         };
 
@@ -350,13 +561,16 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           std::vector<char> kslice = fc::raw::pack( k );
-           ldb::Slice ks( kslice.data(), kslice.size() );
+           if( _in_batch )
+           {
+              _pending_writes[k] = v;
+              return;
+           }
 
            auto vec = fc::raw::pack(v);
            ldb::Slice vs( vec.data(), vec.size() );
 
-           auto status = _db->Put( ldb::WriteOptions(), ks, vs );
+           auto status = get_db()->Put( ldb::WriteOptions(), pack_key( k ), vs );
            if( !status.ok() )
            {
                FC_THROW_EXCEPTION( db_exception, "database error: ${msg}", ("msg", status.ToString() ) );
@@ -367,9 +581,13 @@ namespace bts { namespace db {
         { try {
            FC_ASSERT( is_open(), "Database is not open!" );
 
-           std::vector<char> kslice = fc::raw::pack( k );
-           ldb::Slice ks( kslice.data(), kslice.size() );
-           auto status = _db->Delete( ldb::WriteOptions(), ks );
+           if( _in_batch )
+           {
+              _pending_writes[k] = fc::optional<Value>();
+              return;
+           }
+
+           auto status = get_db()->Delete( ldb::WriteOptions(), pack_key( k ) );
            if( status.IsNotFound() )
            {
              FC_THROW_EXCEPTION( fc::key_not_found_exception, "unable to find key ${key}", ("key",k) );
@@ -380,6 +598,72 @@ namespace bts { namespace db {
            }
         } FC_RETHROW_EXCEPTIONS( warn, "error removing ${key}", ("key",k) ); }
 
+        /**
+         *  Buffers all following store() and remove() calls in memory until commit_batch(), reads
+         *  and iterators see the buffered writes.  This lets a caller group many writes into one
+         *  atomic LevelDB write.
+         */
+        void begin_batch()
+        {
+           FC_ASSERT( is_open(), "Database is not open!" );
+           _in_batch = true;
+        }
+
+        bool in_batch()const { return _in_batch; }
+
+        /** number of keys written or removed since begin_batch() */
+        size_t pending_batch_size()const { return _pending_writes.size(); }
+
+        /**
+         *  Writes the buffered changes as a single leveldb::WriteBatch and leaves batch mode.  If the
+         *  shared database has a write group open the changes are added to it instead.
+         */
+        void commit_batch( bool sync = false )
+        { try {
+           FC_ASSERT( is_open(), "Database is not open!" );
+
+           if( !_pending_writes.empty() )
+           {
+              // inside a write group of the shared database the changes are only added to the group
+              const bool in_write_group = _shared && _shared->in_write_group();
+              ldb::WriteBatch local_batch;
+              ldb::WriteBatch& batch = in_write_group ? _shared->get_write_group() : local_batch;
+              for( const auto& item : _pending_writes )
+              {
+                 const std::string kslice = pack_key( item.first );
+                 if( item.second.valid() )
+                 {
+                    auto vec = fc::raw::pack( *item.second );
+                    batch.Put( kslice, ldb::Slice( vec.data(), vec.size() ) );
+                 }
+                 else
+                 {
+                    batch.Delete( kslice );
+                 }
+              }
+
+              if( !in_write_group )
+              {
+                 ldb::WriteOptions write_options;
+                 write_options.sync = sync;
+                 auto status = get_db()->Write( write_options, &batch );
+                 if( !status.ok() )
+                 {
+                     FC_THROW_EXCEPTION( db_exception, "database error while applying batch: ${msg}", ("msg", status.ToString() ) );
+                 }
+              }
+           }
+           _pending_writes.clear();
+           _in_batch = false;
+        } FC_RETHROW_EXCEPTIONS( warn, "error committing batch" ) }
+
+        /** discards the buffered changes and leaves batch mode */
+        void abort_batch()
+        {
+           _pending_writes.clear();
+           _in_batch = false;
+        }
+
         void export_to_json( const fc::path& path )const
         { try {
             FC_ASSERT( !fc::exists( path ) );
@@ -413,6 +697,39 @@ namespace bts { namespace db {
         }
 
      private:
+        ldb::DB* get_db()const
+        {
+           return _shared ? _shared->get_db() : _db.get();
+        }
+
+        /**
+         *  Keys are matched by their ordering, as std::map and the LevelDB comparator do, because
+         *  some key types define operator== over fewer fields than operator<.
+         */
+        static bool keys_equal( const Key& a, const Key& b )
+        {
+           return !(a < b) && !(b < a);
+        }
+
+        /** the packed key behind this map's keyspace prefix, which is empty unless the database is shared */
+        std::string pack_key( const Key& k )const
+        {
+           std::string key_data = _key_prefix;
+           auto packed = fc::raw::pack( k );
+           key_data.append( packed.data(), packed.size() );
+           return key_data;
+        }
+
+        void seek_to_last( ldb::Iterator& it )const
+        {
+           if( _key_prefix.empty() )
+              return it.SeekToLast();
+
+           it.Seek( _key_prefix_end );
+           if( it.Valid() ) it.Prev();
+           else it.SeekToLast();
+        }
+
         class key_compare : public leveldb::Comparator
         {
           public:
@@ -424,9 +741,10 @@ namespace bts { namespace db {
                fc::datastream<const char*> dsb( b.data(), b.size() );
                fc::raw::unpack( dsb, bk );
 
-               if( ak  < bk ) return -1;
-               if( ak == bk ) return 0;
-               return 1;
+               // ordered by operator< alone, operator== of some keys compares fewer fields
+               if( ak < bk ) return -1;
+               if( bk < ak ) return 1;
+               return 0;
             }
 
             const char* Name()const { return "key_compare"; }
@@ -434,15 +752,24 @@ namespace bts { namespace db {
             void FindShortSuccessor( std::string* )const{};
         };
 
+        std::unique_ptr<const leveldb::FilterPolicy> _filter_policy;
         std::unique_ptr<leveldb::DB>    _db;
         std::unique_ptr<leveldb::Cache> _cache;
         key_compare                     _comparer;
+        level_database*                 _shared = nullptr;
+        std::string                     _key_prefix;
+        std::string                     _key_prefix_end;
+        pending_writes_type             _pending_writes;
+        bool                            _in_batch = false;
+        /** used by begin(), lower_bound() and last(), find() and fetch() always fill the cache */
+        ldb::ReadOptions                _scan_options;
         /*
         ldb::ReadOptions                _read_options;
-        ldb::ReadOptions                _iter_options;
         ldb::WriteOptions               _write_options;
         ldb::WriteOptions               _sync_options;
         */
   };
 
 } } // bts::db
+
+FC_REFLECT( bts::db::level_map_options, (bloom_filter_bits)(block_cache_size)(write_buffer_size)(max_open_files)(fill_cache_on_scan) )
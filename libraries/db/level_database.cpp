@@ -0,0 +1,180 @@
+#include <bts/db/level_database.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+
+#include <utility>
+
+namespace bts { namespace db {
+
+  /**
+   *  Orders keys by keyspace name first and then by the comparator of their keyspace.  A key is
+   *  stored as one length byte, the keyspace name and the packed key.
+   */
+  class level_database::keyspace_compare : public ldb::Comparator
+  {
+     public:
+        int Compare( const ldb::Slice& a, const ldb::Slice& b )const
+        {
+           ldb::Slice a_name, a_key, b_name, b_key;
+           split( a, a_name, a_key );
+           split( b, b_name, b_key );
+
+           int result = a_name.compare( b_name );
+           if( result != 0 ) return result;
+
+           const ldb::Comparator* comparator = find( a_name );
+           if( comparator == nullptr ) return a_key.compare( b_key );
+           return comparator->Compare( a_key, b_key );
+        }
+
+        const char* Name()const { return "bts.keyspace_compare"; }
+        void FindShortestSeparator( std::string*, const ldb::Slice& )const{}
+        void FindShortSuccessor( std::string* )const{}
+
+        std::vector<std::pair<std::string, const ldb::Comparator*>> _keyspaces;
+
+     private:
+        static void split( const ldb::Slice& key, ldb::Slice& name, ldb::Slice& rest )
+        {
+           if( key.empty() || key.size() < size_t( 1 + uint8_t( key[0] ) ) )
+           {
+              name = key;
+              rest = ldb::Slice();
+              return;
+           }
+           const size_t name_size = uint8_t( key[0] );
+           name = ldb::Slice( key.data() + 1, name_size );
+           rest = ldb::Slice( key.data() + 1 + name_size, key.size() - 1 - name_size );
+        }
+
+        /** keyspaces that are no longer registered by anyone fall back to bytewise order */
+        const ldb::Comparator* find( const ldb::Slice& name )const
+        {
+           for( const auto& keyspace : _keyspaces )
+           {
+              if( keyspace.first.size() == name.size() && name.compare( keyspace.first ) == 0 )
+                 return keyspace.second;
+           }
+           return nullptr;
+        }
+  };
+
+  level_database::level_database()
+  :_comparer( new keyspace_compare() )
+  {
+  }
+
+  level_database::~level_database()
+  {
+     close();
+  }
+
+  std::string level_database::add_keyspace( const std::string& name, const ldb::Comparator* comparator )
+  { try {
+     FC_ASSERT( !is_open(), "Keyspaces must be added before the database is opened" );
+     FC_ASSERT( !name.empty() && name.size() < 255 );
+     for( const auto& keyspace : _comparer->_keyspaces )
+        FC_ASSERT( keyspace.first != name, "Keyspace ${name} was already added", ("name",name) );
+
+     _comparer->_keyspaces.emplace_back( name, comparator );
+     return std::string( 1, char( name.size() ) ) + name;
+  } FC_CAPTURE_AND_RETHROW( (name) ) }
+
+  void level_database::on_open( const std::function<void()>& callback )
+  {
+     _open_callbacks.push_back( callback );
+  }
+
+  void level_database::open( const fc::path& dir, const level_database_options& options )
+  { try {
+     FC_ASSERT( !is_open(), "Database is already open" );
+
+     ldb::Options opts;
+     opts.comparator = _comparer.get();
+     opts.create_if_missing = true;
+     opts.write_buffer_size = options.write_buffer_size;
+     opts.max_open_files = options.max_open_files;
+     if( options.block_cache_size )
+     {
+        _cache.reset( ldb::NewLRUCache( options.block_cache_size ) );
+        opts.block_cache = _cache.get();
+     }
+     if( options.bloom_filter_bits )
+     {
+        _filter_policy.reset( ldb::NewBloomFilterPolicy( options.bloom_filter_bits ) );
+        opts.filter_policy = _filter_policy.get();
+     }
+
+     fc::create_directories( dir );
+     std::string ldbPath = dir.to_native_ansi_path();
+
+     ldb::DB* ndb = nullptr;
+     auto ntrxstat = ldb::DB::Open( opts, ldbPath.c_str(), &ndb );
+     if( !ntrxstat.ok() )
+     {
+         FC_THROW_EXCEPTION( db_in_use_exception, "Unable to open database ${db}\n\t${msg}",
+              ("db",dir)
+              ("msg",ntrxstat.ToString())
+              );
+     }
+     _db.reset( ndb );
+
+     for( const auto& callback : _open_callbacks )
+        callback();
+  } FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+  /** closes the database and forgets all keyspaces, they have to be added again before reopening */
+  void level_database::close()
+  {
+     _write_group.reset();
+     _db.reset();
+     _cache.reset();
+     _filter_policy.reset();
+     _comparer->_keyspaces.clear();
+     _open_callbacks.clear();
+  }
+
+  bool level_database::is_open()const
+  {
+     return !!_db;
+  }
+
+  ldb::DB* level_database::get_db()const
+  {
+     return _db.get();
+  }
+
+  void level_database::begin_write_group()
+  {
+     FC_ASSERT( is_open(), "Database is not open!" );
+     _write_group.reset( new ldb::WriteBatch() );
+  }
+
+  bool level_database::in_write_group()const
+  {
+     return !!_write_group;
+  }
+
+  ldb::WriteBatch& level_database::get_write_group()
+  {
+     FC_ASSERT( in_write_group() );
+     return *_write_group;
+  }
+
+  void level_database::commit_write_group( bool sync )
+  { try {
+     FC_ASSERT( is_open(), "Database is not open!" );
+     FC_ASSERT( in_write_group() );
+
+     ldb::WriteOptions write_options;
+     write_options.sync = sync;
+     auto status = _db->Write( write_options, _write_group.get() );
+     _write_group.reset();
+     if( !status.ok() )
+     {
+         FC_THROW_EXCEPTION( db_exception, "database error while applying batch: ${msg}", ("msg", status.ToString() ) );
+     }
+  } FC_RETHROW_EXCEPTIONS( warn, "error committing write group" ) }
+
+} } // bts::db
@@ -2,6 +2,7 @@
 #include <bts/net/chain_downloader.hpp>
 #include <bts/net/chain_server_commands.hpp>
 
+#include <fc/compress/lzma.hpp>
 #include <fc/network/tcp_socket.hpp>
 #include <fc/io/raw_variant.hpp>
 #include <fc/thread/thread.hpp>
@@ -15,6 +16,12 @@ namespace bts { namespace net {
 
           std::unique_ptr<fc::tcp_socket> _client_socket;
           std::vector<fc::ip::endpoint> _chain_servers;
+          uint32_t _server_protocol_version = PROTOCOL_VERSION;
+          uint32_t _next_block_number = 0; ///< the first block we haven't received yet, where a new connection resumes
+          bool _use_compression = false;
+
+          /// abandon a server that hasn't delivered a block in this long
+          static const uint32_t CHAIN_DOWNLOADER_TIMEOUT_SEC = 10;
 
           void connect_to_chain_server()
           { try {
@@ -40,23 +47,133 @@ namespace bts { namespace net {
 
                   uint32_t protocol_version = -1;
                   fc::raw::unpack(*_client_socket, protocol_version);
-                  if (protocol_version != PROTOCOL_VERSION) {
+                  if (protocol_version < MINIMUM_PROTOCOL_VERSION || protocol_version > PROTOCOL_VERSION) {
                       wlog("Can't talk to chain server; he's using protocol ${srv} and I'm using ${cli}!",
                            ("srv", protocol_version)("cli", PROTOCOL_VERSION));
                       fc::raw::pack(*_client_socket, finish);
                       _client_socket->close();
+                      continue;
                   }
+                  if (protocol_version == ANNOUNCED_PROTOCOL_VERSION) {
+                      // version 0 servers answer the query with an empty block count, newer ones with their version
+                      fc::raw::pack(*_client_socket, get_blocks_from_number);
+                      fc::raw::pack(*_client_socket, PROTOCOL_VERSION_QUERY);
+                      fc::raw::unpack(*_client_socket, protocol_version);
+                      protocol_version = std::min(protocol_version, PROTOCOL_VERSION);
+                  }
+                  _server_protocol_version = protocol_version;
               }
           } FC_RETHROW_EXCEPTIONS(error, "") }
 
+          /** blocks are delivered one at a time with the legacy protocol, returns the number of blocks received */
+          uint32_t get_blocks_from_number(const std::function<void (const blockchain::full_block&, uint32_t)>& new_block_callback,
+                                          fc::time_point& checkpoint)
+          {
+              fc::raw::pack(*_client_socket, get_blocks_from_number);
+              fc::raw::pack(*_client_socket, _next_block_number);
+
+              uint32_t blocks_to_retrieve = 0;
+              uint32_t blocks_in = 0;
+              fc::raw::unpack(*_client_socket, blocks_to_retrieve);
+              ilog("Server at ${remote} is sending us ${num} blocks.",
+                   ("remote", _client_socket->remote_endpoint())("num", blocks_to_retrieve));
+
+              while(blocks_to_retrieve > 0)
+              {
+                  checkpoint = fc::time_point::now();
+                  blockchain::full_block block;
+                  fc::raw::unpack(*_client_socket, block);
+
+                  new_block_callback(block, blocks_to_retrieve);
+                  --blocks_to_retrieve;
+                  ++blocks_in;
+                  _next_block_number = block.block_num + 1;
+
+                  if(blocks_to_retrieve == 0) {
+                      fc::raw::unpack(*_client_socket, blocks_to_retrieve);
+                      if(blocks_to_retrieve > 0)
+                          ilog("Server at ${remote} is sending us ${num} blocks.",
+                               ("remote", _client_socket->remote_endpoint())("num", blocks_to_retrieve));
+                  }
+              }
+              return blocks_in;
+          }
+
+          block_batch read_block_batch()
+          {
+              block_batch batch;
+              fc::raw::unpack(*_client_socket, batch);
+              if (batch.compression == lzma_compression)
+              {
+                  batch.packed_blocks = fc::lzma_decompress(batch.packed_blocks);
+                  batch.compression = no_compression;
+              }
+              return batch;
+          }
+
+          /**
+           * blocks arrive in batches, the next batch is read from the socket while the blocks in the current one
+           * are handed to the callback.  Returns the number of blocks received
+           */
+          uint32_t get_block_batches_from_number(const std::function<void (const blockchain::full_block&, uint32_t)>& new_block_callback,
+                                                 fc::time_point& checkpoint)
+          {
+              fc::raw::pack(*_client_socket, get_block_batches_from_number);
+              fc::raw::pack(*_client_socket, _next_block_number);
+              fc::raw::pack(*_client_socket, _use_compression ? lzma_compression : no_compression);
+
+              uint32_t blocks_in = 0;
+              fc::future<block_batch> next_batch = fc::async([this]{ return read_block_batch(); }, "read_block_batch");
+              block_batch batch;
+              try
+              {
+                  do
+                  {
+                      batch = next_batch.wait();
+                      if (batch.block_count > 0)
+                          next_batch = fc::async([this]{ return read_block_batch(); }, "read_block_batch");
+                      FC_ASSERT(batch.block_count == 0 || batch.first_block_number == _next_block_number,
+                                "Server sent the wrong blocks, expected block ${expected} but got ${first}",
+                                ("expected", _next_block_number)("first", batch.first_block_number));
+
+                      fc::datastream<const char*> packed_blocks(batch.packed_blocks.data(), batch.packed_blocks.size());
+                      for (uint32_t i = 0; i < batch.block_count; ++i)
+                      {
+                          checkpoint = fc::time_point::now();
+                          blockchain::full_block block;
+                          fc::raw::unpack(packed_blocks, block);
+
+                          new_block_callback(block, batch.blocks_remaining + batch.block_count - i);
+                          ++blocks_in;
+                          _next_block_number = block.block_num + 1;
+                      }
+                  } while (batch.block_count > 0);
+              }
+              catch (...)
+              {
+                  // don't leave the read-ahead running on a socket that is about to be replaced
+                  if (next_batch.valid() && !next_batch.ready())
+                  {
+                      _client_socket->close();
+                      try { next_batch.cancel_and_wait(); } catch (...) {}
+                  }
+                  throw;
+              }
+              return blocks_in;
+          }
+
           void get_all_blocks(std::function<void (const blockchain::full_block&, uint32_t)> new_block_callback,
                               uint32_t first_block_number)
           { try {
               if (!new_block_callback)
                   return;
 
+              _next_block_number = first_block_number;
               fc::future<void> work_future;
               while(!_chain_servers.empty()) {
+                 uint32_t first_block_from_this_server = _next_block_number;
+                 fc::ip::endpoint server_endpoint;
+                 bool transfer_failed = true;
                  try {
                     fc::time_point checkpoint = fc::time_point::now();
 
@@ -64,60 +181,46 @@ namespace bts { namespace net {
                        connect_to_chain_server();
                        checkpoint = fc::time_point::now();
                        FC_ASSERT(_client_socket->is_open(), "unable to connect to any chain server");
+                       server_endpoint = _client_socket->remote_endpoint();
                        ilog("Connected to ${remote}; requesting blocks after ${num}",
-                            ("remote", _client_socket->remote_endpoint())("num", first_block_number));
+                            ("remote", server_endpoint)("num", _next_block_number));
 
-                       ulog("Starting fast-sync of blocks from ${num}", ("num", first_block_number));
+                       ulog("Starting fast-sync of blocks from ${num}", ("num", _next_block_number));
                        auto start_time = fc::time_point::now();
 
-                       fc::raw::pack(*_client_socket, get_blocks_from_number);
-                       fc::raw::pack(*_client_socket, first_block_number);
-
-                       uint32_t blocks_to_retrieve = 0;
-                       uint32_t blocks_in = 0;
-                       fc::raw::unpack(*_client_socket, blocks_to_retrieve);
-                       ilog("Server at ${remote} is sending us ${num} blocks.",
-                            ("remote", _client_socket->remote_endpoint())("num", blocks_to_retrieve));
-
-                       while(blocks_to_retrieve > 0)
-                       {
-                           checkpoint = fc::time_point::now();
-                           blockchain::full_block block;
-                           fc::raw::unpack(*_client_socket, block);
-
-                           new_block_callback(block, blocks_to_retrieve);
-                           --blocks_to_retrieve;
-                           ++blocks_in;
-
-                           if(blocks_to_retrieve == 0) {
-                               fc::raw::unpack(*_client_socket, blocks_to_retrieve);
-                               if(blocks_to_retrieve > 0)
-                                   ilog("Server at ${remote} is sending us ${num} blocks.",
-                                        ("remote", _client_socket->remote_endpoint())("num", blocks_to_retrieve));
-                           }
-                       }
+                       uint32_t blocks_in = _server_protocol_version >= 1 ?
+                                              get_block_batches_from_number(new_block_callback, checkpoint) :
+                                              get_blocks_from_number(new_block_callback, checkpoint);
                        checkpoint = fc::time_point::now();
 
                        ulog("Finished fast-syncing ${num} blocks at ${rate} blocks/sec.",
                             ("num", blocks_in)("rate", blocks_in/((fc::time_point::now() - start_time).count() / 1000000.0)));
                        wlog("Finished getting ${num} blocks from ${remote} at ${rate} blocks/sec.",
-                            ("num", blocks_in)("remote", _client_socket->remote_endpoint())
+                            ("num", blocks_in)("remote", server_endpoint)
                             ("rate", blocks_in/((fc::time_point::now() - start_time).count() / 1000000.0)));
                        fc::raw::pack(*_client_socket, finish);
                     }, "get_all_blocks worker");
 
                     while(!work_future.ready()) {
-                        if(fc::time_point::now() - checkpoint > fc::seconds(1)) {
+                        if(fc::time_point::now() - checkpoint > fc::seconds(CHAIN_DOWNLOADER_TIMEOUT_SEC)) {
                             work_future.cancel_and_wait("Timed out");
                             FC_THROW("Timed out");
                         }
                         fc::sleep_until(fc::time_point::now() + fc::milliseconds(500));
                     }
+                    work_future.wait();
+                    transfer_failed = false;
                  } catch(fc::canceled_exception) {
                       work_future.cancel_and_wait();
                       throw;
                  }
-                 FC_CAPTURE_AND_LOG((_client_socket->remote_endpoint()))
+                 FC_CAPTURE_AND_LOG((server_endpoint)(_next_block_number))
+
+                 // if the server was making progress, give it another chance after the others, resuming
+                 // from the first block we haven't received
+                 if (transfer_failed && _next_block_number != first_block_from_this_server &&
+                     server_endpoint != fc::ip::endpoint())
+                    _chain_servers.insert(_chain_servers.begin(), server_endpoint);
               }
           } FC_RETHROW_EXCEPTIONS(error, "", ("first_block_number", first_block_number)) }
       };
@@ -149,6 +252,11 @@ namespace bts { namespace net {
         my->_chain_servers.shrink_to_fit();
     }
 
+    void chain_downloader::set_compression_enabled(bool enabled)
+    {
+        my->_use_compression = enabled;
+    }
+
     fc::future<void> chain_downloader::get_all_blocks(std::function<void(const blockchain::full_block&,
                                                                          uint32_t)>
                                                                new_block_callback,
@@ -2,6 +2,7 @@
 #include <bts/net/chain_server.hpp>
 #include <bts/net/chain_server_commands.hpp>
 
+#include <fc/compress/lzma.hpp>
 #include <fc/io/raw_variant.hpp>
 #include <fc/thread/thread.hpp>
 #include <fc/network/ip.hpp>
@@ -74,6 +75,10 @@ namespace bts { namespace net {
               try {
                 uint32_t start_block;
                 fc::raw::unpack(connection_socket, start_block);
+                if (start_block == PROTOCOL_VERSION_QUERY) {
+                    fc::raw::pack(connection_socket, PROTOCOL_VERSION);
+                    return;
+                }
                 if (start_block == 0) start_block = 1;
                 uint32_t end_block = start_block;
 
@@ -85,7 +90,8 @@ namespace bts { namespace net {
                     ilog("Sending blocks from ${start} to ${finish} to ${remote}",
                          ("start", start_block)("finish", end_block)("remote", connection_socket.remote_endpoint()));
                     for (; start_block <= end_block; ++start_block) {
-                        fc::raw::pack(connection_socket, _chain_db->get_block(start_block));
+                        const std::vector<char> packed_block = _chain_db->get_packed_block(start_block);
+                        connection_socket.write(packed_block.data(), packed_block.size());
                         if (start_block % 10 == 0)
                             fc::yield();
                     }
@@ -97,10 +103,69 @@ namespace bts { namespace net {
               } FC_RETHROW_EXCEPTIONS(error, "", ("remote_endpoint", connection_socket.remote_endpoint()))
             }
 
+            /**
+             * Reads the blocks starting at first_block into a batch, stopping at the head block or once the batch
+             * reaches BLOCK_BATCH_TARGET_SIZE
+             */
+            block_batch read_block_batch(uint32_t first_block, block_batch_compression compression) {
+                block_batch batch;
+                batch.first_block_number = first_block;
+                const uint32_t head_block_num = _chain_db->get_head_block_num();
+
+                for (uint32_t block_num = first_block;
+                     block_num <= head_block_num &&
+                     batch.packed_blocks.size() < BLOCK_BATCH_TARGET_SIZE &&
+                     batch.block_count < BLOCK_BATCH_MAX_BLOCKS;
+                     ++block_num) {
+                    const std::vector<char> packed_block = _chain_db->get_packed_block(block_num);
+                    batch.packed_blocks.insert(batch.packed_blocks.end(), packed_block.begin(), packed_block.end());
+                    ++batch.block_count;
+                }
+                batch.blocks_remaining = head_block_num >= first_block + batch.block_count ?
+                                             head_block_num - (first_block + batch.block_count) + 1 : 0;
+
+                if (compression == lzma_compression && !batch.packed_blocks.empty()) {
+                    std::vector<char> compressed_blocks = fc::lzma_compress(batch.packed_blocks);
+                    if (compressed_blocks.size() < batch.packed_blocks.size()) {
+                        batch.packed_blocks = std::move(compressed_blocks);
+                        batch.compression = lzma_compression;
+                    }
+                }
+                return batch;
+            }
+
+            void handle_get_block_batches_from_number(fc::tcp_socket& connection_socket) {
+              try {
+                uint32_t start_block;
+                block_batch_compression compression;
+                fc::raw::unpack(connection_socket, start_block);
+                fc::raw::unpack(connection_socket, compression);
+                if (start_block == 0) start_block = 1;
+
+                ilog("Sending block batches from ${start} to ${remote}",
+                     ("start", start_block)("remote", connection_socket.remote_endpoint()));
+
+                // Read the next batch from the database while the current one is being written to the socket.
+                // A batch with no blocks tells the client it has caught up with our head block.
+                fc::future<block_batch> next_batch = fc::async([=]{ return read_block_batch(start_block, compression); },
+                                                               "read_block_batch");
+                block_batch batch;
+                do {
+                    batch = next_batch.wait();
+                    if (batch.block_count > 0) {
+                        uint32_t following_block = batch.first_block_number + batch.block_count;
+                        next_batch = fc::async([=]{ return read_block_batch(following_block, compression); },
+                                               "read_block_batch");
+                    }
+                    fc::raw::pack(connection_socket, batch);
+                } while (batch.block_count > 0);
+              } FC_RETHROW_EXCEPTIONS(error, "", ("remote_endpoint", connection_socket.remote_endpoint()))
+            }
+
             void serve_client(fc::tcp_socket* connection_socket) {
               try {
                 FC_ASSERT(connection_socket->is_open());
-                fc::raw::pack(*connection_socket, PROTOCOL_VERSION);
+                fc::raw::pack(*connection_socket, ANNOUNCED_PROTOCOL_VERSION);
 
                 chain_server_commands request;
                 fc::raw::unpack(*connection_socket, request);
@@ -111,6 +176,9 @@ namespace bts { namespace net {
                       case get_blocks_from_number:
                         handle_get_blocks_from_number(*connection_socket);
                         break;
+                      case get_block_batches_from_number:
+                        handle_get_block_batches_from_number(*connection_socket);
+                        break;
                       case finish:
                         break;
                     }
@@ -40,6 +40,12 @@ namespace bts { namespace net {
          */
         void add_chain_servers(const std::vector<fc::ip::endpoint>& servers);
 
+        /**
+         * @brief Ask chain_servers to compress the blocks they send. This saves bandwidth on slow links at the
+         * cost of CPU time on both ends, so it is off by default. Servers using protocol version 0 ignore it.
+         */
+        void set_compression_enabled(bool enabled);
+
         /**
          * @brief Asynchronously retrieve all new blocks from one of the available chain_server nodes
          * @param new_block_callback Callback function taking the newly downloaded block and the count of blocks remaining
@@ -48,6 +54,9 @@ namespace bts { namespace net {
          * @return A future monitoring the function downloading blocks. When this future completes, all blocks have
          * been downloaded.
          *
+         * If the connection to a server is lost, the download resumes from the first block not yet received, using
+         * the next available server.
+         *
          * If new_block_callback is unset, a valid future is still returned, but nothing will be done and the
          * function monitored by the future will return immediately.
          */
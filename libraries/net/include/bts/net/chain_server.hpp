@@ -13,8 +13,10 @@ namespace bts { namespace net {
      * queried using the get_listening_port method.
      *
      * The chain_server responds to chain_server_commands. When a client connects, the server first sends it the
-     * protocol version this server expects. If the client does not understand that version, it must send a finish
-     * command and terminate the connection. Otherwise, the client should send a command along with any arguments
+     * protocol version 0, which every client understands. If the client does not understand that version, it must
+     * send a finish command and terminate the connection. A client that speaks a newer protocol learns the server's
+     * actual version by sending get_blocks_from_number with PROTOCOL_VERSION_QUERY as the block number; a version 0
+     * server replies with a count of 0 blocks, and newer servers reply with their version. Otherwise, the client should send a command along with any arguments
      * that command requires, complete the communication for that command, then repeat with another command and
      * so-on. When the client is finished, it should send the finish command, to indicate that  it is ready to
      * terminate the connection.
@@ -26,6 +28,13 @@ namespace bts { namespace net {
      *      full_block objects. When the server has finished sending these blocks, it repeats the procedure for
      *      any new blocks which have been made in the interim, so another count is sent, followed by that number
      *      of blocks. When the server sends a count of 0, there are no blocks, and the command is complete.
+     * * get_block_batches_from_number (protocol version 1)
+     *      This command takes two arguments, the number of the first block to retrieve and the block_batch_compression
+     *      the client would like. The server responds with a series of block_batch objects, each carrying a run of
+     *      consecutive blocks packed back to back, optionally compressed. The server reads the next batch from its
+     *      database while the previous one is being sent. A batch containing no blocks means the client has caught
+     *      up with the server's head block, and the command is complete. A client that loses its connection can
+     *      resume by sending this command again with the number of the first block it hasn't received.
      *
      * All block numbers are of type uint32_t
      */
@@ -7,14 +7,49 @@
 
 #include <fc/reflect/reflect.hpp>
 
-const static uint32_t PROTOCOL_VERSION = 0;
+#include <vector>
+
+const static uint32_t PROTOCOL_VERSION = 1;
+/// The oldest server protocol the chain_downloader still understands; version 0 servers only support get_blocks_from_number
+const static uint32_t MINIMUM_PROTOCOL_VERSION = 0;
+/// The version servers announce on connect.  Version 0 downloaders refuse any other, so newer ones query the real version.
+const static uint32_t ANNOUNCED_PROTOCOL_VERSION = 0;
+/**
+ * get_blocks_from_number with this start block asks for the server's protocol version. A version 0 server treats it
+ * as a request past its head block and replies with a count of 0 blocks; newer servers reply with PROTOCOL_VERSION.
+ */
+const static uint32_t PROTOCOL_VERSION_QUERY = uint32_t(-1);
+
+/// The server stops adding blocks to a batch once its packed blocks reach this size
+const static uint32_t BLOCK_BATCH_TARGET_SIZE = 1024 * 1024;
+const static uint32_t BLOCK_BATCH_MAX_BLOCKS = 2000;
 
 namespace bts { namespace net { namespace detail {
     enum chain_server_commands {
         finish = 0,
-        get_blocks_from_number
+        get_blocks_from_number,
+        get_block_batches_from_number
+    };
+
+    enum block_batch_compression {
+        no_compression = 0,
+        lzma_compression
+    };
+
+    /**
+     * A run of consecutive blocks sent in reply to get_block_batches_from_number. The blocks are packed back to
+     * back in packed_blocks, which is compressed if the client asked for it and compression made it smaller.
+     */
+    struct block_batch {
+        uint32_t first_block_number = 0;
+        uint32_t block_count = 0;
+        uint32_t blocks_remaining = 0; ///< blocks the server has after this batch, as of when it was read
+        block_batch_compression compression = no_compression;
+        std::vector<char> packed_blocks;
     };
 } } } //namespace bts::net::detail
 
-FC_REFLECT_ENUM(bts::net::detail::chain_server_commands, (finish)(get_blocks_from_number))
+FC_REFLECT_ENUM(bts::net::detail::chain_server_commands, (finish)(get_blocks_from_number)(get_block_batches_from_number))
 FC_REFLECT_TYPENAME(bts::net::detail::chain_server_commands)
+FC_REFLECT_ENUM(bts::net::detail::block_batch_compression, (no_compression)(lzma_compression))
+FC_REFLECT(bts::net::detail::block_batch, (first_block_number)(block_count)(blocks_remaining)(compression)(packed_blocks))
@@ -48,8 +48,50 @@
 
 #define BTS_NET_MAX_INVENTORY_SIZE_IN_MINUTES           2
 
+/**
+ * The most bytes of messages the node keeps in its message cache for peers to
+ * fetch.  When over this, messages from the oldest blocks are evicted first.
+ */
+#define BTS_NET_MESSAGE_CACHE_SIZE_LIMIT                (64 * 1024 * 1024)
+
+/**
+ * New transactions are collected for this long and then advertised to each
+ * peer in a single inventory message.  Blocks are advertised immediately.
+ */
+#define BTS_NET_TRANSACTION_ADVERTISE_INTERVAL_MS       250
+
+/**
+ * Each peer has a token bucket limiting how many bytes of transactions we
+ * advertise to it per second, allowing bursts of up to the bucket's capacity.
+ * Transactions over the limit wait for a later advertising interval.
+ */
+#define BTS_NET_TRANSACTION_RELAY_BYTES_PER_SEC         (64 * 1024)
+#define BTS_NET_TRANSACTION_RELAY_BURST_BYTES           (256 * 1024)
+/** the least a transaction is charged, also when it is no longer in the message cache and its size is unknown */
+#define BTS_NET_MIN_TRANSACTION_RELAY_COST              256
+/** a transaction still waiting for bucket space this long after it was first deferred is not offered again */
+#define BTS_NET_MAX_TRANSACTION_RELAY_DELAY_SEC         60
+
+/** transactions requested together are sent back in trx_batch_messages no bigger than this */
+#define BTS_NET_MAX_TRANSACTION_BATCH_SIZE              (MAX_MESSAGE_SIZE / 2)
+
 #define BTS_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING      100
 
+/**
+ * During sync, each peer is kept busy with enough block requests to cover this
+ * many seconds at the rate it has been delivering blocks, capped by
+ * BTS_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING.  Peers we haven't measured yet
+ * start with BTS_NET_INITIAL_SYNC_BLOCKS_PER_PEER requests.
+ */
+#define BTS_NET_SYNC_REQUEST_PIPELINE_SEC               2
+#define BTS_NET_INITIAL_SYNC_BLOCKS_PER_PEER            10
+
+/**
+ * A sync block request that has waited this long, or four times as long as the
+ * peer's queue of requests should take, is also requested from another peer
+ */
+#define BTS_NET_MIN_SYNC_STRAGGLER_TIMEOUT_SEC          3
+
 /**
  * Instead of fetching all item IDs from a peer, then fetching all blocks
  * from a peer, we will interleave them.  Fetch at least this many block IDs,
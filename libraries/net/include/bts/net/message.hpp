@@ -6,6 +6,8 @@
 #include <fc/crypto/ripemd160.hpp>
 #include <fc/reflect/variant.hpp>
 
+#include <memory>
+
 namespace bts { namespace net {
 
   /**
@@ -87,6 +89,66 @@ namespace bts { namespace net {
      }
   };
 
+  class packed_message;
+  typedef std::shared_ptr<const packed_message> packed_message_ptr;
+
+  /**
+   *  A message framed the way message_oriented_connection writes it: the header, the body and
+   *  zero padding up to the next multiple of 16 bytes.  Frames are built in pooled buffers and
+   *  never change afterwards, so a frame built once can be queued to any number of peers and
+   *  every peer's socket encrypts directly from the same memory.
+   */
+  class packed_message
+  {
+  public:
+     static packed_message_ptr pack( const message& message_to_pack );
+
+     /** @return the number of bytes a frame with a body of @a body_size takes on the wire */
+     static size_t frame_size_for( uint32_t body_size )
+     {
+        return 16 * ((sizeof(message_header) + body_size + 15) / 16);
+     }
+
+     uint32_t            msg_type()const   { return header().msg_type; }
+     uint32_t            body_size()const  { return header().size; }
+     const char*         body()const       { return _buffer.get() + sizeof(message_header); }
+
+     const char*         frame()const      { return _buffer.get(); }
+     size_t              frame_size()const { return frame_size_for( body_size() ); }
+
+     message_hash_type id()const
+     {
+        return fc::ripemd160::hash( body(), body_size() );
+     }
+
+     message unpack()const;
+
+     /** same as message::as<T>(), without copying the body out of the frame first */
+     template<typename T>
+     T as()const
+     {
+         try {
+          FC_ASSERT( msg_type() == T::type );
+          T tmp;
+          fc::datastream<const char*> ds( body_size() ? body() : nullptr, body_size() );
+          fc::raw::unpack( ds, tmp );
+          return tmp;
+         } FC_RETHROW_EXCEPTIONS( warn,
+              "error unpacking network message as a '${type}'  ${x} !=? ${msg_type}",
+              ("type", fc::get_typename<T>::name() )
+              ("x", T::type)
+              ("msg_type", msg_type())
+              );
+     }
+
+  private:
+     explicit packed_message( std::shared_ptr<char> buffer ) : _buffer( std::move(buffer) ) {}
+
+     const message_header& header()const { return *reinterpret_cast<const message_header*>(_buffer.get()); }
+
+     std::shared_ptr<char> _buffer;
+  };
+
 } } // bts::net
 
 
@@ -28,6 +28,8 @@ namespace bts { namespace net {
     void connect_to(const fc::ip::endpoint& remote_endpoint);
 
     void send_message(const message& message_to_send);
+    /** writes a frame that may be shared with other connections, it is only read */
+    void send_message(const packed_message& message_to_send);
     void close_connection();
     void destroy_connection();
 
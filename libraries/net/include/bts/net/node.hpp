@@ -72,6 +72,16 @@ namespace bts { namespace net {
           *  Given the hash of the requested data, fetch the body.
           */
          virtual message get_item( const item_id& id ) = 0;
+         /**
+          *  Returns the ids of the transactions waiting to be included in a block, used to rebuild
+          *  blocks that peers send us in compact form.
+          */
+         virtual std::vector<bts::blockchain::transaction_id_type> get_pending_transaction_ids() = 0;
+         /**
+          *  Fetches the pending transactions with the given ids, one entry per id, unset for any
+          *  transaction that is no longer pending.
+          */
+         virtual std::vector<fc::optional<bts::blockchain::signed_transaction> > get_pending_transactions( const std::vector<bts::blockchain::transaction_id_type>& ids ) = 0;
 
          virtual fc::sha256 get_chain_id()const = 0;
 
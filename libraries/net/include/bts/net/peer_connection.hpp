@@ -32,6 +32,30 @@ namespace bts { namespace net
       virtual void on_connection_closed(peer_connection* originating_peer) = 0;
     };
 
+    /**
+     * A token bucket, used to limit how fast we relay data to a peer.  Tokens accumulate at a fixed
+     * rate up to the bucket's capacity, and sending something costs one token per byte.
+     */
+    class token_bucket
+    {
+    public:
+      token_bucket(uint32_t tokens_per_second, uint32_t capacity);
+
+      /**
+       * Takes @a tokens from the bucket if it holds enough.  Anything larger than the bucket's capacity
+       * is allowed through once the bucket is full, leaving it in debt, so it is delayed but never starved.
+       * @return true if the tokens were taken
+       */
+      bool try_consume(uint32_t tokens);
+    private:
+      void refill();
+
+      uint32_t       _tokens_per_second;
+      uint32_t       _capacity;
+      int64_t        _tokens;
+      fc::time_point _last_refill_time;
+    };
+
     class peer_connection;
     typedef std::shared_ptr<peer_connection> peer_connection_ptr;
     class peer_connection : public message_oriented_connection_delegate,
@@ -73,19 +97,31 @@ namespace bts { namespace net
 
       struct queued_message
       {
-        message        message_to_send;
+        /** the frame to write, possibly shared with other peers.  null until send time for messages
+         *  that carry their send time, those are packed from unpacked_message after it is patched */
+        packed_message_ptr   packed_message_to_send;
+        fc::optional<message> unpacked_message;
         size_t         message_send_time_field_offset;
         fc::time_point enqueue_time;
         fc::time_point transmission_start_time;
         fc::time_point transmission_finish_time;
 
-        queued_message(message message_to_send, 
-                       size_t message_send_time_field_offset = (size_t)-1, 
+        queued_message(packed_message_ptr packed_message_to_send,
                        fc::time_point enqueue_time = fc::time_point::now()) :
-          message_to_send(std::move(message_to_send)),
+          packed_message_to_send(std::move(packed_message_to_send)),
+          message_send_time_field_offset((size_t)-1),
+          enqueue_time(enqueue_time)
+        {}
+        queued_message(message message_to_send,
+                       size_t message_send_time_field_offset,
+                       fc::time_point enqueue_time = fc::time_point::now()) :
+          unpacked_message(std::move(message_to_send)),
           message_send_time_field_offset(message_send_time_field_offset),
           enqueue_time(enqueue_time)
         {}
+
+        uint32_t msg_type() const { return packed_message_to_send ? packed_message_to_send->msg_type() : unpacked_message->msg_type; }
+        uint32_t size() const { return packed_message_to_send ? packed_message_to_send->body_size() : unpacked_message->size; }
       };
       size_t _total_queued_messages_size;
       std::queue<queued_message, std::list<queued_message> > _queued_messages;
@@ -152,29 +188,31 @@ namespace bts { namespace net
       item_hash_t last_block_delegate_has_seen; /// the hash of the last block  this peer has told us about that the peer knows
       fc::time_point_sec last_block_time_delegate_has_seen;
       bool inhibit_fetching_sync_blocks;
+      fc::microseconds sync_block_interval; /// moving average of the time between sync blocks arriving from this peer, zero until measured
+      fc::time_point last_sync_block_received_time;
       /// @}
 
       /// non-synchronization state data
       /// @{
-      struct timestamped_item_id
-      {
-        item_id            item;
-        fc::time_point_sec timestamp;
-        timestamped_item_id(const item_id& item, const fc::time_point_sec& timestamp) :
-          item(item),
-          timestamp(timestamp)
-        {}
-      };
-      struct timestamp_index{};
-      typedef boost::multi_index_container<timestamped_item_id,
-                                           boost::multi_index::indexed_by<boost::multi_index::hashed_unique<boost::multi_index::member<timestamped_item_id, item_id, &timestamped_item_id::item>,
-                                                                                                            std::hash<item_id> >,
-                                                                          boost::multi_index::ordered_non_unique<boost::multi_index::tag<timestamp_index>,
-                                                                                                                 boost::multi_index::member<timestamped_item_id, fc::time_point_sec, &timestamped_item_id::timestamp> > > > timestamped_items_set_type;
-      timestamped_items_set_type inventory_peer_advertised_to_us;
-      timestamped_items_set_type inventory_advertised_to_peer;
+      /** the peer's bit in the node's inventory table, which records what we've advertised to each peer and
+       *  what each peer has advertised to us.  Only set while the peer is active */
+      fc::optional<unsigned> inventory_slot;
 
       item_to_time_map_type items_requested_from_peer;  /// items we've requested from this peer during normal operation.  fetch from another peer if this peer disconnects
+
+      /** a block this peer sent in compact form that we're waiting on the missing transactions for */
+      struct partial_compact_block
+      {
+        bts::client::block_message block;  /// missing transactions are default-constructed until they arrive
+        message_hash_type          block_message_hash; /// the item id the block was requested by
+        std::vector<uint32_t>      missing_transaction_indexes;
+        bool                       fetching_all_transactions;
+        partial_compact_block() : fetching_all_transactions(false) {}
+      };
+      std::map<bts::blockchain::block_id_type, partial_compact_block> compact_blocks_being_rebuilt;
+      bool supports_compact_blocks; /// set from the hello message, we only send them compact blocks if it's true
+      bool supports_transaction_batches; /// set from the hello message, we only send them trx_batch_messages if it's true
+      token_bucket transaction_relay_bucket; /// limits the bytes of transactions we advertise to this peer
       /// @}
 
       // if they're flooding us with transactions, we set this to avoid fetching for a few seconds to let the
@@ -205,6 +243,7 @@ namespace bts { namespace net
       void on_connection_closed(message_oriented_connection* originating_connection) override;
 
       void send_message(const message& message_to_send, size_t message_send_time_field_offset = (size_t)-1);
+      void send_message(const packed_message_ptr& message_to_send);
       void close_connection();
       void destroy_connection();
 
@@ -223,10 +262,8 @@ namespace bts { namespace net
 
       bool is_transaction_fetching_inhibited() const;
       fc::sha512 get_shared_secret() const;
-      void clear_old_inventory();
-      bool is_inventory_advertised_to_us_list_full_for_transactions() const;
-      bool is_inventory_advertised_to_us_list_full() const;
     private:
+      void enqueue_message(queued_message&& message_to_enqueue);
       void send_queued_messages_task();
       void accept_connection_task();
       void connect_to_task(const fc::ip::endpoint& remote_endpoint);
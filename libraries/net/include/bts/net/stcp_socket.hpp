@@ -33,6 +33,13 @@ class stcp_socket : public virtual fc::iostream
     void             get( char& c ) { read( &c, 1 ); }
     fc::sha512       get_shared_secret() const { return _shared_secret; }
   private:
+    /** reads decrypt at most this much at a time */
+    static const size_t read_buffer_length = 64 * 1024;
+    /** the write buffer is never allocated smaller than this, so small writes don't reallocate it one size at a time */
+    static const size_t min_write_buffer_length = 4096;
+    /** writes are encrypted in one pass up to this size, larger writes are split */
+    static const size_t max_write_buffer_length = 1024 * 1024;
+
     void do_key_exchange();
 
     fc::sha512           _shared_secret;
@@ -44,6 +51,7 @@ class stcp_socket : public virtual fc::iostream
     fc::aes_decoder      _recv_aes;
     std::shared_ptr<char> _read_buffer;
     std::shared_ptr<char> _write_buffer;
+    size_t               _write_buffer_length;
 #ifndef NDEBUG
     bool _read_buffer_in_use;
     bool _write_buffer_in_use;
@@ -0,0 +1,105 @@
+#include <bts/net/message.hpp>
+#include <bts/net/config.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <mutex>
+#include <vector>
+
+namespace bts { namespace net {
+
+  namespace detail
+  {
+    /**
+     *  Recycles frame buffers by power-of-two size class so that relaying blocks and transactions
+     *  doesn't go through the allocator for every message.  Buffers may be released from any
+     *  thread holding the last reference to a frame.
+     */
+    class message_buffer_pool
+    {
+    public:
+      static message_buffer_pool& instance()
+      {
+        // never destroyed, frames still referenced at exit return their buffers to it
+        static message_buffer_pool* pool = new message_buffer_pool();
+        return *pool;
+      }
+
+      std::shared_ptr<char> allocate( size_t size )
+      {
+        unsigned size_class = min_size_class;
+        while( (size_t(1) << size_class) < size )
+          ++size_class;
+
+        char* buffer = nullptr;
+        if( size_class <= max_size_class )
+        {
+          std::lock_guard<std::mutex> lock( _mutex );
+          std::vector<char*>& free_buffers = _free_buffers[size_class - min_size_class];
+          if( !free_buffers.empty() )
+          {
+            buffer = free_buffers.back();
+            free_buffers.pop_back();
+          }
+        }
+        if( !buffer )
+          buffer = new char[size_t(1) << size_class];
+
+        return std::shared_ptr<char>( buffer, [this, size_class]( char* p ){ release( p, size_class ); } );
+      }
+
+    private:
+      static const unsigned min_size_class = 8;  // 256 bytes, enough for most transactions
+      static const unsigned max_size_class = 20; // 1 MB, enough for a frame of MAX_MESSAGE_SIZE
+      static const size_t   max_free_buffers_per_class = 8;
+
+      static_assert( (size_t(1) << max_size_class) >= MAX_MESSAGE_SIZE + 16, "largest pooled buffer can't hold a full frame" );
+
+      void release( char* buffer, unsigned size_class )
+      {
+        if( size_class <= max_size_class )
+        {
+          std::lock_guard<std::mutex> lock( _mutex );
+          std::vector<char*>& free_buffers = _free_buffers[size_class - min_size_class];
+          if( free_buffers.size() < max_free_buffers_per_class )
+          {
+            free_buffers.push_back( buffer );
+            return;
+          }
+        }
+        delete[] buffer;
+      }
+
+      std::mutex         _mutex;
+      std::vector<char*> _free_buffers[max_size_class - min_size_class + 1];
+    };
+  } // end namespace detail
+
+  packed_message_ptr packed_message::pack( const message& message_to_pack )
+  { try {
+    FC_ASSERT( message_to_pack.size == message_to_pack.data.size() );
+    const size_t frame_size = frame_size_for( message_to_pack.size );
+    std::shared_ptr<char> buffer = detail::message_buffer_pool::instance().allocate( frame_size );
+
+    message_header header;
+    header.size = message_to_pack.size;
+    header.msg_type = message_to_pack.msg_type;
+    memcpy( buffer.get(), (const char*)&header, sizeof(message_header) );
+    if( message_to_pack.size )
+      memcpy( buffer.get() + sizeof(message_header), message_to_pack.data.data(), message_to_pack.size );
+    const size_t padding_offset = sizeof(message_header) + message_to_pack.size;
+    memset( buffer.get() + padding_offset, 0, frame_size - padding_offset );
+
+    return packed_message_ptr( new packed_message( std::move(buffer) ) );
+  } FC_CAPTURE_AND_RETHROW( (message_to_pack.msg_type)(message_to_pack.size) ) }
+
+  message packed_message::unpack()const
+  {
+    message result;
+    result.size = body_size();
+    result.msg_type = msg_type();
+    result.data.assign( body(), body() + body_size() );
+    return result;
+  }
+
+} } // bts::net
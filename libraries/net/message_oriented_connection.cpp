@@ -55,7 +55,7 @@ namespace bts { namespace net {
                                        message_oriented_connection_delegate* delegate = nullptr);
       ~message_oriented_connection_impl();
 
-      void send_message(const message& message_to_send);
+      void send_message(const packed_message& message_to_send);
       void close_connection();
       void destroy_connection();
 
@@ -139,15 +139,34 @@ namespace bts { namespace net {
 
           FC_ASSERT( m.size <= MAX_MESSAGE_SIZE, "", ("m.size",m.size)("MAX_MESSAGE_SIZE",MAX_MESSAGE_SIZE) );
 
-          size_t remaining_bytes_with_padding = 16 * ((m.size - LEFTOVER + 15) / 16);
-          m.data.resize(LEFTOVER + remaining_bytes_with_padding); //give extra 16 bytes to allow for padding added in send call
-          std::copy(buffer + sizeof(message_header), buffer + sizeof(buffer), m.data.begin());
-          if (remaining_bytes_with_padding)
+          // m is reused and its body isn't cleared, so resizing only zero-fills the bytes by which this
+          // body outgrows the previous one; everything else is overwritten by the reads below.  when the
+          // capacity has to grow, the old body is dropped first so the reallocation doesn't copy it
+          if (m.size > m.data.capacity())
           {
-            _sock.read(&m.data[LEFTOVER], remaining_bytes_with_padding);
-            _bytes_received += remaining_bytes_with_padding;
+            m.data.clear();
+            m.data.reserve(std::min<size_t>(std::max<size_t>(m.size, 2 * m.data.capacity()), MAX_MESSAGE_SIZE));
+          }
+          m.data.resize(m.size);
+
+          const size_t bytes_in_first_block = std::min<size_t>(LEFTOVER, m.size);
+          std::copy(buffer + sizeof(message_header), buffer + sizeof(message_header) + bytes_in_first_block, m.data.begin());
+
+          // read the whole 16-byte blocks straight into the body, only the last partial
+          // block goes through the stack buffer so the padding never lands in m.data
+          const size_t remaining_bytes = m.size - bytes_in_first_block;
+          const size_t remaining_bytes_in_whole_blocks = remaining_bytes - remaining_bytes % 16;
+          if (remaining_bytes_in_whole_blocks)
+          {
+            _sock.read(&m.data[LEFTOVER], remaining_bytes_in_whole_blocks);
+            _bytes_received += remaining_bytes_in_whole_blocks;
+          }
+          if (remaining_bytes % 16)
+          {
+            _sock.read(buffer, 16);
+            _bytes_received += 16;
+            std::copy(buffer, buffer + remaining_bytes % 16, m.data.begin() + LEFTOVER + remaining_bytes_in_whole_blocks);
           }
-          m.data.resize(m.size); // truncate off the padding bytes
 
           _last_message_received_time = fc::time_point::now();
 
@@ -203,7 +222,7 @@ namespace bts { namespace net {
         throw *exception_to_rethrow;
     }
 
-    void message_oriented_connection_impl::send_message(const message& message_to_send)
+    void message_oriented_connection_impl::send_message(const packed_message& message_to_send)
     {
       VERIFY_CORRECT_THREAD();
 #if 0 // this gets too verbose
@@ -232,15 +251,11 @@ namespace bts { namespace net {
 
       try
       {
-        size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size;
-        //pad the message we send to a multiple of 16 bytes
-        size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::unique_ptr<char[]> padded_message(new char[size_with_padding]);
-        memcpy(padded_message.get(), (char*)&message_to_send, sizeof(message_header));
-        memcpy(padded_message.get() + sizeof(message_header), message_to_send.data.data(), message_to_send.size );
-        _sock.write(padded_message.get(), size_with_padding);
+        // the frame is already padded to a multiple of 16 bytes.  it may be shared with other
+        // connections, stcp_socket only reads it while encrypting into its own write buffer
+        _sock.write(message_to_send.frame(), message_to_send.frame_size());
         _sock.flush();
-        _bytes_sent += size_with_padding;
+        _bytes_sent += message_to_send.frame_size();
         _last_message_sent_time = fc::time_point::now();
       } FC_RETHROW_EXCEPTIONS( warn, "unable to send message" );
     }
@@ -342,6 +357,11 @@ namespace bts { namespace net {
   }
 
   void message_oriented_connection::send_message(const message& message_to_send)
+  {
+    my->send_message(*packed_message::pack(message_to_send));
+  }
+
+  void message_oriented_connection::send_message(const packed_message& message_to_send)
   {
     my->send_message(message_to_send);
   }
@@ -2,13 +2,16 @@
 #include <iomanip>
 #include <deque>
 #include <unordered_set>
+#include <unordered_map>
 #include <list>
 #include <forward_list>
 #include <iostream>
 #include <algorithm>
 #include <tuple>
+#include <functional>
 #include <boost/tuple/tuple.hpp>
 #include <boost/circular_buffer.hpp>
+#include <boost/dynamic_bitset.hpp>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
@@ -18,6 +21,7 @@
 #include <boost/multi_index/tag.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/composite_key.hpp>
 #include <boost/logic/tribool.hpp>
 #include <boost/range/algorithm_ext/push_back.hpp>
 #include <boost/range/numeric.hpp>
@@ -98,6 +102,13 @@ namespace bts { namespace net {
   namespace detail
   {
     namespace bmi = boost::multi_index;
+    /**
+     *  Holds the messages we've recently received or broadcast so we can serve them to peers that fetch them.
+     *  Messages expire cache_duration_in_blocks blocks after they arrive.  The cache is also limited to a
+     *  number of bytes; when it is over that limit, messages from the oldest block are evicted first, least
+     *  recently requested first among those.  The bodies are shared with the send queues of the peers they
+     *  are being sent to, so a cached message that is being sent is only stored once.
+     */
     class blockchain_tied_message_cache
     {
     private:
@@ -105,28 +116,40 @@ namespace bts { namespace net {
 
       struct message_hash_index{};
       struct message_contents_hash_index{};
-      struct block_clock_index{};
+      struct eviction_index{};
       struct message_info
       {
         message_hash_type message_hash;
-        message           message_body;
+        packed_message_ptr message_body; // shared with the send queues of the peers it is sent to
+        packed_message_ptr compact_message_body; // for blocks, the compact_block_message sent in its place
         uint32_t          block_clock_when_received;
+        uint64_t          last_access_sequence; // orders messages received at the same block clock, least recently used first
 
         // for network performance stats
         message_propagation_data propagation_data;
         fc::uint160_t     message_contents_hash; // hash of whatever the message contains (if it's a transaction, this is the transaction id, if it's a block, it's the block_id)
 
         message_info( const message_hash_type& message_hash,
-                      const message&           message_body,
+                      const packed_message_ptr& message_body,
+                      const packed_message_ptr& compact_message_body,
                       uint32_t                 block_clock_when_received,
+                      uint64_t                 last_access_sequence,
                       const message_propagation_data& propagation_data,
                       fc::uint160_t            message_contents_hash ) :
           message_hash( message_hash ),
           message_body( message_body ),
+          compact_message_body( compact_message_body ),
           block_clock_when_received( block_clock_when_received ),
+          last_access_sequence( last_access_sequence ),
           propagation_data( propagation_data ),
           message_contents_hash( message_contents_hash )
         {}
+
+        /** the bytes this entry keeps alive */
+        size_t size() const
+        {
+          return message_body->frame_size() + (compact_message_body ? compact_message_body->frame_size() : 0);
+        }
       };
       typedef boost::multi_index_container
         < message_info,
@@ -134,55 +157,185 @@ namespace bts { namespace net {
                                                   bmi::member<message_info, message_hash_type, &message_info::message_hash> >,
                              bmi::ordered_non_unique< bmi::tag<message_contents_hash_index>,
                                                       bmi::member<message_info, fc::uint160_t, &message_info::message_contents_hash> >,
-                             bmi::ordered_non_unique< bmi::tag<block_clock_index>,
-                                                      bmi::member<message_info, uint32_t, &message_info::block_clock_when_received> > >
+                             bmi::ordered_non_unique< bmi::tag<eviction_index>,
+                                                      bmi::composite_key< message_info,
+                                                                          bmi::member<message_info, uint32_t, &message_info::block_clock_when_received>,
+                                                                          bmi::member<message_info, uint64_t, &message_info::last_access_sequence> > > >
         > message_cache_container;
 
       message_cache_container _message_cache;
 
       uint32_t block_clock;
+      uint64_t _access_sequence;
+      size_t   _size_in_bytes;
+      size_t   _size_limit_in_bytes;
+
+      uint64_t _hits;
+      uint64_t _misses;
+      uint64_t _expirations;
+      uint64_t _evictions;
+
+      template<typename Iterator>
+      void touch( Iterator iter )
+      {
+        _message_cache.get<message_hash_index>().modify( _message_cache.project<message_hash_index>( iter ),
+                                                         [this]( message_info& info ){ info.last_access_sequence = ++_access_sequence; } );
+      }
+      void evict_to_size_limit();
 
     public:
       blockchain_tied_message_cache() :
-        block_clock( 0 )
+        block_clock( 0 ),
+        _access_sequence( 0 ),
+        _size_in_bytes( 0 ),
+        _size_limit_in_bytes( BTS_NET_MESSAGE_CACHE_SIZE_LIMIT ),
+        _hits( 0 ),
+        _misses( 0 ),
+        _expirations( 0 ),
+        _evictions( 0 )
       {}
       void block_accepted();
-      void cache_message( const message& message_to_cache, const message_hash_type& hash_of_message_to_cache,
-                        const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash );
-      message get_message( const message_hash_type& hash_of_message_to_lookup );
+      void cache_message( const packed_message_ptr& message_to_cache, const message_hash_type& hash_of_message_to_cache,
+                        const message_propagation_data& propagation_data, const fc::uint160_t& message_content_hash,
+                        const packed_message_ptr& compact_message_to_cache = packed_message_ptr() );
+      packed_message_ptr get_message( const message_hash_type& hash_of_message_to_lookup );
+      /** @returns the compact form of the message, or null if it was cached without one */
+      packed_message_ptr get_compact_message( const message_hash_type& hash_of_message_to_lookup );
+      /** @returns the size of the message's body, or 0 if it isn't cached.  Doesn't count as a use of the message */
+      uint32_t get_message_size( const message_hash_type& hash_of_message_to_lookup ) const;
+      packed_message_ptr get_message_by_contents_hash( const fc::uint160_t& hash_of_message_contents_to_lookup );
+      /** calls @a visitor with the contents hash of every cached message of type @a msg_type, without touching the bodies */
+      void for_each_contents_hash_of_type( uint32_t msg_type, const std::function<void(const fc::uint160_t&)>& visitor ) const;
       message_propagation_data get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const;
       size_t size() const { return _message_cache.size(); }
+
+      size_t get_size_limit() const { return _size_limit_in_bytes; }
+      void set_size_limit( size_t size_limit_in_bytes );
+      fc::variant_object get_statistics() const;
     };
 
     void blockchain_tied_message_cache::block_accepted()
     {
       ++block_clock;
       if( block_clock > cache_duration_in_blocks )
-        _message_cache.get<block_clock_index>().erase(_message_cache.get<block_clock_index>().begin(),
-                                                      _message_cache.get<block_clock_index>().lower_bound(block_clock - cache_duration_in_blocks ) );
+      {
+        auto& messages_by_age = _message_cache.get<eviction_index>();
+        auto expired_end = messages_by_age.lower_bound( boost::make_tuple( block_clock - cache_duration_in_blocks ) );
+        for( auto iter = messages_by_age.begin(); iter != expired_end; )
+        {
+          _size_in_bytes -= iter->size();
+          ++_expirations;
+          iter = messages_by_age.erase( iter );
+        }
+      }
+    }
+
+    void blockchain_tied_message_cache::evict_to_size_limit()
+    {
+      auto& messages_by_age = _message_cache.get<eviction_index>();
+      while( _size_in_bytes > _size_limit_in_bytes && !messages_by_age.empty() )
+      {
+        _size_in_bytes -= messages_by_age.begin()->size();
+        ++_evictions;
+        messages_by_age.erase( messages_by_age.begin() );
+      }
     }
 
-    void blockchain_tied_message_cache::cache_message( const message& message_to_cache,
+    void blockchain_tied_message_cache::set_size_limit( size_t size_limit_in_bytes )
+    {
+      _size_limit_in_bytes = size_limit_in_bytes;
+      evict_to_size_limit();
+    }
+
+    void blockchain_tied_message_cache::cache_message( const packed_message_ptr& message_to_cache,
                                                      const message_hash_type& hash_of_message_to_cache,
                                                      const message_propagation_data& propagation_data,
-                                                     const fc::uint160_t& message_content_hash )
+                                                     const fc::uint160_t& message_content_hash,
+                                                     const packed_message_ptr& compact_message_to_cache )
     {
-      _message_cache.insert( message_info(hash_of_message_to_cache,
-                                         message_to_cache,
-                                         block_clock,
-                                         propagation_data,
-                                         message_content_hash ) );
+      auto result = _message_cache.insert( message_info(hash_of_message_to_cache,
+                                                        message_to_cache,
+                                                        compact_message_to_cache,
+                                                        block_clock,
+                                                        ++_access_sequence,
+                                                        propagation_data,
+                                                        message_content_hash ) );
+      if( result.second )
+      {
+        _size_in_bytes += result.first->size();
+        evict_to_size_limit();
+      }
     }
 
-    message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
+    packed_message_ptr blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup )
     {
       message_cache_container::index<message_hash_index>::type::const_iterator iter =
          _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
       if( iter != _message_cache.get<message_hash_index>().end() )
+      {
+        ++_hits;
+        touch( iter );
         return iter->message_body;
+      }
+      ++_misses;
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
+    packed_message_ptr blockchain_tied_message_cache::get_compact_message( const message_hash_type& hash_of_message_to_lookup )
+    {
+      message_cache_container::index<message_hash_index>::type::const_iterator iter =
+         _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
+      if( iter != _message_cache.get<message_hash_index>().end() )
+        return iter->compact_message_body;
+      return packed_message_ptr();
+    }
+
+    uint32_t blockchain_tied_message_cache::get_message_size( const message_hash_type& hash_of_message_to_lookup ) const
+    {
+      message_cache_container::index<message_hash_index>::type::const_iterator iter =
+         _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
+      if( iter != _message_cache.get<message_hash_index>().end() )
+        return iter->message_body->body_size();
+      return 0;
+    }
+
+    packed_message_ptr blockchain_tied_message_cache::get_message_by_contents_hash( const fc::uint160_t& hash_of_message_contents_to_lookup )
+    {
+      if( hash_of_message_contents_to_lookup != fc::uint160_t() )
+      {
+        message_cache_container::index<message_contents_hash_index>::type::const_iterator iter =
+           _message_cache.get<message_contents_hash_index>().find(hash_of_message_contents_to_lookup );
+        if( iter != _message_cache.get<message_contents_hash_index>().end() )
+        {
+          ++_hits;
+          touch( iter );
+          return iter->message_body;
+        }
+      }
+      ++_misses;
+      FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
+    }
+
+    void blockchain_tied_message_cache::for_each_contents_hash_of_type( uint32_t msg_type, const std::function<void(const fc::uint160_t&)>& visitor ) const
+    {
+      for( const message_info& info : _message_cache )
+        if( info.message_body->msg_type() == msg_type )
+          visitor( info.message_contents_hash );
+    }
+
+    fc::variant_object blockchain_tied_message_cache::get_statistics() const
+    {
+      fc::mutable_variant_object statistics;
+      statistics["messages"] = _message_cache.size();
+      statistics["size_in_bytes"] = _size_in_bytes;
+      statistics["size_limit_in_bytes"] = _size_limit_in_bytes;
+      statistics["hits"] = _hits;
+      statistics["misses"] = _misses;
+      statistics["expirations"] = _expirations;
+      statistics["evictions"] = _evictions;
+      return statistics;
+    }
+
     message_propagation_data blockchain_tied_message_cache::get_message_propagation_data( const fc::uint160_t& hash_of_message_contents_to_lookup ) const
     {
       if( hash_of_message_contents_to_lookup != fc::uint160_t() )
@@ -195,6 +348,166 @@ namespace bts { namespace net {
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
     }
 
+    /**
+     *  Remembers which items we've advertised to each active peer and which items each peer has advertised
+     *  to us.  Instead of a set per peer, there is one entry per item with a bit for each peer, so looking
+     *  up an item costs the same however many peers we have.  A peer's bit position is the slot it was given
+     *  when it became active.  Entries expire BTS_NET_MAX_INVENTORY_SIZE_IN_MINUTES after anyone last
+     *  advertised the item.
+     */
+    class inventory_table
+    {
+    public:
+      struct inventory_entry
+      {
+        item_id                         item;
+        // not part of any index, so they may be updated in place
+        mutable fc::time_point_sec      last_advertised_time;
+        mutable boost::dynamic_bitset<> advertised_to_peer;
+        mutable boost::dynamic_bitset<> peer_advertised_to_us;
+
+        inventory_entry( const item_id& item, const fc::time_point_sec& last_advertised_time ) :
+          item( item ),
+          last_advertised_time( last_advertised_time )
+        {}
+
+        bool was_advertised_to_peer( unsigned slot ) const { return slot < advertised_to_peer.size() && advertised_to_peer[slot]; }
+        bool peer_advertised( unsigned slot ) const { return slot < peer_advertised_to_us.size() && peer_advertised_to_us[slot]; }
+      };
+
+    private:
+      struct item_index{};
+      struct age_index{};
+      typedef boost::multi_index_container
+        < inventory_entry,
+            bmi::indexed_by< bmi::hashed_unique< bmi::tag<item_index>,
+                                                 bmi::member<inventory_entry, item_id, &inventory_entry::item>,
+                                                 std::hash<item_id> >,
+                             bmi::sequenced< bmi::tag<age_index> > >
+        > inventory_container;
+
+      inventory_container   _inventory;
+      std::vector<unsigned> _free_slots;
+      std::vector<size_t>   _advertised_to_peer_counts;    // indexed by slot
+      std::vector<size_t>   _peer_advertised_to_us_counts; // indexed by slot
+
+      /** finds or creates the entry for @a item and moves it to the back of the expiration order */
+      const inventory_entry& touch( const item_id& item, const fc::time_point_sec& now )
+      {
+        auto iter = _inventory.get<item_index>().find( item );
+        if( iter == _inventory.get<item_index>().end() )
+          iter = _inventory.get<item_index>().insert( inventory_entry( item, now ) ).first;
+        iter->last_advertised_time = now;
+        _inventory.get<age_index>().relocate( _inventory.get<age_index>().end(), _inventory.project<age_index>( iter ) );
+        return *iter;
+      }
+
+      static bool set_bit( boost::dynamic_bitset<>& bits, unsigned slot )
+      {
+        if( slot >= bits.size() )
+          bits.resize( slot + 1 );
+        if( bits[slot] )
+          return false;
+        bits[slot] = true;
+        return true;
+      }
+
+    public:
+      unsigned allocate_slot()
+      {
+        if( !_free_slots.empty() )
+        {
+          unsigned slot = _free_slots.back();
+          _free_slots.pop_back();
+          return slot;
+        }
+        _advertised_to_peer_counts.push_back( 0 );
+        _peer_advertised_to_us_counts.push_back( 0 );
+        return (unsigned)_advertised_to_peer_counts.size() - 1;
+      }
+
+      /** forgets everything recorded for the peer in @a slot so the slot can be given to another peer */
+      void release_slot( unsigned slot )
+      {
+        for( const inventory_entry& entry : _inventory )
+        {
+          if( slot < entry.advertised_to_peer.size() )
+            entry.advertised_to_peer[slot] = false;
+          if( slot < entry.peer_advertised_to_us.size() )
+            entry.peer_advertised_to_us[slot] = false;
+        }
+        _advertised_to_peer_counts[slot] = 0;
+        _peer_advertised_to_us_counts[slot] = 0;
+        _free_slots.push_back( slot );
+      }
+
+      const inventory_entry* find( const item_id& item ) const
+      {
+        auto iter = _inventory.get<item_index>().find( item );
+        return iter == _inventory.get<item_index>().end() ? nullptr : &*iter;
+      }
+
+      bool peer_advertised_to_us( unsigned slot, const item_id& item ) const
+      {
+        const inventory_entry* entry = find( item );
+        return entry && entry->peer_advertised( slot );
+      }
+      bool any_peer_advertised_to_us( const item_id& item ) const
+      {
+        const inventory_entry* entry = find( item );
+        return entry && entry->peer_advertised_to_us.any();
+      }
+      bool advertised_to_any_peer( const item_id& item ) const
+      {
+        const inventory_entry* entry = find( item );
+        return entry && entry->advertised_to_peer.any();
+      }
+
+      void record_peer_advertised_to_us( unsigned slot, const item_id& item, const fc::time_point_sec& now )
+      {
+        if( set_bit( touch( item, now ).peer_advertised_to_us, slot ) )
+          ++_peer_advertised_to_us_counts[slot];
+      }
+      void forget_peer_advertised_to_us( unsigned slot, const item_id& item )
+      {
+        auto iter = _inventory.get<item_index>().find( item );
+        if( iter != _inventory.get<item_index>().end() && iter->peer_advertised( slot ) )
+        {
+          iter->peer_advertised_to_us[slot] = false;
+          --_peer_advertised_to_us_counts[slot];
+        }
+      }
+
+      /** @returns the entry for @a item, to pass to record_advertised_to_peer for each peer it is sent to */
+      const inventory_entry& begin_advertising( const item_id& item, const fc::time_point_sec& now )
+      {
+        return touch( item, now );
+      }
+      void record_advertised_to_peer( const inventory_entry& entry, unsigned slot )
+      {
+        if( set_bit( entry.advertised_to_peer, slot ) )
+          ++_advertised_to_peer_counts[slot];
+      }
+
+      void expire_old_inventory( const fc::time_point_sec& oldest_inventory_to_keep )
+      {
+        auto& entries_by_age = _inventory.get<age_index>();
+        while( !entries_by_age.empty() && entries_by_age.front().last_advertised_time < oldest_inventory_to_keep )
+        {
+          const inventory_entry& entry = entries_by_age.front();
+          for( size_t slot = entry.advertised_to_peer.find_first(); slot != boost::dynamic_bitset<>::npos; slot = entry.advertised_to_peer.find_next( slot ) )
+            --_advertised_to_peer_counts[slot];
+          for( size_t slot = entry.peer_advertised_to_us.find_first(); slot != boost::dynamic_bitset<>::npos; slot = entry.peer_advertised_to_us.find_next( slot ) )
+            --_peer_advertised_to_us_counts[slot];
+          entries_by_age.pop_front();
+        }
+      }
+
+      size_t number_of_items_advertised_to_peer( unsigned slot ) const { return slot < _advertised_to_peer_counts.size() ? _advertised_to_peer_counts[slot] : 0; }
+      size_t number_of_items_peer_advertised_to_us( unsigned slot ) const { return slot < _peer_advertised_to_us_counts.size() ? _peer_advertised_to_us_counts[slot] : 0; }
+      size_t size() const { return _inventory.size(); }
+    };
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////
 
     // This specifies configuration info for the local node.  It's stored as JSON
@@ -260,6 +573,8 @@ namespace bts { namespace net { namespace detail {
                                    (handle_message) \
                                    (get_item_ids) \
                                    (get_item) \
+                                   (get_pending_transaction_ids) \
+                                   (get_pending_transactions) \
                                    (get_chain_id) \
                                    (get_blockchain_synopsis) \
                                    (sync_status) \
@@ -355,6 +670,8 @@ namespace bts { namespace net { namespace detail {
                                             uint32_t& remaining_item_count,
                                             uint32_t limit = 2000) override;
       message get_item( const item_id& id ) override;
+      std::vector<bts::blockchain::transaction_id_type> get_pending_transaction_ids() override;
+      std::vector<fc::optional<bts::blockchain::signed_transaction> > get_pending_transactions( const std::vector<bts::blockchain::transaction_id_type>& ids ) override;
       fc::sha256 get_chain_id() const override;
       std::vector<item_hash_t> get_blockchain_synopsis(uint32_t item_type,
                                                        const bts::net::item_hash_t& reference_point = bts::net::item_hash_t(),
@@ -408,9 +725,17 @@ namespace bts { namespace net { namespace detail {
 
       typedef std::unordered_map<bts::blockchain::block_id_type, fc::time_point> active_sync_requests_map;
 
+      struct reassigned_sync_request
+      {
+        unsigned outstanding_requests; /// number of peers we're still waiting on for the block
+        bool     received;             /// once one peer delivers the block, the copies from the others are dropped
+      };
+      typedef std::unordered_map<bts::blockchain::block_id_type, reassigned_sync_request> reassigned_sync_requests_map;
+      typedef std::unordered_map<bts::blockchain::block_id_type, bts::client::block_message> received_sync_items_map;
+
       active_sync_requests_map              _active_sync_requests; /// list of sync blocks we've asked for from peers but have not yet received
-      std::list<bts::client::block_message> _new_received_sync_items; /// list of sync blocks we've just received but haven't yet tried to process
-      std::list<bts::client::block_message> _received_sync_items; /// list of sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
+      reassigned_sync_requests_map          _reassigned_sync_requests; /// sync blocks we've asked a second peer for because the first was too slow
+      received_sync_items_map               _received_sync_items; /// sync blocks we've received, but can't yet process because we are still missing blocks that come earlier in the chain
       // @}
 
       fc::future<void> _process_backlog_of_sync_blocks_done;
@@ -436,6 +761,9 @@ namespace bts { namespace net { namespace detail {
       fc::promise<void>::ptr        _retrigger_advertise_inventory_loop_promise;
       fc::future<void>              _advertise_inventory_loop_done;
       std::unordered_set<item_id>   _new_inventory; /// list of items we have received but not yet advertised to our peers
+      fc::time_point                _last_transaction_advertise_time; /// transactions are advertised at most every BTS_NET_TRANSACTION_ADVERTISE_INTERVAL_MS
+      std::unordered_map<item_id, fc::time_point> _transaction_relay_deferred_since; /// when each transaction waiting for relay bucket space was first deferred
+      inventory_table               _inventory; /// what we've advertised to each active peer and what each has advertised to us
       // @}
 
       fc::future<void>     _terminate_inactive_connections_loop_done;
@@ -546,10 +874,17 @@ namespace bts { namespace net { namespace detail {
       bool have_already_received_sync_item( const item_hash_t& item_hash );
       void request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request );
       void request_sync_items_from_peer( const peer_connection_ptr& peer, const std::vector<item_hash_t>& items_to_request );
+      void sync_request_abandoned( const item_hash_t& item_hash );
+      unsigned get_sync_request_pipeline_depth( const peer_connection_ptr& peer ) const;
+      fc::microseconds get_sync_straggler_timeout( const peer_connection_ptr& peer ) const;
       void fetch_sync_items_loop();
       void trigger_fetch_sync_items_loop();
 
       bool is_item_in_any_peers_inventory(const item_id& item) const;
+      void expire_old_inventory();
+      bool is_inventory_advertised_to_us_list_full_for_transactions(const peer_connection* peer) const;
+      bool is_inventory_advertised_to_us_list_full(const peer_connection* peer) const;
+      void release_inventory_slot(const peer_connection_ptr& peer);
       void fetch_items_loop();
       void trigger_fetch_items_loop();
 
@@ -631,6 +966,21 @@ namespace bts { namespace net { namespace detail {
       void on_get_current_connections_reply_message(peer_connection* originating_peer,
                                                     const get_current_connections_reply_message& get_current_connections_reply_message_received);
 
+      void on_compact_block_message(peer_connection* originating_peer,
+                                    const bts::client::compact_block_message& compact_block_message_received);
+
+      void on_fetch_block_transactions_message(peer_connection* originating_peer,
+                                               const bts::client::fetch_block_transactions_message& fetch_block_transactions_message_received);
+
+      void on_block_transactions_message(peer_connection* originating_peer,
+                                         const bts::client::block_transactions_message& block_transactions_message_received);
+
+      void on_trx_batch_message(peer_connection* originating_peer,
+                                const bts::client::trx_batch_message& trx_batch_message_received);
+
+      void process_compact_block( peer_connection* originating_peer, peer_connection::partial_compact_block& compact_block );
+      void abandon_compact_block( peer_connection* originating_peer, const bts::blockchain::block_id_type& block_id );
+
       void on_connection_closed( peer_connection* originating_peer ) override;
 
       void send_sync_block_to_node_delegate(const bts::client::block_message& block_message_to_send);
@@ -941,10 +1291,7 @@ namespace bts { namespace net { namespace detail {
     bool node_impl::have_already_received_sync_item( const item_hash_t& item_hash )
     {
       VERIFY_CORRECT_THREAD();
-      return std::find_if(_received_sync_items.begin(), _received_sync_items.end(),
-                          [&item_hash]( const bts::client::block_message& message ) { return message.block_id == item_hash; } ) != _received_sync_items.end() ||
-             std::find_if(_new_received_sync_items.begin(), _new_received_sync_items.end(),
-                          [&item_hash]( const bts::client::block_message& message ) { return message.block_id == item_hash; } ) != _new_received_sync_items.end();                          ;
+      return _received_sync_items.find(item_hash) != _received_sync_items.end();
     }
 
     void node_impl::request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request )
@@ -972,6 +1319,36 @@ namespace bts { namespace net { namespace detail {
       peer->send_message(fetch_items_message(bts::client::block_message_type, items_to_request));
     }
 
+    /** called when a peer won't be delivering a sync block we requested from it, so it can be requested again */
+    void node_impl::sync_request_abandoned( const item_hash_t& item_hash )
+    {
+      VERIFY_CORRECT_THREAD();
+      auto reassigned_iter = _reassigned_sync_requests.find(item_hash);
+      if (reassigned_iter != _reassigned_sync_requests.end())
+      {
+        if (--reassigned_iter->second.outstanding_requests != 0)
+          return; // another peer is still working on it
+        _reassigned_sync_requests.erase(reassigned_iter);
+      }
+      _active_sync_requests.erase(item_hash);
+    }
+
+    unsigned node_impl::get_sync_request_pipeline_depth( const peer_connection_ptr& peer ) const
+    {
+      VERIFY_CORRECT_THREAD();
+      if (peer->sync_block_interval == fc::microseconds())
+        return std::min<unsigned>(BTS_NET_INITIAL_SYNC_BLOCKS_PER_PEER, _maximum_blocks_per_peer_during_syncing);
+      int64_t depth = fc::seconds(BTS_NET_SYNC_REQUEST_PIPELINE_SEC).count() / std::max<int64_t>(peer->sync_block_interval.count(), 1);
+      return (unsigned)std::max<int64_t>(1, std::min<int64_t>(depth, _maximum_blocks_per_peer_during_syncing));
+    }
+
+    fc::microseconds node_impl::get_sync_straggler_timeout( const peer_connection_ptr& peer ) const
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::microseconds expected_queue_time(peer->sync_block_interval.count() * (int64_t)peer->sync_items_requested_from_peer.size());
+      return std::max(fc::seconds(BTS_NET_MIN_SYNC_STRAGGLER_TIMEOUT_SEC), fc::microseconds(4 * expected_queue_time.count()));
+    }
+
     void node_impl::fetch_sync_items_loop()
     {
       VERIFY_CORRECT_THREAD();
@@ -987,34 +1364,79 @@ namespace bts { namespace net { namespace detail {
           {
             ASSERT_TASK_NOT_PREEMPTED();
             std::set<item_hash_t> sync_items_to_request;
+            fc::time_point now = fc::time_point::now();
+
+            // blocks are only requested from a window starting at the next block we need, so fast peers
+            // can't run far ahead of a block everything else is waiting on.  Every peer's
+            // ids_of_items_to_get starts at that block and received blocks stay on it until they're
+            // processed, so the window is the front of each list and bounds what we hold in memory
+            const size_t window_size = _maximum_number_of_sync_blocks_to_prefetch;
+
+            // requests that have been outstanding much longer than their peer's rate suggests are also
+            // requested from another peer, whichever delivers first wins
+            std::vector<item_hash_t> straggling_items;
+            for( const peer_connection_ptr& peer : _active_connections )
+            {
+              fc::microseconds straggler_timeout = get_sync_straggler_timeout(peer);
+              for( const peer_connection::item_to_time_map_type::value_type& item_and_time : peer->sync_items_requested_from_peer )
+                if( now - item_and_time.second > straggler_timeout &&
+                    _reassigned_sync_requests.find(item_and_time.first.item_hash) == _reassigned_sync_requests.end() )
+                  straggling_items.push_back(item_and_time.first.item_hash);
+            }
 
-            // for each idle peer that we're syncing with
+            // hand out requests to the fastest peers first
+            std::vector<peer_connection_ptr> peers_to_request_from;
             for( const peer_connection_ptr& peer : _active_connections )
+              if( peer->we_need_sync_items_from_peer && !peer->inhibit_fetching_sync_blocks )
+                peers_to_request_from.push_back(peer);
+            std::sort(peers_to_request_from.begin(), peers_to_request_from.end(),
+                      [this](const peer_connection_ptr& a, const peer_connection_ptr& b) {
+                        return get_sync_request_pipeline_depth(a) > get_sync_request_pipeline_depth(b);
+                      });
+
+            for( const peer_connection_ptr& peer : peers_to_request_from )
             {
-              if( peer->we_need_sync_items_from_peer &&
-                  sync_item_requests_to_send.find(peer) == sync_item_requests_to_send.end() && // if we've already scheduled a request for this peer, don't consider scheduling another
-                  peer->idle() )
+              unsigned pipeline_depth = get_sync_request_pipeline_depth(peer);
+              if( peer->sync_items_requested_from_peer.size() >= pipeline_depth )
+                continue;
+              size_t requests_available = pipeline_depth - peer->sync_items_requested_from_peer.size();
+              std::vector<item_hash_t>& requests_for_peer = sync_item_requests_to_send[peer];
+              const size_t items_in_window = std::min(window_size, peer->ids_of_items_to_get.size());
+
+              for( auto straggler_iter = straggling_items.begin(); straggler_iter != straggling_items.end() && requests_available; )
+              {
+                if( peer->sync_items_requested_from_peer.find(item_id(bts::client::block_message_type, *straggler_iter)) ==
+                      peer->sync_items_requested_from_peer.end() &&
+                    std::find(peer->ids_of_items_to_get.begin(), peer->ids_of_items_to_get.begin() + items_in_window,
+                              *straggler_iter) != peer->ids_of_items_to_get.begin() + items_in_window )
+                {
+                  dlog("sync: also requesting straggling block ${id} from peer ${endpoint}", ("id", *straggler_iter)("endpoint", peer->get_remote_endpoint()));
+                  _reassigned_sync_requests[*straggler_iter] = reassigned_sync_request{2, false};
+                  requests_for_peer.push_back(*straggler_iter);
+                  --requests_available;
+                  straggler_iter = straggling_items.erase(straggler_iter);
+                }
+                else
+                  ++straggler_iter;
+              }
+
+              // loop through the items in the window it has that we don't yet have on our blockchain
+              for( size_t i = 0; i < items_in_window && requests_available; ++i )
               {
-                if (!peer->inhibit_fetching_sync_blocks)
+                const item_hash_t& item_to_potentially_request = peer->ids_of_items_to_get[i];
+                // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
+                if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
+                    sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
+                    _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() ) // we've requested it in a previous iteration and we're still waiting for it to arrive
                 {
-                  // loop through the items it has that we don't yet have on our blockchain
-                  for( unsigned i = 0; i < peer->ids_of_items_to_get.size(); ++i )
-                  {
-                    item_hash_t item_to_potentially_request = peer->ids_of_items_to_get[i];
-                    // if we don't already have this item in our temporary storage and we haven't requested from another syncing peer
-                    if( !have_already_received_sync_item(item_to_potentially_request) && // already got it, but for some reson it's still in our list of items to fetch
-                        sync_items_to_request.find(item_to_potentially_request) == sync_items_to_request.end() &&  // we have already decided to request it from another peer during this iteration
-                        _active_sync_requests.find(item_to_potentially_request) == _active_sync_requests.end() ) // we've requested it in a previous iteration and we're still waiting for it to arrive
-                    {
-                      // then schedule a request from this peer
-                      sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
-                      sync_items_to_request.insert( item_to_potentially_request );
-                      if (sync_item_requests_to_send[peer].size() >= _maximum_blocks_per_peer_during_syncing)
-                        break;
-                    }
-                  }
+                  // then schedule a request from this peer
+                  requests_for_peer.push_back(item_to_potentially_request);
+                  sync_items_to_request.insert( item_to_potentially_request );
+                  --requests_available;
                 }
               }
+              if( requests_for_peer.empty() )
+                sync_item_requests_to_send.erase(peer);
             }
           } // end non-preemptable section
 
@@ -1047,12 +1469,43 @@ namespace bts { namespace net { namespace detail {
 
     bool node_impl::is_item_in_any_peers_inventory(const item_id& item) const
     {
-      for( const peer_connection_ptr& peer : _active_connections )
+      return _inventory.any_peer_advertised_to_us(item);
+    }
+
+    void node_impl::expire_old_inventory()
+    {
+      VERIFY_CORRECT_THREAD();
+      _inventory.expire_old_inventory(fc::time_point::now() - fc::minutes(BTS_NET_MAX_INVENTORY_SIZE_IN_MINUTES));
+    }
+
+    // we have a higher limit for blocks than transactions so we will still fetch blocks even when transactions are throttled
+    bool node_impl::is_inventory_advertised_to_us_list_full_for_transactions(const peer_connection* peer) const
+    {
+      VERIFY_CORRECT_THREAD();
+      return peer->inventory_slot &&
+             _inventory.number_of_items_peer_advertised_to_us(*peer->inventory_slot) > BTS_NET_MAX_INVENTORY_SIZE_IN_MINUTES * BTS_BLOCKCHAIN_MAX_TRX_PER_SECOND * 60;
+    }
+
+    bool node_impl::is_inventory_advertised_to_us_list_full(const peer_connection* peer) const
+    {
+      VERIFY_CORRECT_THREAD();
+      // allow the total inventory size to be the maximum number of transactions we'll store in the inventory (above)
+      // plus the maximum number of blocks that would be generated in BTS_NET_MAX_INVENTORY_SIZE_IN_MINUTES (plus one,
+      // to give us some wiggle room)
+      return peer->inventory_slot &&
+             _inventory.number_of_items_peer_advertised_to_us(*peer->inventory_slot) >
+               BTS_NET_MAX_INVENTORY_SIZE_IN_MINUTES * BTS_BLOCKCHAIN_MAX_TRX_PER_SECOND * 60 +
+               (BTS_NET_MAX_INVENTORY_SIZE_IN_MINUTES + 1) * 60 / BTS_BLOCKCHAIN_BLOCK_INTERVAL_SEC;
+    }
+
+    void node_impl::release_inventory_slot(const peer_connection_ptr& peer)
+    {
+      VERIFY_CORRECT_THREAD();
+      if (peer->inventory_slot)
       {
-        if (peer->inventory_peer_advertised_to_us.find(item) != peer->inventory_peer_advertised_to_us.end() )
-          return true;
+        _inventory.release_slot(*peer->inventory_slot);
+        peer->inventory_slot.reset();
       }
-      return false;
     }
 
     void node_impl::fetch_items_loop()
@@ -1071,10 +1524,11 @@ namespace bts { namespace net { namespace detail {
         for (auto iter = _items_to_fetch.begin(); iter != _items_to_fetch.end();)
         {
           bool item_fetched = false;
+          const inventory_table::inventory_entry* inventory_entry = _inventory.find(iter->item);
           for (const peer_connection_ptr& peer : _active_connections)
           {
-            if (peer->idle() &&
-                peer->inventory_peer_advertised_to_us.find(iter->item) != peer->inventory_peer_advertised_to_us.end())
+            if (inventory_entry && peer->idle() &&
+                peer->inventory_slot && inventory_entry->peer_advertised(*peer->inventory_slot))
             {
               if (peer->is_transaction_fetching_inhibited() && iter->item.item_type == bts::client::trx_message_type)
                 next_peer_unblocked_time = std::min(peer->transaction_fetching_inhibited_until, next_peer_unblocked_time);
@@ -1133,57 +1587,113 @@ namespace bts { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       while (!_advertise_inventory_loop_done.canceled())
       {
+        // blocks are advertised as soon as we have them.  Transactions are collected and advertised once per
+        // BTS_NET_TRANSACTION_ADVERTISE_INTERVAL_MS, so each peer gets one inventory message for all of them
+        fc::time_point next_advertise_time = fc::time_point::maximum();
+        if (!_new_inventory.empty())
+        {
+          next_advertise_time = _last_transaction_advertise_time + fc::milliseconds(BTS_NET_TRANSACTION_ADVERTISE_INTERVAL_MS);
+          for (const item_id& new_item : _new_inventory)
+            if (new_item.item_type != trx_message_type)
+            {
+              next_advertise_time = fc::time_point::min();
+              break;
+            }
+        }
+        fc::time_point now = fc::time_point::now();
+        if (next_advertise_time > now)
+        {
+          _retrigger_advertise_inventory_loop_promise = fc::promise<void>::ptr(new fc::promise<void>("bts::net::retrigger_advertise_inventory_loop"));
+          try
+          {
+            if (next_advertise_time == fc::time_point::maximum())
+              _retrigger_advertise_inventory_loop_promise->wait();
+            else
+              _retrigger_advertise_inventory_loop_promise->wait(next_advertise_time - now);
+          }
+          catch (const fc::timeout_exception&)
+          {
+          }
+          _retrigger_advertise_inventory_loop_promise.reset();
+          continue;
+        }
+
         dlog("beginning an iteration of advertise inventory");
         // swap inventory into local variable, clearing the node's copy
         std::unordered_set<item_id> inventory_to_advertise;
         inventory_to_advertise.swap(_new_inventory);
+        _last_transaction_advertise_time = now;
 
         // process all inventory to advertise and construct the inventory messages we'll send
         // first, then send them all in a batch (to avoid any fiber interruption points while
         // we're computing the messages)
         std::list<std::pair<peer_connection_ptr, item_ids_inventory_message> > inventory_messages_to_send;
 
+        expire_old_inventory();
+
+        // only advertise to peers who are in sync with us
+        std::vector<peer_connection_ptr> peers_to_advertise_to;
         for (const peer_connection_ptr& peer : _active_connections)
+          if (!peer->peer_needs_sync_items_from_us && peer->inventory_slot)
+            peers_to_advertise_to.push_back(peer);
+
+        // build every peer's messages in one pass over the items, looking each item up once.
+        // don't send a peer anything we've already advertised to it or anything it has advertised to us.
+        // group the items we need to send by type, because we'll need to send one inventory message per type
+        std::vector<std::map<uint32_t, std::vector<item_hash_t> > > items_to_advertise_by_peer_and_type(peers_to_advertise_to.size());
+        for (const item_id& item_to_advertise : inventory_to_advertise)
         {
-          // only advertise to peers who are in sync with us
-          if( !peer->peer_needs_sync_items_from_us )
+          const inventory_table::inventory_entry& inventory_entry = _inventory.begin_advertising(item_to_advertise, now);
+
+          // transactions are charged against each peer's relay bucket, a peer whose bucket is empty
+          // is offered the transaction in a later interval instead, until it has waited too long
+          uint32_t transaction_size = 0;
+          if (item_to_advertise.item_type == trx_message_type)
+            transaction_size = std::max<uint32_t>(_message_cache.get_message_size(item_to_advertise.item_hash),
+                                                  BTS_NET_MIN_TRANSACTION_RELAY_COST);
+          bool deferred = false;
+
+          for (unsigned i = 0; i < peers_to_advertise_to.size(); ++i)
           {
-            std::map<uint32_t, std::vector<item_hash_t> > items_to_advertise_by_type;
-            // don't send the peer anything we've already advertised to it
-            // or anything it has advertised to us
-            // group the items we need to send by type, because we'll need to send one inventory message per type
-            unsigned total_items_to_send_to_this_peer = 0;
-            for (const item_id& item_to_advertise : inventory_to_advertise)
-              if (peer->inventory_advertised_to_peer.find(item_to_advertise) == peer->inventory_advertised_to_peer.end() &&
-                  peer->inventory_peer_advertised_to_us.find(item_to_advertise) == peer->inventory_peer_advertised_to_us.end())
+            unsigned slot = *peers_to_advertise_to[i]->inventory_slot;
+            if (!inventory_entry.was_advertised_to_peer(slot) && !inventory_entry.peer_advertised(slot))
+            {
+              if (transaction_size && !peers_to_advertise_to[i]->transaction_relay_bucket.try_consume(transaction_size))
               {
-                items_to_advertise_by_type[item_to_advertise.item_type].push_back(item_to_advertise.item_hash);
-                peer->inventory_advertised_to_peer.insert(peer_connection::timestamped_item_id(item_to_advertise, fc::time_point::now()));
-                ++total_items_to_send_to_this_peer;
-                if (item_to_advertise.item_type == trx_message_type)
-                  testnetlog("advertising transaction ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
-                dlog("advertising item ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
+                deferred = true;
+                continue;
               }
-              dlog("advertising ${count} new item(s) of ${types} type(s) to peer ${endpoint}",
-                   ("count", total_items_to_send_to_this_peer)
-                   ("types", items_to_advertise_by_type.size())
-                   ("endpoint", peer->get_remote_endpoint()));
-            for (auto items_group : items_to_advertise_by_type)
-              inventory_messages_to_send.push_back(std::make_pair(peer, item_ids_inventory_message(items_group.first, items_group.second)));
+              items_to_advertise_by_peer_and_type[i][item_to_advertise.item_type].push_back(item_to_advertise.item_hash);
+              _inventory.record_advertised_to_peer(inventory_entry, slot);
+              if (item_to_advertise.item_type == trx_message_type)
+                testnetlog("advertising transaction ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peers_to_advertise_to[i]->get_remote_endpoint()));
+            }
           }
-          peer->clear_old_inventory();
+
+          if (deferred)
+          {
+            const fc::time_point deferred_since = _transaction_relay_deferred_since.emplace(item_to_advertise, now).first->second;
+            if (now - deferred_since < fc::seconds(BTS_NET_MAX_TRANSACTION_RELAY_DELAY_SEC))
+              _new_inventory.insert(item_to_advertise);
+            else
+              _transaction_relay_deferred_since.erase(item_to_advertise);
+          }
+          else if (transaction_size)
+            _transaction_relay_deferred_since.erase(item_to_advertise);
+        }
+
+        for (unsigned i = 0; i < peers_to_advertise_to.size(); ++i)
+        {
+          dlog("advertising ${types} type(s) of new item(s) to peer ${endpoint}",
+               ("types", items_to_advertise_by_peer_and_type[i].size())
+               ("endpoint", peers_to_advertise_to[i]->get_remote_endpoint()));
+          for (auto& items_group : items_to_advertise_by_peer_and_type[i])
+            inventory_messages_to_send.push_back(std::make_pair(peers_to_advertise_to[i], item_ids_inventory_message(items_group.first, items_group.second)));
         }
 
         for (auto iter = inventory_messages_to_send.begin(); iter != inventory_messages_to_send.end(); ++iter)
           iter->first->send_message(iter->second);
         inventory_messages_to_send.clear();
-
-        if (_new_inventory.empty())
-        {
-          _retrigger_advertise_inventory_loop_promise = fc::promise<void>::ptr(new fc::promise<void>("bts::net::retrigger_advertise_inventory_loop"));
-          _retrigger_advertise_inventory_loop_promise->wait();
-          _retrigger_advertise_inventory_loop_promise.reset();
-        }
       } // while(!canceled)
     }
 
@@ -1626,6 +2136,18 @@ namespace bts { namespace net { namespace detail {
       case bts::client::message_type_enum::block_message_type:
         process_block_message( originating_peer, received_message, message_hash );
         break;
+      case bts::client::message_type_enum::compact_block_message_type:
+        on_compact_block_message( originating_peer, received_message.as<bts::client::compact_block_message>() );
+        break;
+      case bts::client::message_type_enum::fetch_block_transactions_message_type:
+        on_fetch_block_transactions_message( originating_peer, received_message.as<bts::client::fetch_block_transactions_message>() );
+        break;
+      case bts::client::message_type_enum::block_transactions_message_type:
+        on_block_transactions_message( originating_peer, received_message.as<bts::client::block_transactions_message>() );
+        break;
+      case bts::client::message_type_enum::trx_batch_message_type:
+        on_trx_batch_message( originating_peer, received_message.as<bts::client::trx_batch_message>() );
+        break;
       case core_message_type_enum::current_time_request_message_type:
         on_current_time_request_message( originating_peer, received_message.as<current_time_request_message>() );
         break;
@@ -1689,6 +2211,9 @@ namespace bts { namespace net { namespace detail {
       if (!_hard_fork_block_numbers.empty())
         user_data["last_known_fork_block_number"] = _hard_fork_block_numbers.back();
 
+      user_data["compact_blocks"] = true;
+      user_data["transaction_batches"] = true;
+
       return user_data;
     }
     void node_impl::parse_hello_user_data_for_peer(peer_connection* originating_peer, const fc::variant_object& user_data)
@@ -1711,6 +2236,10 @@ namespace bts { namespace net { namespace detail {
         originating_peer->node_id = user_data["node_id"].as<node_id_t>();
       if (user_data.contains("last_known_fork_block_number"))
         originating_peer->last_known_fork_block_number = user_data["last_known_fork_block_number"].as<uint32_t>();
+      if (user_data.contains("compact_blocks"))
+        originating_peer->supports_compact_blocks = user_data["compact_blocks"].as_bool();
+      if (user_data.contains("transaction_batches"))
+        originating_peer->supports_transaction_batches = user_data["transaction_batches"].as_bool();
     }
 
     void node_impl::on_hello_message( peer_connection* originating_peer, const hello_message& hello_message_received )
@@ -2416,18 +2945,28 @@ namespace bts { namespace net { namespace detail {
            ( "type", fetch_items_message_received.item_type )
            ( "endpoint", originating_peer->get_remote_endpoint() ) );
 
-      fc::optional<message> last_block_message_sent;
+      packed_message_ptr last_block_message_sent;
 
-      std::list<message> reply_messages;
+      std::list<packed_message_ptr> reply_messages;
+      // transactions for peers that understand trx_batch_messages are collected here and sent together
+      const bool batch_transactions = fetch_items_message_received.item_type == trx_message_type &&
+                                      originating_peer->supports_transaction_batches;
+      std::vector<packed_message_ptr> transactions_to_batch;
       for( const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch )
       {
         try
         {
-          message requested_message = _message_cache.get_message( item_hash );
+          packed_message_ptr requested_message = _message_cache.get_message( item_hash );
           dlog( "received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ( "endpoint", originating_peer->get_remote_endpoint() )
-               ( "id", requested_message.id() ) );
-          reply_messages.push_back( requested_message );
+               ( "id", item_hash ) );
+          packed_message_ptr compact_message;
+          if (originating_peer->supports_compact_blocks)
+            compact_message = _message_cache.get_compact_message( item_hash );
+          if (batch_transactions)
+            transactions_to_batch.push_back( requested_message );
+          else
+            reply_messages.push_back( compact_message ? compact_message : requested_message );
           if (fetch_items_message_received.item_type == block_message_type)
             last_block_message_sent = requested_message;
           continue;
@@ -2445,14 +2984,19 @@ namespace bts { namespace net { namespace detail {
                ( "id", requested_message.id() )
                ( "size", requested_message.size )
                ( "endpoint", originating_peer->get_remote_endpoint() ) );
-          reply_messages.push_back( requested_message );
+          if (batch_transactions)
+          {
+            transactions_to_batch.push_back( packed_message::pack( requested_message ) );
+            continue;
+          }
+          reply_messages.push_back( packed_message::pack( requested_message ) );
           if (fetch_items_message_received.item_type == block_message_type)
-            last_block_message_sent = requested_message;
+            last_block_message_sent = reply_messages.back();
           continue;
         }
         catch ( fc::key_not_found_exception& )
         {
-          reply_messages.push_back( item_not_available_message(item_to_fetch ) );
+          reply_messages.push_back( packed_message::pack( item_not_available_message(item_to_fetch ) ) );
           dlog( "received item request from peer ${endpoint} but we don't have it",
                ( "endpoint", originating_peer->get_remote_endpoint() ) );
         }
@@ -2461,13 +3005,44 @@ namespace bts { namespace net { namespace detail {
       // if we sent them a block, update our record of the last block they've seen accordingly
       if (last_block_message_sent)
       {
-        bts::client::block_message block = last_block_message_sent->as<bts::client::block_message>();
-        originating_peer->last_block_delegate_has_seen = block.block_id;
-        originating_peer->last_block_number_delegate_has_seen = _delegate->get_block_number(block.block_id);
-        originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(block.block_id);
+        // a block_message packs its block_id after the block, read just the id instead of unpacking the block
+        FC_ASSERT(last_block_message_sent->body_size() >= sizeof(bts::blockchain::block_id_type));
+        fc::datastream<const char*> block_id_stream(last_block_message_sent->body() + last_block_message_sent->body_size() - sizeof(bts::blockchain::block_id_type),
+                                                    sizeof(bts::blockchain::block_id_type));
+        bts::blockchain::block_id_type last_block_id;
+        fc::raw::unpack(block_id_stream, last_block_id);
+        originating_peer->last_block_delegate_has_seen = last_block_id;
+        originating_peer->last_block_number_delegate_has_seen = _delegate->get_block_number(last_block_id);
+        originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(last_block_id);
+      }
+
+      // a trx_message's body is just the packed transaction, so a trx_batch_message can be assembled
+      // from the bodies we already have without unpacking them
+      auto transaction_batch_begin = transactions_to_batch.begin();
+      while (transaction_batch_begin != transactions_to_batch.end())
+      {
+        auto transaction_batch_end = transaction_batch_begin;
+        size_t batch_size = 0;
+        do
+          batch_size += (*transaction_batch_end++)->body_size();
+        while (transaction_batch_end != transactions_to_batch.end() &&
+               batch_size + (*transaction_batch_end)->body_size() <= BTS_NET_MAX_TRANSACTION_BATCH_SIZE);
+
+        fc::unsigned_int transaction_count((uint32_t)(transaction_batch_end - transaction_batch_begin));
+        message batch_message;
+        batch_message.msg_type = bts::client::trx_batch_message_type;
+        batch_message.data.resize(fc::raw::pack_size(transaction_count) + batch_size);
+        fc::datastream<char*> batch_stream(batch_message.data.data(), batch_message.data.size());
+        fc::raw::pack(batch_stream, transaction_count);
+        for (auto iter = transaction_batch_begin; iter != transaction_batch_end; ++iter)
+          batch_stream.write((*iter)->body(), (*iter)->body_size());
+        batch_message.size = (uint32_t)batch_message.data.size();
+        reply_messages.push_back(packed_message::pack(batch_message));
+
+        transaction_batch_begin = transaction_batch_end;
       }
 
-      for (const message& reply : reply_messages)
+      for (const packed_message_ptr& reply : reply_messages)
         originating_peer->send_message(reply);
     }
 
@@ -2479,7 +3054,8 @@ namespace bts { namespace net { namespace detail {
       if (regular_item_iter != originating_peer->items_requested_from_peer.end())
       {
         originating_peer->items_requested_from_peer.erase( regular_item_iter );
-        originating_peer->inventory_peer_advertised_to_us.erase( requested_item );
+        if (originating_peer->inventory_slot)
+          _inventory.forget_peer_advertised_to_us(*originating_peer->inventory_slot, requested_item);
         if (is_item_in_any_peers_inventory(requested_item))
           _items_to_fetch.insert(prioritized_item_id(requested_item, _items_to_fetch_sequence_counter++));
         wlog("Peer doesn't have the requested item.");
@@ -2492,6 +3068,7 @@ namespace bts { namespace net { namespace detail {
       if (sync_item_iter != originating_peer->sync_items_requested_from_peer.end())
       {
         originating_peer->sync_items_requested_from_peer.erase(sync_item_iter);
+        sync_request_abandoned(requested_item.item_hash);
 
         if (originating_peer->peer_needs_sync_items_from_us)
           originating_peer->inhibit_fetching_sync_blocks = true;
@@ -2511,39 +3088,32 @@ namespace bts { namespace net { namespace detail {
     {
       VERIFY_CORRECT_THREAD();
 
+      // only active peers have a place in the inventory table
+      if (!originating_peer->inventory_slot)
+        return;
+
       // expire old inventory so we'll be making decisions our about whether to fetch blocks below based only on recent inventory
-      originating_peer->clear_old_inventory();
+      expire_old_inventory();
 
       dlog( "received inventory of ${count} items from peer ${endpoint}",
            ( "count", item_ids_inventory_message_received.item_hashes_available.size() )("endpoint", originating_peer->get_remote_endpoint() ) );
       for( const item_hash_t& item_hash : item_ids_inventory_message_received.item_hashes_available )
       {
         item_id advertised_item_id(item_ids_inventory_message_received.item_type, item_hash);
-        bool we_advertised_this_item_to_a_peer = false;
-        bool we_requested_this_item_from_a_peer = false;
-        for (const peer_connection_ptr peer : _active_connections)
-        {
-          if (peer->inventory_advertised_to_peer.find(advertised_item_id) != peer->inventory_advertised_to_peer.end())
-          {
-            we_advertised_this_item_to_a_peer = true;
-            break;
-          }
-          if (peer->items_requested_from_peer.find(advertised_item_id) != peer->items_requested_from_peer.end())
-            we_requested_this_item_from_a_peer = true;
-        }
-
         // if we have already advertised it to a peer, we must have it, no need to do anything else
-        if (!we_advertised_this_item_to_a_peer)
+        if (!_inventory.advertised_to_any_peer(advertised_item_id))
         {
           // if the peer has flooded us with transactions, don't add these to the inventory to prevent our
           // inventory list from growing without bound.  We try to allow fetching blocks even when
           // we've stopped fetching transactions.
           if ((item_ids_inventory_message_received.item_type == bts::client::trx_message_type &&
-               originating_peer->is_inventory_advertised_to_us_list_full_for_transactions()) ||
-              originating_peer->is_inventory_advertised_to_us_list_full())
+               is_inventory_advertised_to_us_list_full_for_transactions(originating_peer)) ||
+              is_inventory_advertised_to_us_list_full(originating_peer))
             break;
-          originating_peer->inventory_peer_advertised_to_us.insert(peer_connection::timestamped_item_id(advertised_item_id, fc::time_point::now()));
-          if (!we_requested_this_item_from_a_peer)
+          // if another peer advertised it, it's already on the list to fetch or has been requested
+          bool another_peer_advertised_this_item = _inventory.any_peer_advertised_to_us(advertised_item_id);
+          _inventory.record_peer_advertised_to_us(*originating_peer->inventory_slot, advertised_item_id, fc::time_point::now());
+          if (!another_peer_advertised_this_item)
           {
             auto insert_result = _items_to_fetch.insert(prioritized_item_id(advertised_item_id, _items_to_fetch_sequence_counter++));
             if (insert_result.second)
@@ -2611,6 +3181,7 @@ namespace bts { namespace net { namespace detail {
       _closing_connections.erase( originating_peer_ptr );
       _handshaking_connections.erase( originating_peer_ptr );
       _terminating_connections.erase( originating_peer_ptr );
+      release_inventory_slot( originating_peer_ptr );
       if( _active_connections.find(originating_peer_ptr) != _active_connections.end() )
       {
         _active_connections.erase( originating_peer_ptr );
@@ -2639,7 +3210,7 @@ namespace bts { namespace net { namespace detail {
       if (!originating_peer->sync_items_requested_from_peer.empty())
       {
         for (auto sync_item_and_time : originating_peer->sync_items_requested_from_peer)
-          _active_sync_requests.erase(sync_item_and_time.first.item_hash);
+          sync_request_abandoned(sync_item_and_time.first.item_hash);
         trigger_fetch_sync_items_loop();
       }
       if (!originating_peer->items_requested_from_peer.empty())
@@ -2869,34 +3440,32 @@ namespace bts { namespace net { namespace detail {
 
       do
       {
-        std::copy(std::make_move_iterator(_new_received_sync_items.begin()),
-                  std::make_move_iterator(_new_received_sync_items.end()),
-                  std::front_inserter(_received_sync_items));
-        _new_received_sync_items.clear();
         dlog("currently ${count} sync items to consider", ("count", _received_sync_items.size()));
 
         block_processed_this_iteration = false;
-        for (auto received_block_iter = _received_sync_items.begin();
-             received_block_iter != _received_sync_items.end();
-             ++received_block_iter)
+        // the only blocks we can process are the ones at the front of some peer's list of blocks to
+        // fetch, so look those up instead of searching through everything we've received
+        for (const peer_connection_ptr& front_peer : _active_connections)
         {
+          ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
+          if (front_peer->ids_of_items_to_get.empty())
+            continue;
+          auto received_block_iter = _received_sync_items.find(front_peer->ids_of_items_to_get.front());
+          if (received_block_iter == _received_sync_items.end())
+            continue;
 
-          // find out if this block is the next block on the active chain or one of the forks
-          bool potential_first_block = false;
+          // this block is the next block on the active chain or one of the forks, remove it from all sync peers lists
           for (const peer_connection_ptr& peer : _active_connections)
           {
-            ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
             if (!peer->ids_of_items_to_get.empty() &&
-                peer->ids_of_items_to_get.front() == received_block_iter->block_id)
+                peer->ids_of_items_to_get.front() == received_block_iter->first)
             {
-              potential_first_block = true;
               peer->ids_of_items_to_get.pop_front();
-              peer->ids_of_items_being_processed.insert(received_block_iter->block_id);
+              peer->ids_of_items_being_processed.insert(received_block_iter->first);
             }
           }
 
-          // if it is, process it, remove it from all sync peers lists
-          if (potential_first_block)
+          // and process it
           {
             // we can get into an intersting situation near the end of synchronization.  We can be in
             // sync with one peer who is sending us the last block on the chain via a regular inventory
@@ -2905,9 +3474,9 @@ namespace bts { namespace net { namespace detail {
             // we don't know they're the same (for the peer in normal operation, it has only told us the
             // message id, for the peer in the sync case we only known the block_id).
             if (std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
-                          received_block_iter->block_id) == _most_recent_blocks_accepted.end())
+                          received_block_iter->first) == _most_recent_blocks_accepted.end())
             {
-              bts::client::block_message block_message_to_process = *received_block_iter;
+              bts::client::block_message block_message_to_process = std::move(received_block_iter->second);
               _received_sync_items.erase(received_block_iter);
               _handle_message_calls_in_progress.emplace_back(fc::async([this, block_message_to_process](){ 
                 send_sync_block_to_node_delegate(block_message_to_process);
@@ -2916,11 +3485,14 @@ namespace bts { namespace net { namespace detail {
               block_processed_this_iteration = true;
             }
             else
+            {
               dlog("Already received and accepted this block (presumably through normal inventory mechanism), treating it as accepted");
+              _received_sync_items.erase(received_block_iter);
+            }
 
-            break; // start iterating _received_sync_items from the beginning
-          } // end if potential_first_block
-        } // end for each block in _received_sync_items
+            break; // the peers' lists have changed, start looking from the beginning
+          }
+        } // end for each peer's next block
 
         if (_handle_message_calls_in_progress.size() >= _maximum_number_of_blocks_to_handle_at_one_time)
         {
@@ -2953,9 +3525,9 @@ namespace bts { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "received a sync block from peer ${endpoint}", ("endpoint", originating_peer->get_remote_endpoint() ) );
 
-      // add it to the front of _received_sync_items, then process _received_sync_items to try to
+      // add it to _received_sync_items, then process _received_sync_items to try to
       // pass as many messages as possible to the client.
-      _new_received_sync_items.push_front( block_message_to_process );
+      _received_sync_items.insert( received_sync_items_map::value_type(block_message_to_process.block_id, block_message_to_process) );
       trigger_process_backlog_of_sync_blocks();
     }
 
@@ -3002,19 +3574,18 @@ namespace bts { namespace net { namespace detail {
         {
           ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
 
-          auto iter = peer->inventory_peer_advertised_to_us.find(block_message_item_id);
-          if (iter != peer->inventory_peer_advertised_to_us.end())
+          if (peer->inventory_slot && _inventory.peer_advertised_to_us(*peer->inventory_slot, block_message_item_id))
           {
-            // this peer offered us the item.  It will eventually expire from the peer's 
-            // inventory_peer_advertised_to_us list after some time has passed (currently 2 minutes).
+            // this peer offered us the item.  It will eventually expire from the
+            // inventory table after some time has passed (currently 2 minutes).
             // For now, it will remain there, which will prevent us from offering the peer this 
             // block back when we rebroadcast the block below
             peer->last_block_delegate_has_seen = block_message_to_process.block_id;
             peer->last_block_number_delegate_has_seen = block_number;
             peer->last_block_time_delegate_has_seen = block_time;
           }
-          peer->clear_old_inventory();
         }
+        expire_old_inventory();
         message_propagation_data propagation_data{message_receive_time, message_validated_time, originating_peer->node_id};
         broadcast( block_message_to_process, propagation_data );
         _message_cache.block_accepted();
@@ -3098,19 +3669,42 @@ namespace bts { namespace net { namespace detail {
                                                                                             block_message_to_process.block_id));
         if (sync_item_iter != originating_peer->sync_items_requested_from_peer.end())
         {
+          // keep a moving average of how long the peer takes per block, counting from the request or
+          // from its previous block, whichever is later, so pipelined requests aren't counted twice
+          fc::time_point now = fc::time_point::now();
+          fc::microseconds time_for_this_block = now - std::max(sync_item_iter->second, originating_peer->last_sync_block_received_time);
+          if (originating_peer->sync_block_interval == fc::microseconds())
+            originating_peer->sync_block_interval = time_for_this_block;
+          else
+            originating_peer->sync_block_interval = fc::microseconds((3 * originating_peer->sync_block_interval.count() + time_for_this_block.count()) / 4);
+          originating_peer->last_sync_block_received_time = now;
           originating_peer->sync_items_requested_from_peer.erase(sync_item_iter);
-          _active_sync_requests.erase(block_message_to_process.block_id);
-          process_block_during_sync(originating_peer, block_message_to_process, message_hash);
-          if (originating_peer->idle())
+
+          bool duplicate_of_reassigned_request = false;
+          auto reassigned_iter = _reassigned_sync_requests.find(block_message_to_process.block_id);
+          if (reassigned_iter != _reassigned_sync_requests.end())
           {
-            // we have finished fetching a batch of items, so we either need to grab another batch of items
-            // or we need to get another list of item ids.
-            if (originating_peer->number_of_unfetched_item_ids > 0 &&
-                originating_peer->ids_of_items_to_get.size() < BTS_NET_MIN_BLOCK_IDS_TO_PREFETCH)
-              fetch_next_batch_of_item_ids_from_peer(originating_peer);
-            else
-              trigger_fetch_sync_items_loop();
+            duplicate_of_reassigned_request = reassigned_iter->second.received;
+            reassigned_iter->second.received = true;
+            if (--reassigned_iter->second.outstanding_requests == 0)
+              _reassigned_sync_requests.erase(reassigned_iter);
+          }
+          if (duplicate_of_reassigned_request)
+            dlog("dropping sync block ${id} from peer ${endpoint}, we already received it from another peer",
+                 ("id", block_message_to_process.block_id)("endpoint", originating_peer->get_remote_endpoint()));
+          else
+          {
+            _active_sync_requests.erase(block_message_to_process.block_id);
+            process_block_during_sync(originating_peer, block_message_to_process, message_hash);
           }
+
+          // we either need to grab another list of item ids, or refill the peer's request pipeline
+          if (originating_peer->idle() &&
+              originating_peer->number_of_unfetched_item_ids > 0 &&
+              originating_peer->ids_of_items_to_get.size() < BTS_NET_MIN_BLOCK_IDS_TO_PREFETCH)
+            fetch_next_batch_of_item_ids_from_peer(originating_peer);
+          else
+            trigger_fetch_sync_items_loop();
           return;
         }
       }
@@ -3128,6 +3722,269 @@ namespace bts { namespace net { namespace detail {
       disconnect_from_peer(originating_peer, "You sent me a block that I didn't ask for", true, detailed_error);
     }
 
+    void node_impl::on_compact_block_message(peer_connection* originating_peer,
+                                             const bts::client::compact_block_message& compact_block_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      item_id requested_item(bts::client::block_message_type, compact_block_message_received.block_message_hash);
+      if (originating_peer->items_requested_from_peer.find(requested_item) == originating_peer->items_requested_from_peer.end())
+      {
+        wlog("received a compact block I didn't ask for from peer ${endpoint}, disconnecting from peer",
+             ("endpoint", originating_peer->get_remote_endpoint()));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a compact block that I didn't ask for, message hash: ${hash}",
+                                                    ("hash", compact_block_message_received.block_message_hash)));
+        disconnect_from_peer(originating_peer, "You sent me a block that I didn't ask for", true, detailed_error);
+        return;
+      }
+
+      // forget blocks whose request has already timed out or been satisfied some other way
+      for (auto iter = originating_peer->compact_blocks_being_rebuilt.begin(); iter != originating_peer->compact_blocks_being_rebuilt.end();)
+        if (originating_peer->items_requested_from_peer.find(item_id(bts::client::block_message_type, iter->second.block_message_hash)) ==
+            originating_peer->items_requested_from_peer.end())
+          iter = originating_peer->compact_blocks_being_rebuilt.erase(iter);
+        else
+          ++iter;
+
+      peer_connection::partial_compact_block compact_block;
+      compact_block.block_message_hash = compact_block_message_received.block_message_hash;
+      compact_block.block.block_id = compact_block_message_received.block_header.id();
+      static_cast<bts::blockchain::signed_block_header&>(compact_block.block.block) = compact_block_message_received.block_header;
+
+      const std::vector<bts::client::short_transaction_id_type>& short_ids = compact_block_message_received.short_transaction_ids;
+      compact_block.block.block.user_transactions.resize(short_ids.size());
+
+      std::unordered_map<bts::client::short_transaction_id_type, uint32_t> index_by_short_id;
+      for (uint32_t i = 0; i < short_ids.size(); ++i)
+        index_by_short_id[short_ids[i]] = i;
+
+      std::vector<bool> transaction_found(short_ids.size(), false);
+      size_t transactions_found = 0;
+      auto find_index_of = [&](const bts::blockchain::transaction_id_type& transaction_id) -> fc::optional<uint32_t>
+      {
+        auto iter = index_by_short_id.find(bts::client::compact_block_message::short_transaction_id(compact_block.block.block_id, transaction_id));
+        if (iter == index_by_short_id.end() || transaction_found[iter->second])
+          return fc::optional<uint32_t>();
+        return iter->second;
+      };
+
+      // the short ids are matched against transaction ids only, a transaction is fetched by its id once it
+      // matches.  transactions we relayed recently are in our message cache, anything older has to come
+      // from the client
+      std::vector<std::pair<bts::blockchain::transaction_id_type, uint32_t> > matched_cached_transactions;
+      _message_cache.for_each_contents_hash_of_type(bts::client::trx_message_type, [&](const fc::uint160_t& transaction_id) {
+        fc::optional<uint32_t> index = find_index_of(transaction_id);
+        if (index)
+        {
+          matched_cached_transactions.emplace_back(transaction_id, *index);
+          transaction_found[*index] = true;
+          ++transactions_found;
+        }
+      });
+      for (const auto& matched_transaction : matched_cached_transactions)
+        compact_block.block.block.user_transactions[matched_transaction.second] =
+          _message_cache.get_message_by_contents_hash(matched_transaction.first)->as<bts::client::trx_message>().trx;
+
+      if (transactions_found < short_ids.size())
+      {
+        std::vector<bts::blockchain::transaction_id_type> matched_pending_transaction_ids;
+        std::vector<uint32_t> matched_pending_transaction_indexes;
+        for (const bts::blockchain::transaction_id_type& pending_transaction_id : _delegate->get_pending_transaction_ids())
+        {
+          fc::optional<uint32_t> index = find_index_of(pending_transaction_id);
+          if (index)
+          {
+            matched_pending_transaction_ids.push_back(pending_transaction_id);
+            matched_pending_transaction_indexes.push_back(*index);
+            transaction_found[*index] = true;
+          }
+        }
+        if (!matched_pending_transaction_ids.empty())
+        {
+          std::vector<fc::optional<bts::blockchain::signed_transaction> > pending_transactions =
+            _delegate->get_pending_transactions(matched_pending_transaction_ids);
+          for (uint32_t i = 0; i < matched_pending_transaction_ids.size(); ++i)
+          {
+            // the client may have dropped it in the meantime, then it has to be fetched from the peer
+            if (i < pending_transactions.size() && pending_transactions[i])
+            {
+              compact_block.block.block.user_transactions[matched_pending_transaction_indexes[i]] = std::move(*pending_transactions[i]);
+              ++transactions_found;
+            }
+            else
+              transaction_found[matched_pending_transaction_indexes[i]] = false;
+          }
+        }
+      }
+
+      for (uint32_t i = 0; i < short_ids.size(); ++i)
+        if (!transaction_found[i])
+          compact_block.missing_transaction_indexes.push_back(i);
+
+      dlog("received compact block ${id} with ${count} transactions from peer ${endpoint}, ${missing} of them are missing",
+           ("id", compact_block.block.block_id)("count", short_ids.size())
+           ("missing", compact_block.missing_transaction_indexes.size())("endpoint", originating_peer->get_remote_endpoint()));
+      process_compact_block(originating_peer, compact_block);
+    }
+
+    void node_impl::on_fetch_block_transactions_message(peer_connection* originating_peer,
+                                                        const bts::client::fetch_block_transactions_message& fetch_block_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      bts::client::block_transactions_message reply;
+      reply.block_id = fetch_block_transactions_message_received.block_id;
+
+      // if we can't find the block or the request is out of range, the empty reply tells the peer to
+      // fetch the block from somewhere else.  Requests for more transactions than the block has, for the
+      // same transaction twice, or for a reply too large to send are refused the same way, so a peer
+      // can't make us send back more than the block itself
+      try
+      {
+        bts::client::block_message requested_block;
+        try
+        {
+          requested_block = _message_cache.get_message_by_contents_hash(reply.block_id)->as<bts::client::block_message>();
+        }
+        catch (const fc::key_not_found_exception&)
+        {
+          requested_block = _delegate->get_item(item_id(bts::client::block_message_type, reply.block_id)).as<bts::client::block_message>();
+        }
+
+        const bts::blockchain::signed_transactions& transactions = requested_block.block.user_transactions;
+        const std::vector<uint32_t>& indexes = fetch_block_transactions_message_received.transaction_indexes;
+        if (indexes.size() <= transactions.size())
+        {
+          std::vector<bool> already_requested(transactions.size(), false);
+          size_t reply_size = fc::raw::pack_size(reply);
+          for (uint32_t index : indexes)
+          {
+            if (index >= transactions.size() || already_requested[index])
+            {
+              reply.transactions.clear();
+              break;
+            }
+            already_requested[index] = true;
+            reply_size += fc::raw::pack_size(transactions[index]);
+            if (reply_size > MAX_MESSAGE_SIZE)
+            {
+              reply.transactions.clear();
+              break;
+            }
+            reply.transactions.push_back(transactions[index]);
+          }
+        }
+        else
+          wlog("peer ${endpoint} requested ${requested} transactions of block ${id}, which only has ${count}",
+               ("endpoint", originating_peer->get_remote_endpoint())("requested", indexes.size())
+               ("id", reply.block_id)("count", transactions.size()));
+      }
+      catch (const fc::key_not_found_exception&)
+      {
+        wlog("peer ${endpoint} requested transactions of block ${id}, which I don't have",
+             ("endpoint", originating_peer->get_remote_endpoint())("id", reply.block_id));
+      }
+      originating_peer->send_message(reply);
+    }
+
+    void node_impl::on_block_transactions_message(peer_connection* originating_peer,
+                                                  const bts::client::block_transactions_message& block_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      auto iter = originating_peer->compact_blocks_being_rebuilt.find(block_transactions_message_received.block_id);
+      if (iter == originating_peer->compact_blocks_being_rebuilt.end())
+      {
+        dlog("received transactions for block ${id} from peer ${endpoint}, but we're not waiting for any, ignoring",
+             ("id", block_transactions_message_received.block_id)("endpoint", originating_peer->get_remote_endpoint()));
+        return;
+      }
+
+      if (block_transactions_message_received.transactions.size() != iter->second.missing_transaction_indexes.size())
+      {
+        abandon_compact_block(originating_peer, block_transactions_message_received.block_id);
+        return;
+      }
+
+      peer_connection::partial_compact_block compact_block = std::move(iter->second);
+      originating_peer->compact_blocks_being_rebuilt.erase(iter);
+
+      for (size_t i = 0; i < compact_block.missing_transaction_indexes.size(); ++i)
+        compact_block.block.block.user_transactions[compact_block.missing_transaction_indexes[i]] = block_transactions_message_received.transactions[i];
+      compact_block.missing_transaction_indexes.clear();
+      process_compact_block(originating_peer, compact_block);
+    }
+
+    void node_impl::on_trx_batch_message(peer_connection* originating_peer,
+                                         const bts::client::trx_batch_message& trx_batch_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      dlog("received a batch of ${count} transactions from peer ${endpoint}",
+           ("count", trx_batch_message_received.transactions.size())("endpoint", originating_peer->get_remote_endpoint()));
+      // handle each one as the trx_message we requested, process_ordinary_message checks that we asked for it
+      for (const bts::blockchain::signed_transaction& transaction : trx_batch_message_received.transactions)
+      {
+        message transaction_message(bts::client::trx_message(transaction));
+        process_ordinary_message(originating_peer, transaction_message, transaction_message.id());
+        if (originating_peer->we_have_requested_close)
+          break;
+      }
+    }
+
+    void node_impl::process_compact_block(peer_connection* originating_peer, peer_connection::partial_compact_block& compact_block)
+    {
+      VERIFY_CORRECT_THREAD();
+      const bts::blockchain::block_id_type block_id = compact_block.block.block_id;
+      if (!compact_block.missing_transaction_indexes.empty())
+      {
+        originating_peer->send_message(bts::client::fetch_block_transactions_message(block_id, compact_block.missing_transaction_indexes));
+        originating_peer->compact_blocks_being_rebuilt[block_id] = std::move(compact_block);
+        return;
+      }
+
+      message rebuilt_block_message(compact_block.block);
+      message_hash_type rebuilt_block_message_hash = rebuilt_block_message.id();
+      if (rebuilt_block_message_hash != compact_block.block_message_hash)
+      {
+        if (!compact_block.fetching_all_transactions)
+        {
+          // a short id matched the wrong transaction, get all of them from the peer instead
+          wlog("block ${id} rebuilt from a compact block doesn't match, fetching all of its transactions from peer ${endpoint}",
+               ("id", block_id)("endpoint", originating_peer->get_remote_endpoint()));
+          compact_block.fetching_all_transactions = true;
+          for (uint32_t i = 0; i < compact_block.block.block.user_transactions.size(); ++i)
+            compact_block.missing_transaction_indexes.push_back(i);
+          process_compact_block(originating_peer, compact_block);
+          return;
+        }
+
+        wlog("block ${id} from peer ${endpoint} doesn't match the block it offered us even with all of its transactions, disconnecting from peer",
+             ("id", block_id)("endpoint", originating_peer->get_remote_endpoint()));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a compact block that doesn't match the block you offered, block_id: ${block_id}",
+                                                    ("block_id", block_id)));
+        disconnect_from_peer(originating_peer, "You sent me a compact block that doesn't match the block you offered", true, detailed_error);
+        return;
+      }
+
+      process_block_message(originating_peer, rebuilt_block_message, rebuilt_block_message_hash);
+    }
+
+    void node_impl::abandon_compact_block(peer_connection* originating_peer, const bts::blockchain::block_id_type& block_id)
+    {
+      VERIFY_CORRECT_THREAD();
+      auto iter = originating_peer->compact_blocks_being_rebuilt.find(block_id);
+      if (iter == originating_peer->compact_blocks_being_rebuilt.end())
+        return;
+
+      // treat it like the peer told us it doesn't have the block, and get it from someone else
+      wlog("peer ${endpoint} couldn't send us the transactions of block ${id}", ("endpoint", originating_peer->get_remote_endpoint())("id", block_id));
+      item_id requested_item(bts::client::block_message_type, iter->second.block_message_hash);
+      originating_peer->compact_blocks_being_rebuilt.erase(iter);
+      originating_peer->items_requested_from_peer.erase(requested_item);
+      if (originating_peer->inventory_slot)
+        _inventory.forget_peer_advertised_to_us(*originating_peer->inventory_slot, requested_item);
+      if (is_item_in_any_peers_inventory(requested_item))
+        _items_to_fetch.insert(prioritized_item_id(requested_item, _items_to_fetch_sequence_counter++));
+      trigger_fetch_items_loop();
+    }
+
     void node_impl::on_current_time_request_message(peer_connection* originating_peer,
                                                     const current_time_request_message& current_time_request_message_received)
     {
@@ -4013,6 +4870,8 @@ namespace bts { namespace net { namespace detail {
       _handshaking_connections.erase(peer);
       _closing_connections.erase(peer);
       _terminating_connections.erase(peer);
+      if (!peer->inventory_slot)
+        peer->inventory_slot = _inventory.allocate_slot();
     }
 
     void node_impl::move_peer_to_closing_list(const peer_connection_ptr& peer)
@@ -4022,6 +4881,7 @@ namespace bts { namespace net { namespace detail {
       _handshaking_connections.erase(peer);
       _closing_connections.insert(peer);
       _terminating_connections.erase(peer);
+      release_inventory_slot(peer);
     }
 
     void node_impl::move_peer_to_terminating_list(const peer_connection_ptr& peer)
@@ -4031,6 +4891,7 @@ namespace bts { namespace net { namespace detail {
       _handshaking_connections.erase(peer);
       _closing_connections.erase(peer);
       _terminating_connections.insert(peer);
+      release_inventory_slot(peer);
     }
 
     void node_impl::dump_node_status()
@@ -4060,16 +4921,20 @@ namespace bts { namespace net { namespace detail {
       ilog( "--------- MEMORY USAGE ------------" );
       ilog( "node._active_sync_requests size: ${size}", ("size", _active_sync_requests.size() ) ); // TODO: un-break this
       ilog( "node._received_sync_items size: ${size}", ("size", _received_sync_items.size() ) );
-      ilog( "node._new_received_sync_items size: ${size}", ("size", _new_received_sync_items.size() ) );
+      ilog( "node._reassigned_sync_requests size: ${size}", ("size", _reassigned_sync_requests.size() ) );
       ilog( "node._items_to_fetch size: ${size}", ("size", _items_to_fetch.size() ) );
       ilog( "node._new_inventory size: ${size}", ("size", _new_inventory.size() ) );
+      ilog( "node._inventory size: ${size}", ("size", _inventory.size() ) );
       ilog( "node._message_cache size: ${size}", ("size", _message_cache.size() ) );
       for( const peer_connection_ptr& peer : _active_connections )
       {
         ilog( "  peer ${endpoint}", ("endpoint", peer->get_remote_endpoint() ) );
         ilog( "    peer.ids_of_items_to_get size: ${size}", ("size", peer->ids_of_items_to_get.size() ) );
-        ilog( "    peer.inventory_peer_advertised_to_us size: ${size}", ("size", peer->inventory_peer_advertised_to_us.size() ) );
-        ilog( "    peer.inventory_advertised_to_peer size: ${size}", ("size", peer->inventory_advertised_to_peer.size() ) );
+        if( peer->inventory_slot )
+        {
+          ilog( "    peer inventory advertised to us size: ${size}", ("size", _inventory.number_of_items_peer_advertised_to_us( *peer->inventory_slot ) ) );
+          ilog( "    peer inventory advertised to peer size: ${size}", ("size", _inventory.number_of_items_advertised_to_peer( *peer->inventory_slot ) ) );
+        }
         ilog( "    peer.items_requested_from_peer size: ${size}", ("size", peer->items_requested_from_peer.size() ) );
         ilog( "    peer.sync_items_requested_from_peer size: ${size}", ("size", peer->sync_items_requested_from_peer.size() ) );
       }
@@ -4257,22 +5122,28 @@ namespace bts { namespace net { namespace detail {
     void node_impl::broadcast( const message& item_to_broadcast, const message_propagation_data& propagation_data )
     {
       VERIFY_CORRECT_THREAD();
+      // packed once here, every peer that fetches the item is sent this same frame
+      packed_message_ptr packed_item_to_broadcast = packed_message::pack( item_to_broadcast );
+      message_hash_type hash_of_item_to_broadcast = packed_item_to_broadcast->id();
+
       fc::uint160_t hash_of_message_contents;
+      packed_message_ptr packed_compact_item_to_broadcast;
       if( item_to_broadcast.msg_type == bts::client::block_message_type )
       {
         bts::client::block_message block_message_to_broadcast = item_to_broadcast.as<bts::client::block_message>();
         hash_of_message_contents = block_message_to_broadcast.block_id; // for debugging
         _most_recent_blocks_accepted.push_back( block_message_to_broadcast.block_id );
+        packed_compact_item_to_broadcast = packed_message::pack( bts::client::compact_block_message( block_message_to_broadcast,
+                                                                                                     hash_of_item_to_broadcast ) );
       }
       else if( item_to_broadcast.msg_type == bts::client::trx_message_type )
       {
         bts::client::trx_message transaction_message_to_broadcast = item_to_broadcast.as<bts::client::trx_message>();
-        hash_of_message_contents = transaction_message_to_broadcast.trx.id(); // for debugging
+        hash_of_message_contents = transaction_message_to_broadcast.trx.id(); // also how compact blocks find the transaction
         dlog( "broadcasting trx: ${trx}", ("trx", transaction_message_to_broadcast) );
       }
-      message_hash_type hash_of_item_to_broadcast = item_to_broadcast.id();
-
-      _message_cache.cache_message( item_to_broadcast, hash_of_item_to_broadcast, propagation_data, hash_of_message_contents );
+      _message_cache.cache_message( packed_item_to_broadcast, hash_of_item_to_broadcast, propagation_data, hash_of_message_contents,
+                                    packed_compact_item_to_broadcast );
       _new_inventory.insert( item_id(item_to_broadcast.msg_type, hash_of_item_to_broadcast ) );
       trigger_advertise_inventory_loop();
     }
@@ -4325,6 +5196,8 @@ namespace bts { namespace net { namespace detail {
         _maximum_number_of_sync_blocks_to_prefetch = params["maximum_number_of_sync_blocks_to_prefetch"].as<uint32_t>();
       if (params.contains("maximum_blocks_per_peer_during_syncing"))
         _maximum_blocks_per_peer_during_syncing = params["maximum_blocks_per_peer_during_syncing"].as<uint32_t>();
+      if (params.contains("message_cache_size_limit"))
+        _message_cache.set_size_limit(params["message_cache_size_limit"].as<uint64_t>());
 
       _desired_number_of_connections = std::min(_desired_number_of_connections, _maximum_number_of_connections);
 
@@ -4347,6 +5220,8 @@ namespace bts { namespace net { namespace detail {
         result["maximum_number_of_sync_blocks_to_prefetch"] = _maximum_number_of_sync_blocks_to_prefetch;
       if (_maximum_blocks_per_peer_during_syncing != BTS_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING)
       result["maximum_blocks_per_peer_during_syncing"] = _maximum_blocks_per_peer_during_syncing;
+      if (_message_cache.get_size_limit() != BTS_NET_MESSAGE_CACHE_SIZE_LIMIT)
+        result["message_cache_size_limit"] = _message_cache.get_size_limit();
       return result;
     }
 
@@ -4414,6 +5289,7 @@ namespace bts { namespace net { namespace detail {
       info["listening_on"] = _actual_listening_endpoint;
       info["node_public_key"] = _node_public_key;
       info["node_id"] = _node_id;
+      info["message_cache"] = _message_cache.get_statistics();
       return info;
     }
     fc::variant_object node_impl::network_get_usage_stats() const
@@ -4764,6 +5640,16 @@ namespace bts { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(get_item, id);
     }
 
+    std::vector<bts::blockchain::transaction_id_type> statistics_gathering_node_delegate_wrapper::get_pending_transaction_ids()
+    {
+      INVOKE_AND_COLLECT_STATISTICS(get_pending_transaction_ids);
+    }
+
+    std::vector<fc::optional<bts::blockchain::signed_transaction> > statistics_gathering_node_delegate_wrapper::get_pending_transactions( const std::vector<bts::blockchain::transaction_id_type>& ids )
+    {
+      INVOKE_AND_COLLECT_STATISTICS(get_pending_transactions, ids);
+    }
+
     fc::sha256 statistics_gathering_node_delegate_wrapper::get_chain_id() const
     {
       INVOKE_AND_COLLECT_STATISTICS(get_chain_id);
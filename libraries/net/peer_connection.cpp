@@ -1,6 +1,8 @@
 #include <bts/net/peer_connection.hpp>
 #include <bts/net/exceptions.hpp>
 
+#include <algorithm>
+
 #ifdef DEFAULT_LOGGER
 # undef DEFAULT_LOGGER
 #endif
@@ -14,6 +16,34 @@
 
 namespace bts { namespace net
   {
+    token_bucket::token_bucket(uint32_t tokens_per_second, uint32_t capacity) :
+      _tokens_per_second(tokens_per_second),
+      _capacity(capacity),
+      _tokens(capacity),
+      _last_refill_time(fc::time_point::now())
+    {
+    }
+
+    void token_bucket::refill()
+    {
+      fc::time_point now = fc::time_point::now();
+      int64_t tokens_earned = (now - _last_refill_time).count() * _tokens_per_second / fc::seconds(1).count();
+      if (tokens_earned > 0)
+      {
+        _tokens = std::min<int64_t>(_tokens + tokens_earned, _capacity);
+        _last_refill_time = now;
+      }
+    }
+
+    bool token_bucket::try_consume(uint32_t tokens)
+    {
+      refill();
+      if (_tokens < std::min(tokens, _capacity))
+        return false;
+      _tokens -= tokens;
+      return true;
+    }
+
     peer_connection::peer_connection(peer_connection_delegate* delegate) :
       _node(delegate),
       _message_connection(this),
@@ -30,6 +60,10 @@ namespace bts { namespace net
       we_need_sync_items_from_peer(true),
       last_block_number_delegate_has_seen(0),
       inhibit_fetching_sync_blocks(false),
+      sync_block_interval(0),
+      supports_compact_blocks(false),
+      supports_transaction_batches(false),
+      transaction_relay_bucket(BTS_NET_TRANSACTION_RELAY_BYTES_PER_SEC, BTS_NET_TRANSACTION_RELAY_BURST_BYTES),
       transaction_fetching_inhibited_until(fc::time_point::min()),
       last_known_fork_block_number(0)
 #ifndef NDEBUG
@@ -235,19 +269,21 @@ namespace bts { namespace net
         _queued_messages.front().transmission_start_time = fc::time_point::now();
         try
         {
+          queued_message& message_to_send = _queued_messages.front();
           dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
                "to send message of type ${type} for peer ${endpoint}",
-               ("type", _queued_messages.front().message_to_send.msg_type)("endpoint", get_remote_endpoint()));
-          if (_queued_messages.front().message_send_time_field_offset != (size_t)-1)
+               ("type", message_to_send.msg_type())("endpoint", get_remote_endpoint()));
+          if (!message_to_send.packed_message_to_send)
           {
             // patch the current time into the message.  Since this operates on the packed version of the structure,
             // it won't work for anything after a variable-length field
             std::vector<char> packed_current_time = fc::raw::pack(fc::time_point::now());
-            assert(_queued_messages.front().message_send_time_field_offset + packed_current_time.size() <= _queued_messages.front().message_to_send.data.size());
-            memcpy(_queued_messages.front().message_to_send.data.data() + _queued_messages.front().message_send_time_field_offset,
+            assert(message_to_send.message_send_time_field_offset + packed_current_time.size() <= message_to_send.unpacked_message->data.size());
+            memcpy(message_to_send.unpacked_message->data.data() + message_to_send.message_send_time_field_offset,
                    packed_current_time.data(), packed_current_time.size());
+            message_to_send.packed_message_to_send = packed_message::pack(*message_to_send.unpacked_message);
           }
-          _message_connection.send_message(_queued_messages.front().message_to_send);
+          _message_connection.send_message(*message_to_send.packed_message_to_send);
           dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_message() completed normally for peer ${endpoint}",
                ("endpoint", get_remote_endpoint()));
         }
@@ -278,19 +314,34 @@ namespace bts { namespace net
           elog("message_oriented_exception::send_message() threw an unhandled exception");
         }
         _queued_messages.front().transmission_finish_time = fc::time_point::now();
-        _total_queued_messages_size -= _queued_messages.front().message_to_send.size;
+        _total_queued_messages_size -= _queued_messages.front().size();
         _queued_messages.pop();
       }
       dlog("leaving peer_connection::send_queued_messages_task() due to queue exhaustion");
     }
 
     void peer_connection::send_message(const message& message_to_send, size_t message_send_time_field_offset)
+    {
+      VERIFY_CORRECT_THREAD();
+      if (message_send_time_field_offset == (size_t)-1)
+        enqueue_message(queued_message(packed_message::pack(message_to_send)));
+      else
+        enqueue_message(queued_message(message_to_send, message_send_time_field_offset));
+    }
+
+    void peer_connection::send_message(const packed_message_ptr& message_to_send)
+    {
+      VERIFY_CORRECT_THREAD();
+      enqueue_message(queued_message(message_to_send));
+    }
+
+    void peer_connection::enqueue_message(queued_message&& message_to_enqueue)
     {
       VERIFY_CORRECT_THREAD();
       dlog("peer_connection::send_message() enqueueing message of type ${type} for peer ${endpoint}",
-           ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
-      _queued_messages.emplace(queued_message(message_to_send, message_send_time_field_offset));
-      _total_queued_messages_size += message_to_send.size;
+           ("type", message_to_enqueue.msg_type())("endpoint", get_remote_endpoint()));
+      _total_queued_messages_size += message_to_enqueue.size();
+      _queued_messages.emplace(std::move(message_to_enqueue));
       if (_total_queued_messages_size > BTS_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES)
       {
         elog("send queue exceeded maximum size of ${max} bytes (current size ${current} bytes)",
@@ -399,42 +450,4 @@ namespace bts { namespace net
       VERIFY_CORRECT_THREAD();
       return _message_connection.get_shared_secret();
     }
-
-    void peer_connection::clear_old_inventory()
-    {
-      VERIFY_CORRECT_THREAD();
-      fc::time_point_sec oldest_inventory_to_keep(fc::time_point::now() - fc::minutes(BTS_NET_MAX_INVENTORY_SIZE_IN_MINUTES));
-
-      // expire old items from inventory_advertised_to_peer
-      auto oldest_inventory_to_keep_iter = inventory_advertised_to_peer.get<timestamp_index>().lower_bound(oldest_inventory_to_keep);
-      auto begin_iter = inventory_advertised_to_peer.get<timestamp_index>().begin();
-      unsigned number_of_elements_advertised_to_peer_to_discard = std::distance(begin_iter, oldest_inventory_to_keep_iter);
-      inventory_advertised_to_peer.get<timestamp_index>().erase(begin_iter, oldest_inventory_to_keep_iter);
-
-      // also expire items from inventory_peer_advertised_to_us
-      oldest_inventory_to_keep_iter = inventory_peer_advertised_to_us.get<timestamp_index>().lower_bound(oldest_inventory_to_keep);
-      begin_iter = inventory_peer_advertised_to_us.get<timestamp_index>().begin();
-      unsigned number_of_elements_peer_advertised_to_discard = std::distance(begin_iter, oldest_inventory_to_keep_iter);
-      inventory_peer_advertised_to_us.get<timestamp_index>().erase(begin_iter, oldest_inventory_to_keep_iter);
-      dlog("Expiring old inventory for peer ${peer}: removing ${to_peer} items advertised to peer (${remain_to_peer} left), and ${to_us} advertised to us (${remain_to_us} left)",
-           ("peer", get_remote_endpoint())
-           ("to_peer", number_of_elements_advertised_to_peer_to_discard)("remain_to_peer", inventory_advertised_to_peer.size())
-           ("to_us", number_of_elements_peer_advertised_to_discard)("remain_to_us", inventory_peer_advertised_to_us.size()));
-    }
-    // we have a higher limit for blocks than transactions so we will still fetch blocks even when transactions are throttled
-    bool peer_connection::is_inventory_advertised_to_us_list_full_for_transactions() const
-    {
-      VERIFY_CORRECT_THREAD();
-      return inventory_peer_advertised_to_us.size() > BTS_NET_MAX_INVENTORY_SIZE_IN_MINUTES * BTS_BLOCKCHAIN_MAX_TRX_PER_SECOND * 60;
-    }
-    bool peer_connection::is_inventory_advertised_to_us_list_full() const
-    {
-      VERIFY_CORRECT_THREAD();
-      // allow the total inventory size to be the maximum number of transactions we'll store in the inventory (above)
-      // plus the maximum number of blocks that would be generated in BTS_NET_MAX_INVENTORY_SIZE_IN_MINUTES (plus one,
-      // to give us some wiggle room)
-      return inventory_peer_advertised_to_us.size() > 
-        BTS_NET_MAX_INVENTORY_SIZE_IN_MINUTES * BTS_BLOCKCHAIN_MAX_TRX_PER_SECOND * 60 + 
-        (BTS_NET_MAX_INVENTORY_SIZE_IN_MINUTES + 1) * 60 / BTS_BLOCKCHAIN_BLOCK_INTERVAL_SEC;
-    }
 } } // end namespace bts::net
@@ -13,10 +13,15 @@
 
 namespace bts { namespace net {
 
+const size_t stcp_socket::read_buffer_length;
+const size_t stcp_socket::min_write_buffer_length;
+const size_t stcp_socket::max_write_buffer_length;
+
 stcp_socket::stcp_socket()
 //:_buf_len(0)
+   : _write_buffer_length(0)
 #ifndef NDEBUG
-   : _read_buffer_in_use(false),
+   , _read_buffer_in_use(false),
      _write_buffer_in_use(false)
 #endif
 {
@@ -77,7 +82,8 @@ size_t stcp_socket::readsome( char* buffer, size_t len )
     } buffer_in_use_checker(_read_buffer_in_use);
 #endif
 
-    const size_t read_buffer_length = 4096;
+    // a large read buffer lets a burst of data (e.g. a block) be read and decrypted in a few calls
+    // instead of in 4 KB slices with a fiber switch in between
     if (!_read_buffer)
       _read_buffer.reset(new char[read_buffer_length], [](char* p){ delete[] p; });
 
@@ -118,17 +124,14 @@ size_t stcp_socket::writesome( const char* buffer, size_t len )
     } buffer_in_use_checker(_write_buffer_in_use);
 #endif
 
-    const std::size_t write_buffer_length = 4096;
-    if (!_write_buffer)
-      _write_buffer.reset(new char[write_buffer_length], [](char* p){ delete[] p; });
-    len = std::min<size_t>(write_buffer_length, len);
-    memset(_write_buffer.get(), 0, len); // just in case aes.encode screws up
-    /**
-     * every sizeof(crypt_buf) bytes the aes channel
-     * has an error and doesn't decrypt properly...  disable
-     * for now because we are going to upgrade to something
-     * better.
-     */
+    // encrypt the whole write, typically a full message frame, in a single call.  the ciphertext
+    // buffer grows to fit the largest frame written so far, up to max_write_buffer_length
+    len = std::min<size_t>(max_write_buffer_length, len);
+    if (!_write_buffer || _write_buffer_length < len)
+    {
+      _write_buffer_length = std::max<size_t>(len, min_write_buffer_length);
+      _write_buffer.reset(new char[_write_buffer_length], [](char* p){ delete[] p; });
+    }
     uint32_t ciphertext_len = _send_aes.encode( buffer, len, _write_buffer.get() );
     assert(ciphertext_len == len);
     _sock.write( _write_buffer, len );
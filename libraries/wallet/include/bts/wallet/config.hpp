@@ -10,3 +10,5 @@
 #define BTS_WALLET_DEFAULT_TRANSACTION_FEE              50000 // XTS
 
 #define BTS_WALLET_DEFAULT_TRANSACTION_EXPIRATION_SEC   3600
+
+#define BTS_WALLET_SCAN_CHUNK_BLOCKS                    100 // blocks read, matched against the wallet keys and committed together when scanning
@@ -50,6 +50,14 @@ struct pretty_transaction
     optional<fc::exception>     error;
 };
 
+struct pretty_transaction_page
+{
+    vector<pretty_transaction>    transactions;
+    /** Where the next page starts, unset on the last page */
+    optional<uint32_t>            next_block_num;
+    optional<transaction_id_type> next_record_id;
+};
+
 }} // bts::wallet
 
 FC_REFLECT( bts::wallet::public_key_summary, (hex)(native_pubkey)(native_address)(pts_normal_address)(pts_compressed_address)(btc_normal_address)(btc_compressed_address) );
@@ -77,3 +85,9 @@ FC_REFLECT( bts::wallet::pretty_transaction,
             (expiration_timestamp)
             (error)
             );
+
+FC_REFLECT( bts::wallet::pretty_transaction_page,
+            (transactions)
+            (next_block_num)
+            (next_record_id)
+            );
@@ -555,6 +555,15 @@ namespace bts { namespace wallet {
                                                                             uint32_t start_block_num = 0,
                                                                             uint32_t end_block_num = -1,
                                                                             const string& asset_symbol = "" )const;
+         /**
+          *  Lists up to limit transactions starting at the given block and record id, without running balances.
+          *  Pending transactions are listed at block 0 and move to their block when they are confirmed.
+          */
+         pretty_transaction_page            get_pretty_transaction_history_page( const string& account_name,
+                                                                                 const string& asset_symbol,
+                                                                                 uint32_t start_block_num,
+                                                                                 const string& start_record_id,
+                                                                                 uint32_t limit )const;
 
          void                               remove_transaction_record( const string& record_id );
 
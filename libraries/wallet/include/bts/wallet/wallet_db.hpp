@@ -2,10 +2,15 @@
 
 #include <bts/wallet/wallet_records.hpp>
 
+#include <unordered_set>
+
 namespace bts { namespace wallet {
 
    namespace detail { class wallet_db_impl; }
 
+   /** Position in the transaction history: ( block_num, record_id ) */
+   typedef std::pair<uint32_t, transaction_id_type> transaction_history_cursor;
+
    class wallet_db
    {
       public:
@@ -61,6 +66,17 @@ namespace bts { namespace wallet {
 
          map<private_key_type, string> get_account_private_keys( const fc::sha512& password )const;
 
+         /**
+          *  Decrypted private keys are cached by key address while the wallet is unlocked, so signing and
+          *  scanning don't repeat the AES decryption and key unpacking.  cache_private_keys() starts caching
+          *  and decrypts the account keys up front; other keys are added on first use.
+          */
+         private_key_type       get_private_key( const wallet_key_record& key_record, const fc::sha512& password )const;
+         private_key_type       get_private_key( const public_key_type& public_key, const fc::sha512& password )const;
+         void                   cache_private_keys( const fc::sha512& password );
+         /** Stops caching and wipes every cached key */
+         void                   clear_private_key_cache();
+
          // Restore as many broken record invariants as possible
          void                   repair_records( const fc::sha512& password );
          // ********************************************************************
@@ -71,10 +87,34 @@ namespace bts { namespace wallet {
                           const fc::sha512& password );
 
          void remove_balance( const balance_id_type& balance_id );
+
+         /**
+          *  Ids of the chain balances owned by this wallet's keys, split into those with funds and those emptied
+          *  on the chain.  Together they are only complete once a full chain scan has been recorded with
+          *  set_owned_balance_ids_complete( true ).
+          */
+         const std::unordered_set<balance_id_type>& get_owned_balance_ids()const { return owned_balance_ids; }
+         const std::unordered_set<balance_id_type>& get_emptied_balance_ids()const { return emptied_balance_ids; }
+         void add_owned_balance_id( const balance_id_type& balance_id );
+         void set_owned_balance_emptied( const balance_id_type& balance_id );
+         void remove_owned_balance_id( const balance_id_type& balance_id );
+         bool owned_balance_ids_complete()const { return owned_balance_ids_are_complete; }
+         void set_owned_balance_ids_complete( bool complete ) { owned_balance_ids_are_complete = complete; }
          void remove_transaction( const transaction_id_type& record_id );
 
          vector<wallet_transaction_record> get_pending_transactions()const;
 
+         /**
+          *  Returns up to limit transactions at or after start and no later than end_block_num, in history order,
+          *  optionally only those involving an account (by account address) and/or an asset.  Only the returned
+          *  page of the matching index is walked, unless filtering by both account and asset.
+          */
+         vector<wallet_transaction_record> get_transaction_history( const optional<address>& account_address,
+                                                                    const optional<asset_id_type>& asset_id,
+                                                                    const transaction_history_cursor& start,
+                                                                    uint32_t end_block_num = -1,
+                                                                    uint32_t limit = -1 )const;
+
          string                        get_account_name( const address& account_address )const;
 
          vector<wallet_balance_record>  get_all_balances( const string& account_name, uint32_t limit );
@@ -127,6 +167,9 @@ namespace bts { namespace wallet {
          unordered_map<address, wallet_key_record>                      keys;
          unordered_map<transaction_id_type, wallet_transaction_record>  transactions;
          unordered_map<balance_id_type,wallet_balance_record>           balances;
+         std::unordered_set<balance_id_type>                            owned_balance_ids;
+         std::unordered_set<balance_id_type>                            emptied_balance_ids;
+         bool                                                           owned_balance_ids_are_complete = false;
          map<property_enum, wallet_property_record>                     properties;
          map<string, wallet_setting_record>                             settings;
 
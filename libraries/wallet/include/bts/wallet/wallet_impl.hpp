@@ -27,6 +27,22 @@ class wallet_impl : public chain_observer
        vector<std::unique_ptr<fc::thread>>        _scanner_threads;
        float                                      _scan_progress = 0;
 
+       /** the wallet key that decrypted a TITAN memo and what it decrypted to, unset if none of them could */
+       typedef optional<pair<private_key_type, memo_status>> omemo_match;
+       /** TITAN memos in the blocks being scanned, already tried against every wallet key, by owner address */
+       map<address, omemo_match>                  _prescanned_memos;
+
+       /**
+        *  A run of consecutive blocks being rescanned.  The blocks are read on the wallet's thread and their memos
+        *  are decrypted on the scanner threads while the previous chunk is being committed to the wallet.
+        */
+       struct scan_chunk
+       {
+           uint32_t                                 first_block_num = 0;
+           std::shared_ptr<const vector<full_block>> blocks;
+           fc::future<map<address, omemo_match>>    prescanned_memos;
+       };
+
        struct login_record
        {
            private_key_type key;
@@ -75,6 +91,18 @@ class wallet_impl : public chain_observer
       void scan_state();
 
       void scan_block( uint32_t block_num, const vector<private_key_type>& keys, const time_point_sec& received_time );
+      void scan_block( uint32_t block_num, const full_block& block, const vector<private_key_type>& keys,
+                       const time_point_sec& received_time );
+
+      vector<omemo_match> decrypt_memos( const vector<withdraw_with_signature>& memos,
+                                         const vector<private_key_type>& keys,
+                                         const vector<fc::ecc::public_key>& public_keys );
+      map<address, omemo_match> prescan_memos( const vector<full_block>& blocks,
+                                               const vector<private_key_type>& keys,
+                                               const vector<fc::ecc::public_key>& public_keys );
+      std::unique_ptr<scan_chunk> start_scan_chunk( uint32_t first_block_num, uint32_t last_block_num,
+                                                    const vector<private_key_type>& keys,
+                                                    const vector<fc::ecc::public_key>& public_keys );
 
       wallet_transaction_record scan_transaction(
               const signed_transaction& transaction,
@@ -135,8 +163,11 @@ class wallet_impl : public chain_observer
 
       void sync_balance_with_blockchain( const balance_id_type& balance_id, const obalance_record& record );
       void sync_balance_with_blockchain( const balance_id_type& balance_id );
+      void track_owned_balance( const balance_record& record );
+      void scan_owned_balances();
 
       vector<wallet_transaction_record> get_pending_transactions()const;
+      optional<asset_id_type> get_history_asset_id( const string& asset_symbol )const;
 
       void scan_balances();
       void scan_registered_accounts();
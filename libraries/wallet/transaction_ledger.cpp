@@ -288,7 +288,12 @@ void wallet_impl::scan_registered_accounts()
 
 void wallet_impl::scan_block( uint32_t block_num, const vector<private_key_type>& keys, const time_point_sec& received_time )
 {
-   const auto block = _blockchain->get_block( block_num );
+   scan_block( block_num, _blockchain->get_block( block_num ), keys, received_time );
+}
+
+void wallet_impl::scan_block( uint32_t block_num, const full_block& block, const vector<private_key_type>& keys,
+                              const time_point_sec& received_time )
+{
    for( const auto& transaction : block.user_transactions )
       scan_transaction( transaction, block_num, block.timestamp, keys, received_time );
 
@@ -1091,7 +1096,105 @@ bool wallet_impl::scan_burn( const burn_operation& op, wallet_transaction_record
     return false;
 }
 
-// TODO: optimize
+/**
+ *  Tries every key against every memo on the scanner threads.  The (memo, key) pairs are split into one
+ *  contiguous run per thread, so there is a single task per thread however many memos and keys there are.
+ *  Almost every pair fails the owner address check in decrypt_memo_data() before any AES work is done.
+ *  The threads share the inputs and their matches with this call, so a canceled rescan cannot free them
+ *  while the threads are still running.
+ */
+vector<wallet_impl::omemo_match> wallet_impl::decrypt_memos( const vector<withdraw_with_signature>& memos,
+                                                             const vector<private_key_type>& keys,
+                                                             const vector<fc::ecc::public_key>& public_keys )
+{
+   FC_ASSERT( keys.size() == public_keys.size() );
+   vector<omemo_match> matches( memos.size() );
+   const size_t num_pairs = memos.size() * keys.size();
+   if( num_pairs == 0 )
+      return matches;
+
+   const auto shared_memos = std::make_shared<const vector<withdraw_with_signature>>( memos );
+   const auto shared_keys = std::make_shared<const vector<private_key_type>>( keys );
+   const auto shared_public_keys = std::make_shared<const vector<fc::ecc::public_key>>( public_keys );
+
+   // each thread keeps its own matches so that no two threads write to the same place
+   const size_t num_threads = std::min<size_t>( _scanner_threads.size(), num_pairs );
+   const auto thread_matches = std::make_shared<vector<vector<pair<size_t, pair<private_key_type, memo_status>>>>>( num_threads );
+
+   vector<fc::future<void>> scan_progress;
+   scan_progress.reserve( num_threads );
+   for( size_t t = 0; t < num_threads; ++t )
+   {
+      const size_t first_pair = num_pairs * t / num_threads;
+      const size_t last_pair = num_pairs * (t + 1) / num_threads;
+      scan_progress.push_back( _scanner_threads[ t ]->async( [=]()
+      {
+         const vector<withdraw_with_signature>& memos = *shared_memos;
+         const vector<private_key_type>& keys = *shared_keys;
+         const vector<fc::ecc::public_key>& public_keys = *shared_public_keys;
+         for( size_t i = first_pair; i < last_pair; ++i )
+         {
+            const size_t memo_index = i / keys.size();
+            const size_t key_index = i % keys.size();
+            try
+            {
+               const omemo_status status = memos[ memo_index ].decrypt_memo_data( keys[ key_index ], public_keys[ key_index ] );
+               if( status.valid() )
+                  (*thread_matches)[ t ].emplace_back( memo_index, std::make_pair( keys[ key_index ], *status ) );
+            }
+            catch( const fc::exception& e )
+            {
+               elog( "unexpected exception ${e}", ("e",e.to_detail_string()) );
+            }
+         }
+      }, "decrypt memos" ) );
+   }
+
+   for( auto& progress : scan_progress )
+      progress.wait();
+
+   for( const auto& matches_from_thread : *thread_matches )
+      for( const auto& match : matches_from_thread )
+         if( !matches[ match.first ].valid() )
+            matches[ match.first ] = match.second;
+
+   return matches;
+}
+
+/**
+ *  Collects the TITAN memos of a run of blocks and tries them all against the wallet keys at once, so
+ *  scan_deposit() only has to look up the result once they are stored in _prescanned_memos.
+ */
+map<address, wallet_impl::omemo_match> wallet_impl::prescan_memos( const vector<full_block>& blocks,
+                                                                   const vector<private_key_type>& keys,
+                                                                   const vector<fc::ecc::public_key>& public_keys )
+{
+   vector<withdraw_with_signature> memos;
+   for( const auto& block : blocks )
+   {
+      for( const auto& transaction : block.user_transactions )
+      {
+         for( const auto& op : transaction.operations )
+         {
+            if( operation_type_enum( op.type ) != deposit_op_type )
+               continue;
+            const auto deposit = op.as<deposit_operation>();
+            if( withdraw_condition_types( deposit.condition.type ) != withdraw_signature_type )
+               continue;
+            auto condition = deposit.condition.as<withdraw_with_signature>();
+            if( condition.memo )
+               memos.push_back( std::move( condition ) );
+         }
+      }
+   }
+
+   const vector<omemo_match> matches = decrypt_memos( memos, keys, public_keys );
+   map<address, omemo_match> prescanned_memos;
+   for( size_t i = 0; i < memos.size(); ++i )
+      prescanned_memos[ memos[ i ].owner ] = matches[ i ];
+   return prescanned_memos;
+}
+
 bool wallet_impl::scan_deposit( const deposit_operation& op, const vector<private_key_type>& keys,
                                 wallet_transaction_record& trx_rec, asset& total_fee )
 { try {
@@ -1114,89 +1217,85 @@ bool wallet_impl::scan_deposit( const deposit_operation& op, const vector<privat
           // if( _wallet_db.has_private_key( deposit.owner ) )
           if( deposit.memo ) /* titan transfer */
           {
-             vector< fc::future<void> > scan_key_progress;
-             scan_key_progress.resize( keys.size() );
-             for( uint32_t i = 0; i < keys.size(); ++i )
+             // memos of blocks being scanned in bulk have already been tried, see prescan_memos()
+             omemo_match match;
+             const auto prescanned_memo = _prescanned_memos.find( deposit.owner );
+             if( prescanned_memo != _prescanned_memos.end() )
              {
-                const auto& key = keys[i];
-                scan_key_progress[i] = fc::async([&,i](){
-                   omemo_status status;
-                   _scanner_threads[ i % _num_scanner_threads ]->async( [&]()
-                       { status =  deposit.decrypt_memo_data( key ); }, "decrypt memo" ).wait();
-                   if( status.valid() ) /* If I've successfully decrypted then it's for me */
-                   {
-                      cache_deposit = true;
-                      _wallet_db.cache_memo( *status, key, _wallet_password );
-
-                      auto new_entry = true;
-                      if( status->memo_flags == from_memo )
-                      {
-                         for( auto& entry : trx_rec.ledger_entries )
-                         {
-                             if( !entry.from_account.valid() ) continue;
-                             if( !entry.memo_from_account.valid() )
-                             {
-                                 const auto a1 = self->get_key_label( *entry.from_account );
-                                 const auto a2 = self->get_key_label( status->from );
-                                 if( a1 != a2 ) continue;
-                             }
-
-                             new_entry = false;
-                             if( !entry.memo_from_account.valid() )
-                                 entry.from_account = status->from;
-                             entry.to_account = key.get_public_key();
-                             entry.amount = amount;
-                             entry.memo = status->get_message();
-                             break;
-                         }
-                         if( new_entry )
-                         {
-                             auto entry = ledger_entry();
-                             entry.from_account = status->from;
-                             entry.to_account = key.get_public_key();
-                             entry.amount = amount;
-                             entry.memo = status->get_message();
-                             trx_rec.ledger_entries.push_back( entry );
-                         }
-                      }
-                      else // to_memo
-                      {
-                         for( auto& entry : trx_rec.ledger_entries )
-                         {
-                             if( !entry.from_account.valid() ) continue;
-                             const auto a1 = self->get_key_label( *entry.from_account );
-                             const auto a2 = self->get_key_label( key.get_public_key() );
-                             if( a1 != a2 ) continue;
-
-                             new_entry = false;
-                             entry.from_account = key.get_public_key();
-                             entry.to_account = status->from;
-                             entry.amount = amount;
-                             entry.memo = status->get_message();
-                             break;
-                         }
-                         if( new_entry )
-                         {
-                             auto entry = ledger_entry();
-                             entry.from_account = key.get_public_key();
-                             entry.to_account = status->from;
-                             entry.amount = amount;
-                             entry.memo = status->get_message();
-                             trx_rec.ledger_entries.push_back( entry );
-                         }
-                      }
-                   }
-               });
-             } // for each key
+                match = prescanned_memo->second;
+             }
+             else
+             {
+                vector<fc::ecc::public_key> public_keys;
+                public_keys.reserve( keys.size() );
+                for( const auto& key : keys )
+                   public_keys.push_back( key.get_public_key() );
+                match = decrypt_memos( vector<withdraw_with_signature>{ deposit }, keys, public_keys ).front();
+             }
 
-             for( auto& fut : scan_key_progress )
+             if( match.valid() ) /* If one of my keys decrypted it then it's for me */
              {
-                try {
-                   fut.wait();
+                const private_key_type& key = match->first;
+                const omemo_status status = match->second;
+                cache_deposit = true;
+                _wallet_db.cache_memo( *status, key, _wallet_password );
+
+                auto new_entry = true;
+                if( status->memo_flags == from_memo )
+                {
+                   for( auto& entry : trx_rec.ledger_entries )
+                   {
+                       if( !entry.from_account.valid() ) continue;
+                       if( !entry.memo_from_account.valid() )
+                       {
+                           const auto a1 = self->get_key_label( *entry.from_account );
+                           const auto a2 = self->get_key_label( status->from );
+                           if( a1 != a2 ) continue;
+                       }
+
+                       new_entry = false;
+                       if( !entry.memo_from_account.valid() )
+                           entry.from_account = status->from;
+                       entry.to_account = key.get_public_key();
+                       entry.amount = amount;
+                       entry.memo = status->get_message();
+                       break;
+                   }
+                   if( new_entry )
+                   {
+                       auto entry = ledger_entry();
+                       entry.from_account = status->from;
+                       entry.to_account = key.get_public_key();
+                       entry.amount = amount;
+                       entry.memo = status->get_message();
+                       trx_rec.ledger_entries.push_back( entry );
+                   }
                 }
-                catch ( const fc::exception& e )
+                else // to_memo
                 {
-                   elog( "unexpected exception ${e}", ("e",e.to_detail_string()) );
+                   for( auto& entry : trx_rec.ledger_entries )
+                   {
+                       if( !entry.from_account.valid() ) continue;
+                       const auto a1 = self->get_key_label( *entry.from_account );
+                       const auto a2 = self->get_key_label( key.get_public_key() );
+                       if( a1 != a2 ) continue;
+
+                       new_entry = false;
+                       entry.from_account = key.get_public_key();
+                       entry.to_account = status->from;
+                       entry.amount = amount;
+                       entry.memo = status->get_message();
+                       break;
+                   }
+                   if( new_entry )
+                   {
+                       auto entry = ledger_entry();
+                       entry.from_account = key.get_public_key();
+                       entry.to_account = status->from;
+                       entry.amount = amount;
+                       entry.memo = status->get_message();
+                       trx_rec.ledger_entries.push_back( entry );
+                   }
                 }
              }
              break;
@@ -1327,6 +1426,24 @@ void wallet_impl::cache_transaction( const signed_transaction& transaction, wall
    }
 } FC_CAPTURE_AND_RETHROW() }
 
+/**
+ * @return the asset the transaction history should be filtered by, none for all assets
+ */
+optional<asset_id_type> wallet_impl::get_history_asset_id( const string& asset_symbol )const
+{
+   if( asset_symbol.empty() || asset_symbol == BTS_BLOCKCHAIN_SYMBOL )
+       return optional<asset_id_type>();
+
+   try
+   {
+       return _blockchain->get_asset_id( asset_symbol );
+   }
+   catch( const fc::exception& )
+   {
+       FC_THROW_EXCEPTION( invalid_asset_symbol, "Invalid asset symbol!", ("asset_symbol",asset_symbol) );
+   }
+}
+
 /**
  * @return the list of all transactions related to this wallet
  */
@@ -1338,65 +1455,83 @@ vector<wallet_transaction_record> wallet::get_transaction_history( const string&
    FC_ASSERT( is_open() );
    if( end_block_num != -1 ) FC_ASSERT( start_block_num <= end_block_num );
 
-   vector<wallet_transaction_record> history_records;
-   const auto& transactions = my->_wallet_db.get_transactions();
-
-   auto asset_id = 0;
-   if( !asset_symbol.empty() && asset_symbol != BTS_BLOCKCHAIN_SYMBOL )
+   optional<address> account_address;
+   if( !account_name.empty() )
    {
-       try
-       {
-           asset_id = my->_blockchain->get_asset_id( asset_symbol );
-       }
-       catch( const fc::exception& )
-       {
-           FC_THROW_EXCEPTION( invalid_asset_symbol, "Invalid asset symbol!", ("asset_symbol",asset_symbol) );
-       }
+       const auto account_record = my->_wallet_db.lookup_account( account_name );
+       if( !account_record.valid() ) return vector<wallet_transaction_record>();
+       account_address = account_record->owner_address();
    }
 
-   for( const auto& item : transactions )
+   return my->_wallet_db.get_transaction_history( account_address, my->get_history_asset_id( asset_symbol ),
+                                                  transaction_history_cursor( start_block_num, transaction_id_type() ),
+                                                  end_block_num );
+} FC_CAPTURE_AND_RETHROW() }
+
+pretty_transaction_page wallet::get_pretty_transaction_history_page( const string& account_name,
+                                                                     const string& asset_symbol,
+                                                                     uint32_t start_block_num,
+                                                                     const string& start_record_id,
+                                                                     uint32_t limit )const
+{ try {
+   FC_ASSERT( is_open() );
+   FC_ASSERT( limit > 0 );
+   limit = std::min<uint32_t>( limit, uint32_t( -1 ) - 1 );
+
+   optional<address> account_address;
+   if( !account_name.empty() )
+       account_address = get_account( account_name ).owner_address();
+
+   transaction_history_cursor start( start_block_num, transaction_id_type() );
+   if( !start_record_id.empty() )
+       start.second = variant( start_record_id ).as<transaction_id_type>();
+
+   // fetch one extra record to find where the next page starts
+   auto history = my->_wallet_db.get_transaction_history( account_address, my->get_history_asset_id( asset_symbol ),
+                                                          start, -1, limit + 1 );
+   pretty_transaction_page page;
+   if( history.size() > limit )
    {
-       const auto& tx_record = item.second;
+       page.next_block_num = history.back().block_num;
+       page.next_record_id = history.back().record_id;
+       history.pop_back();
+   }
 
-       if( tx_record.block_num < start_block_num ) continue;
-       if( end_block_num != -1 && tx_record.block_num > end_block_num ) continue;
-       if( tx_record.ledger_entries.empty() ) continue; /* TODO: Temporary */
+   const auto relay_fee = my->_blockchain->get_relay_fee();
+   page.transactions.reserve( history.size() );
+   for( const auto& record : history )
+   {
+       pretty_transaction trx = to_pretty_trx( record );
 
-       if( !account_name.empty() )
+       if( !trx.is_virtual && !trx.is_confirmed )
        {
-           bool match = false;
-           for( const auto& entry : tx_record.ledger_entries )
+           const auto trx_rec = my->_blockchain->get_transaction( trx.trx_id );
+           if( trx_rec.valid() )
            {
-               if( entry.from_account.valid() )
-               {
-                   const auto account_record = get_account_for_address( *entry.from_account );
-                   if( account_record.valid() ) match |= account_record->name == account_name;
-                   if( match ) break;
-               }
-               if( entry.to_account.valid() )
-               {
-                   const auto account_record = get_account_for_address( *entry.to_account );
-                   if( account_record.valid() ) match |= account_record->name == account_name;
-                   if( match ) break;
-               }
+               trx.block_num = trx_rec->chain_location.block_num;
+               trx.is_confirmed = true;
+           }
+           else
+           {
+               trx.error = my->_blockchain->get_transaction_error( record.trx, relay_fee );
            }
-           if( !match ) continue;
        }
 
-       if( asset_id != 0 )
+       /* Don't return fees we didn't pay */
+       if( !account_name.empty() )
        {
-           bool match = false;
-           for( const auto& entry : tx_record.ledger_entries )
-               match |= entry.amount.amount > 0 && entry.amount.asset_id == asset_id;
-           match |= tx_record.fee.amount > 0 && tx_record.fee.asset_id == asset_id;
-           if( !match ) continue;
+           auto any_from_me = false;
+           for( const auto& entry : trx.ledger_entries )
+               any_from_me |= entry.from_account == account_name || entry.from_account.find( account_name + " " ) == 0;
+           if( trx.is_virtual || ( !any_from_me && !trx.is_market_cancel ) )
+               trx.fee = asset();
        }
 
-       history_records.push_back( tx_record );
+       page.transactions.push_back( std::move( trx ) );
    }
 
-   return history_records;
-} FC_CAPTURE_AND_RETHROW() }
+   return page;
+} FC_CAPTURE_AND_RETHROW( (account_name)(asset_symbol)(start_block_num)(start_record_id)(limit) ) }
 
 vector<pretty_transaction> wallet::get_pretty_transaction_history( const string& account_name,
                                                                    uint32_t start_block_num,
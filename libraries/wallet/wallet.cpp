@@ -41,7 +41,16 @@ namespace detail {
 
    void wallet_impl::block_applied( const block_summary& summary )
    {
-       if( !self->is_open() || !self->is_unlocked() ) return;
+       if( !self->is_open() ) return;
+
+       // keep the owned balance ids current even when the block isn't scanned for transactions
+       if( summary.applied_changes )
+       {
+           for( const auto& item : summary.applied_changes->balances )
+               track_owned_balance( item.second );
+       }
+
+       if( !self->is_unlocked() ) return;
        if( !self->get_transaction_scanning() ) return;
        if( summary.block_data.block_num <= self->get_last_scanned_block_number() ) return;
        if( _scan_in_progress.valid() && !_scan_in_progress.ready() ) return;
@@ -152,6 +161,10 @@ namespace detail {
 
    void wallet_impl::sync_balance_with_blockchain( const balance_id_type& balance_id, const obalance_record& record )
    {
+      // only the chain decides a balance is emptied, a pending spend may still be dropped
+      if( record.valid() && record->balance != 0 )
+          track_owned_balance( *record );
+
       if( !record.valid() || record->balance == 0 )
           _wallet_db.remove_balance( balance_id );
       else
@@ -165,6 +178,25 @@ namespace detail {
       sync_balance_with_blockchain( balance_id, record );
    }
 
+   void wallet_impl::track_owned_balance( const balance_record& record )
+   {
+      const auto key_record = _wallet_db.lookup_key( record.owner() );
+      if( !key_record.valid() || !key_record->has_private_key() ) return;
+
+      if( record.balance == 0 )
+          _wallet_db.set_owned_balance_emptied( record.id() );
+      else
+          _wallet_db.add_owned_balance_id( record.id() );
+   }
+
+   /** Finds every balance on the chain owned by the wallet's keys; needed once after opening or importing keys */
+   void wallet_impl::scan_owned_balances()
+   {
+      if( _wallet_db.owned_balance_ids_complete() ) return;
+      _blockchain->scan_balances( [&]( const balance_record& record ) { track_owned_balance( record ); } );
+      _wallet_db.set_owned_balance_ids_complete( true );
+   }
+
    void wallet_impl::reschedule_relocker()
    {
      if( !_relocker_done.valid() || _relocker_done.ready() )
@@ -198,6 +230,26 @@ namespace detail {
        }
    }
 
+   /**
+    *  Reads the blocks in [first_block_num, last_block_num] and starts decrypting their memos on the scanner
+    *  threads.  The decryption task owns copies of everything it uses, so the chunk may be dropped at any time.
+    */
+   std::unique_ptr<wallet_impl::scan_chunk> wallet_impl::start_scan_chunk( uint32_t first_block_num, uint32_t last_block_num,
+                                                                           const vector<private_key_type>& keys,
+                                                                           const vector<fc::ecc::public_key>& public_keys )
+   {
+      std::shared_ptr<vector<full_block>> blocks = std::make_shared<vector<full_block>>();
+      blocks->reserve( last_block_num - first_block_num + 1 );
+      for( auto block_num = first_block_num; block_num <= last_block_num; ++block_num )
+          blocks->push_back( _blockchain->get_block( block_num ) );
+
+      std::unique_ptr<scan_chunk> chunk( new scan_chunk );
+      chunk->first_block_num = first_block_num;
+      chunk->blocks = blocks;
+      chunk->prescanned_memos = fc::async( [=]() { return prescan_memos( *blocks, keys, public_keys ); }, "prescan_memos" );
+      return chunk;
+   }
+
    void wallet_impl::scan_chain_task( uint32_t start, uint32_t end, bool fast_scan )
    {
       auto min_end = std::min<size_t>( _blockchain->get_head_block_num(), end );
@@ -214,6 +266,12 @@ namespace detail {
         for( const auto& item : account_keys )
             private_keys.push_back( item.first );
 
+        // every TITAN memo is tried against every key, so only compute the public keys once
+        vector<fc::ecc::public_key> public_keys;
+        public_keys.reserve( private_keys.size() );
+        for( const auto& key : private_keys )
+            public_keys.push_back( key.get_public_key() );
+
          // Collect balances
         map<address, string> account_balances;
         const account_balance_id_summary_type balance_id_summary = self->get_account_balance_ids();
@@ -233,29 +291,61 @@ namespace detail {
         if( min_end > start + 1 )
             ulog( "Beginning scan at block ${n}...", ("n",start) );
 
-        for( auto block_num = start; !_scan_in_progress.canceled() && block_num <= min_end; ++block_num )
+        // The range is scanned in chunks of BTS_WALLET_SCAN_CHUNK_BLOCKS.  While one chunk is committed to the
+        // wallet in block order, the next one's memos are already being decrypted on the scanner threads.
+        // The last scanned block only advances past blocks that have been committed, so a cancelled scan
+        // resumes from exactly where it stopped.
+        const auto chunk_end = [&]( uint32_t first_block_num ) -> uint32_t
         {
-           scan_block( block_num, private_keys, now );
-#ifdef BTS_TEST_NETWORK
-           try
-           {
-               scan_block_experimental( block_num, account_keys, account_balances, account_names );
-           }
-           catch( ... )
+            return uint32_t( std::min<uint64_t>( uint64_t( first_block_num ) + BTS_WALLET_SCAN_CHUNK_BLOCKS - 1, min_end ) );
+        };
+
+        std::unique_ptr<scan_chunk> chunk;
+        if( start <= min_end )
+            chunk = start_scan_chunk( start, chunk_end( start ), private_keys, public_keys );
+
+        while( chunk && !_scan_in_progress.canceled() )
+        {
+           const uint32_t next_chunk_start = chunk->first_block_num + uint32_t( chunk->blocks->size() );
+           std::unique_ptr<scan_chunk> next_chunk;
+           if( next_chunk_start <= min_end )
+               next_chunk = start_scan_chunk( next_chunk_start, chunk_end( next_chunk_start ), private_keys, public_keys );
+
+           _prescanned_memos = chunk->prescanned_memos.wait();
+
+           for( uint32_t i = 0; i < chunk->blocks->size() && !_scan_in_progress.canceled(); ++i )
            {
-           }
+              const uint32_t block_num = chunk->first_block_num + i;
+              scan_block( block_num, (*chunk->blocks)[ i ], private_keys, now );
+#ifdef BTS_TEST_NETWORK
+              try
+              {
+                  scan_block_experimental( block_num, account_keys, account_balances, account_names );
+              }
+              catch( ... )
+              {
+              }
 #endif
-           _scan_progress = float(block_num-start)/(min_end-start+1);
-           self->set_last_scanned_block_number( block_num );
+              _scan_progress = float(block_num-start)/(min_end-start+1);
+              self->set_last_scanned_block_number( block_num );
 
-           if( block_num > start )
-           {
-               if( (block_num - start) % 10000 == 0 )
-                   ulog( "Scanning ${p} done...", ("p",cli::pretty_percent( _scan_progress, 1 )) );
+              if( block_num > start )
+              {
+                  if( (block_num - start) % 10000 == 0 )
+                      ulog( "Scanning ${p} done...", ("p",cli::pretty_percent( _scan_progress, 1 )) );
 
-               if( !fast_scan && (block_num - start) % 100 == 0 )
-                   fc::usleep( fc::microseconds( 100 ) );
+                  if( !fast_scan && (block_num - start) % 100 == 0 )
+                      fc::usleep( fc::microseconds( 100 ) );
+              }
            }
+
+           chunk = std::move( next_chunk );
+        }
+
+        // don't leave a read-ahead decryption running on the scanner threads after a cancelled scan
+        if( chunk )
+        {
+            try { chunk->prescanned_memos.wait(); } catch( ... ) {}
         }
 
         // Update local accounts
@@ -269,12 +359,15 @@ namespace detail {
             }
         }
 
+        _prescanned_memos.clear();
+
         _scan_progress = 1;
         if( min_end > start + 1 )
             ulog( "Scan completed." );
       }
       catch(...)
       {
+        _prescanned_memos.clear();
         _scan_progress = -1;
         ulog( "Scan failure." );
         throw;
@@ -1024,6 +1117,7 @@ namespace detail {
               FC_THROW_EXCEPTION( invalid_password, "Invalid password!" );
 
           my->upgrade_version_unlocked();
+          my->_wallet_db.cache_private_keys( my->_wallet_password );
 
           my->_scheduled_lock_time = new_lock_time;
           ilog( "Wallet unlocked at time: ${t}", ("t", fc::time_point_sec(now)) );
@@ -1063,6 +1157,7 @@ namespace detail {
         wlog("Unexpected exception from wallet's login_map_cleaner()");
       }
       my->_wallet_password     = fc::sha512();
+      my->_wallet_db.clear_private_key_cache();
       my->_scheduled_lock_time = fc::optional<fc::time_point>();
       wallet_lock_state_changed( true );
       ilog( "Wallet locked at time: ${t}", ("t",blockchain::now()) );
@@ -1506,7 +1601,7 @@ namespace detail {
       auto key = my->_wallet_db.lookup_key( addr );
       FC_ASSERT( key.valid() );
       FC_ASSERT( key->has_private_key() );
-      return key->decrypt_private_key( my->_wallet_password );
+      return my->_wallet_db.get_private_key( *key, my->_wallet_password );
    } FC_CAPTURE_AND_RETHROW( (addr) ) }
 
    public_key_type  wallet::get_public_key( const address& addr) const
@@ -2576,7 +2671,7 @@ namespace detail {
 
        owallet_key_record delegate_key = my->_wallet_db.lookup_key( delegate_account_record->active_key() );
        FC_ASSERT( delegate_key && delegate_key->has_private_key() );
-       const auto delegate_private_key = delegate_key->decrypt_private_key( my->_wallet_password );
+       const auto delegate_private_key = my->_wallet_db.get_private_key( *delegate_key, my->_wallet_password );
        required_signatures.insert( delegate_private_key.get_public_key() );
 
        const auto delegate_public_key = delegate_private_key.get_public_key();
@@ -3244,7 +3339,7 @@ namespace detail {
       FC_ASSERT( issuer.valid() );
       owallet_key_record  issuer_key = my->_wallet_db.lookup_key( issuer->owner_address() );
       FC_ASSERT( issuer_key && issuer_key->has_private_key() );
-      auto sender_private_key = issuer_key->decrypt_private_key( my->_wallet_password );
+      auto sender_private_key = my->_wallet_db.get_private_key( *issuer_key, my->_wallet_password );
 
       trx.deposit_to_account( receiver_public_key,
                               shares_to_issue,
@@ -4038,7 +4133,7 @@ namespace detail {
                 ("name",account_name) );
 
       FC_ASSERT( opt_key->has_private_key() );
-      return opt_key->decrypt_private_key( my->_wallet_password );
+      return my->_wallet_db.get_private_key( *opt_key, my->_wallet_password );
    } FC_CAPTURE_AND_RETHROW( (account_name) ) }
 
    /**
@@ -4212,27 +4307,63 @@ namespace detail {
       map<string, vector<balance_record>> balance_records;
       const auto pending_state = my->_blockchain->get_pending_state();
 
-      const auto scan_balance = [&]( const balance_record& record )
+      my->scan_owned_balances();
+
+      // in chain order, which re-caching below can't disturb
+      const auto& owned_balance_ids = my->_wallet_db.get_owned_balance_ids();
+      const auto& emptied_balance_ids = my->_wallet_db.get_emptied_balance_ids();
+      vector<balance_id_type> balance_ids( owned_balance_ids.begin(), owned_balance_ids.end() );
+      if( include_empty )
+      {
+          balance_ids.insert( balance_ids.end(), emptied_balance_ids.begin(), emptied_balance_ids.end() );
+      }
+      else
+      {
+          /* Emptied balances can only have funds again through a pending deposit */
+          for( const auto& item : pending_state->balances )
+          {
+              if( emptied_balance_ids.count( item.first ) )
+                  balance_ids.push_back( item.first );
+          }
+      }
+      std::sort( balance_ids.begin(), balance_ids.end() );
+
+      for( const auto& balance_id : balance_ids )
       {
-          const auto key_record = my->_wallet_db.lookup_key( record.owner() );
-          if( !key_record.valid() || !key_record->has_private_key() ) return;
+          /* Only balances already on the chain, with their pending changes */
+          const auto chain_record = my->_blockchain->get_balance_record( balance_id );
+          if( !chain_record.valid() )
+          {
+              my->_wallet_db.remove_owned_balance_id( balance_id );
+              continue;
+          }
+          const auto pending_itr = pending_state->balances.find( balance_id );
+          const obalance_record pending_record = pending_itr != pending_state->balances.end() ? pending_itr->second
+                                                                                                : *chain_record;
+
+          const auto key_record = my->_wallet_db.lookup_key( pending_record->owner() );
+          if( !key_record.valid() || !key_record->has_private_key() )
+          {
+              my->_wallet_db.remove_owned_balance_id( balance_id );
+              continue;
+          }
+
+          if( chain_record->balance == 0 )
+              my->_wallet_db.set_owned_balance_emptied( balance_id );
+          else
+              my->_wallet_db.add_owned_balance_id( balance_id );
 
           const auto account_address = key_record->account_address;
           const auto account_record = my->_wallet_db.lookup_account( account_address );
           const auto name = account_record.valid() ? account_record->name : string( account_address );
-          if( !account_name.empty() && name != account_name ) return;
+          if( !account_name.empty() && name != account_name ) continue;
 
-          const auto balance_id = record.id();
-          const auto pending_record = pending_state->get_balance_record( balance_id );
-          if( !pending_record.valid() ) return;
-          if( !include_empty && pending_record->balance == 0 ) return;
+          if( !include_empty && pending_record->balance == 0 ) continue;
           balance_records[ name ].push_back( *pending_record );
 
           /* Re-cache the pending balance just in case */
           my->sync_balance_with_blockchain( balance_id, pending_record );
-      };
-
-      my->_blockchain->scan_balances( scan_balance );
+      }
 
       return balance_records;
    } FC_CAPTURE_AND_RETHROW() }
@@ -4489,112 +4620,72 @@ namespace detail {
    {
       map<order_id_type, market_order> order_map;
 
-      const auto filter = [&]( const market_order& order ) -> bool
+      for( const auto& item : my->_wallet_db.get_keys() )
       {
-          const auto okey = my->_wallet_db.lookup_key( order.get_owner() );
-          if( !okey.valid() || !okey->has_private_key() )
-              return false;
-
-          if( account_name == "ALL" )
-              return true;
+          if( order_map.size() >= limit )
+              break;
 
-          const auto oaccount = my->_wallet_db.lookup_account( okey->account_address );
-          if( !oaccount.valid() )
-              return false;
+          const auto& key = item.second;
+          if( !key.has_private_key() )
+              continue;
 
-          return oaccount->name == account_name;
-      };
+          if( account_name != "ALL" )
+          {
+              const auto oaccount = my->_wallet_db.lookup_account( key.account_address );
+              if( !oaccount.valid() || oaccount->name != account_name )
+                  continue;
+          }
 
-      const auto orders = my->_blockchain->get_market_orders( filter, limit );
-      for( const auto& order : orders )
-          order_map[ order.get_id() ] = order;
+          const auto orders = my->_blockchain->get_market_orders_for_owner( item.first, limit - order_map.size() );
+          for( const auto& order : orders )
+              order_map[ order.get_id() ] = order;
+      }
 
       return order_map;
    }
 
-   // TODO: We don't need this anymore
    map<order_id_type, market_order> wallet::get_market_orders( const string& quote_symbol, const string& base_symbol,
                                                                uint32_t limit, const string& account_name)const
    { try {
-      auto bids   = my->_blockchain->get_market_bids( quote_symbol, base_symbol );
-      auto asks   = my->_blockchain->get_market_asks( quote_symbol, base_symbol );
-      auto shorts = my->_blockchain->get_market_shorts( quote_symbol );
-      auto covers = my->_blockchain->get_market_covers( quote_symbol );
-
-      map<order_id_type, market_order> result;
-
-      uint32_t count = 0;
-
-      for( const auto& order : bids )
-      {
-         if( count >= limit )
-             break;
-         auto okey_rec = my->_wallet_db.lookup_key( order.get_owner() );
-         if( !okey_rec.valid() )
-             continue;
-         auto oacct = my->_wallet_db.lookup_account( okey_rec->account_address );
-         FC_ASSERT( oacct.valid(), "Account for that account_addres doesn't exist!");
-         if( oacct->name == account_name || account_name == "ALL" )
-         {
-             if( my->_wallet_db.has_private_key( order.get_owner() ) )
-                result[ order.get_id() ] = order;
-             count++;
-         }
-      }
+      const auto quote_id = my->_blockchain->get_asset_id( quote_symbol );
+      const auto base_id  = my->_blockchain->get_asset_id( base_symbol );
+      // the same error get_market_bids() raises for a reversed pair
+      if( base_id >= quote_id )
+         FC_CAPTURE_AND_THROW( invalid_market, (quote_id)(base_id) );
 
-      count = 0;
-      for( const auto& order : asks )
+      const auto is_own_order = [&]( const market_order& order ) -> bool
       {
-         if( count >= limit )
-             break;
-         auto okey_rec = my->_wallet_db.lookup_key( order.get_owner() );
-         if( !okey_rec.valid() )
-             continue;
-         auto oacct = my->_wallet_db.lookup_account( okey_rec->account_address );
-         FC_ASSERT( oacct.valid(), "Account for that account_addres doesn't exist!");
-         if( oacct->name == account_name || account_name == "ALL" )
-         {
-             if( my->_wallet_db.has_private_key( order.get_owner() ) )
-                result[ order.get_id() ] = order;
-             count++;
-         }
-      }
+         const auto okey_rec = my->_wallet_db.lookup_key( order.get_owner() );
+         if( !okey_rec.valid() || !okey_rec->has_private_key() )
+             return false;
+         if( account_name == "ALL" )
+             return true;
+         const auto oacct = my->_wallet_db.lookup_account( okey_rec->account_address );
+         FC_ASSERT( oacct.valid(), "Account for that account_address doesn't exist!");
+         return oacct->name == account_name;
+      };
 
-      count = 0;
-      for( const auto& order : shorts )
-      {
-         if( count > limit )
-             break;
-         auto okey_rec = my->_wallet_db.lookup_key( order.get_owner() );
-         if( !okey_rec.valid() )
-             continue;
-         auto oacct = my->_wallet_db.lookup_account( okey_rec->account_address );
-         FC_ASSERT( oacct.valid(), "Account for that account_addres doesn't exist!");
-         if( oacct->name == account_name || account_name == "ALL" )
-         {
-             if( my->_wallet_db.has_private_key( order.get_owner() ) )
-                result[ order.get_id() ] = order;
-             count++;
-         }
-      }
+      map<order_id_type, market_order> result;
 
-      count = 0;
-      for( const auto& order : covers )
+      // each side gets its own limit: bids, asks, and the shorts and covers against the base asset
+      const auto add_side = [&]( const asset_id_type& side_base_id, const vector<order_type_enum>& types )
       {
-         if( count > limit )
-             break;
-         auto okey_rec = my->_wallet_db.lookup_key( order.get_owner() );
-         if( !okey_rec.valid() )
-             continue;
-         auto oacct = my->_wallet_db.lookup_account( okey_rec->account_address );
-         FC_ASSERT( oacct.valid(), "Account for that account_address doesn't exist!");
-         if( oacct->name == account_name || account_name == "ALL" )
+         uint32_t count = 0;
+         for( const auto type : types )
          {
-             if( my->_wallet_db.has_private_key( order.get_owner() ) )
-                result[ order.get_id() ] = order;
-             count++;
+            if( count >= limit )
+               break;
+            for( const auto& order : my->_blockchain->get_market_orders( quote_id, side_base_id, is_own_order, limit - count, type ) )
+            {
+               result[ order.get_id() ] = order;
+               ++count;
+            }
          }
-      }
+      };
+      add_side( base_id, { bid_order, relative_bid_order } );
+      add_side( base_id, { ask_order, relative_ask_order } );
+      add_side( asset_id_type( 0 ), { short_order } );
+      add_side( asset_id_type( 0 ), { cover_order } );
       return result;
    } FC_CAPTURE_AND_RETHROW( (quote_symbol)(base_symbol) ) }
 
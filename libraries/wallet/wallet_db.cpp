@@ -4,6 +4,7 @@
 
 #include <fc/io/json.hpp>
 #include <fstream>
+#include <unordered_set>
 
 namespace bts { namespace wallet {
 
@@ -16,6 +17,19 @@ namespace bts { namespace wallet {
            wallet_db*                                        self;
            bts::db::level_map<int32_t,generic_wallet_record> _records;
 
+           // Transaction history indexes, ordered by (block_num, record_id) within each account and asset.
+           // They are rebuilt from the loaded records when stale, and kept up to date as records are stored.
+           bool                                                              _transaction_history_stale = true;
+           set<transaction_history_cursor>                                   _transaction_history;
+           set<pair<address, transaction_history_cursor>>                    _account_transaction_history;
+           set<pair<asset_id_type, transaction_history_cursor>>              _asset_transaction_history;
+           // ledger entry addresses that were not wallet keys when their transactions were indexed
+           std::unordered_set<address>                                       _unresolved_history_addresses;
+
+           // decrypted private keys by key address, only while the wallet is unlocked
+           bool                                                              _private_key_cache_enabled = false;
+           unordered_map<address, private_key_type>                          _private_key_cache;
+
            void store_and_reload_generic_record( const generic_wallet_record& record )
            { try {
                auto index = record.get_wallet_record_index();
@@ -96,6 +110,12 @@ namespace bts { namespace wallet {
            { try {
                const address key_address = key_record.get_address();
 
+               // transactions already indexed against this key's address now belong to another account
+               const auto existing = self->keys.find( key_address );
+               if( existing != self->keys.end() ? existing->second.account_address != key_record.account_address
+                                                : _unresolved_history_addresses.count( key_address ) > 0 )
+                   _transaction_history_stale = true;
+
                self->keys[ key_address ] = key_record;
 
                // Cache address map
@@ -109,6 +129,10 @@ namespace bts { namespace wallet {
            void load_transaction_record( const wallet_transaction_record& transaction_record )
            { try {
                const transaction_id_type& record_id = transaction_record.record_id;
+               const auto existing = self->transactions.find( record_id );
+               if( existing != self->transactions.end() )
+                   index_transaction_history( existing->second, false );
+               index_transaction_history( transaction_record, true );
                self->transactions[ record_id ] = transaction_record;
 
                // Cache id map
@@ -121,6 +145,7 @@ namespace bts { namespace wallet {
            void load_balance_record( const wallet_balance_record& rec )
            { try {
               self->balances[ rec.id() ] = rec;
+              self->owned_balance_ids.insert( rec.id() );
            } FC_CAPTURE_AND_RETHROW( (rec) ) }
 
            void load_property_record( const wallet_property_record& property_rec )
@@ -132,6 +157,82 @@ namespace bts { namespace wallet {
            { try {
               self->settings[rec.name] = rec;
            } FC_CAPTURE_AND_RETHROW( (rec) ) }
+
+           /** Accounts the ledger entries of a transaction move funds from or to, by account address */
+           set<address> get_transaction_history_accounts( const wallet_transaction_record& transaction_record )
+           {
+               set<address> account_addresses;
+               const auto resolve = [&]( const optional<public_key_type>& key )
+               {
+                   if( !key.valid() ) return;
+                   const address key_address( *key );
+                   const owallet_key_record key_record = self->lookup_key( key_address );
+                   if( key_record.valid() )
+                       account_addresses.insert( key_record->account_address );
+                   else
+                       _unresolved_history_addresses.insert( key_address );
+               };
+               for( const auto& entry : transaction_record.ledger_entries )
+               {
+                   resolve( entry.from_account );
+                   resolve( entry.to_account );
+               }
+               return account_addresses;
+           }
+
+           /** Assets a transaction moves a nonzero amount of, including its fee */
+           static set<asset_id_type> get_transaction_history_assets( const wallet_transaction_record& transaction_record )
+           {
+               set<asset_id_type> asset_ids;
+               for( const auto& entry : transaction_record.ledger_entries )
+               {
+                   if( entry.amount.amount > 0 )
+                       asset_ids.insert( entry.amount.asset_id );
+               }
+               if( transaction_record.fee.amount > 0 )
+                   asset_ids.insert( transaction_record.fee.asset_id );
+               return asset_ids;
+           }
+
+           void index_transaction_history( const wallet_transaction_record& transaction_record, bool add )
+           {
+               if( _transaction_history_stale ) return;
+               if( transaction_record.ledger_entries.empty() ) return; /* Not shown in the history */
+
+               const transaction_history_cursor position( transaction_record.block_num, transaction_record.record_id );
+               if( add ) _transaction_history.insert( position );
+               else _transaction_history.erase( position );
+
+               for( const address& account_address : get_transaction_history_accounts( transaction_record ) )
+               {
+                   if( add ) _account_transaction_history.insert( std::make_pair( account_address, position ) );
+                   else _account_transaction_history.erase( std::make_pair( account_address, position ) );
+               }
+
+               for( const asset_id_type asset_id : get_transaction_history_assets( transaction_record ) )
+               {
+                   if( add ) _asset_transaction_history.insert( std::make_pair( asset_id, position ) );
+                   else _asset_transaction_history.erase( std::make_pair( asset_id, position ) );
+               }
+           }
+
+           void clear_transaction_history()
+           {
+               _transaction_history.clear();
+               _account_transaction_history.clear();
+               _asset_transaction_history.clear();
+               _unresolved_history_addresses.clear();
+               _transaction_history_stale = true;
+           }
+
+           void refresh_transaction_history()
+           {
+               if( !_transaction_history_stale ) return;
+               clear_transaction_history();
+               _transaction_history_stale = false;
+               for( const auto& item : self->transactions )
+                   index_transaction_history( item.second, true );
+           }
      };
 
    } // namespace detail
@@ -150,6 +251,9 @@ namespace bts { namespace wallet {
    { try {
       try
       {
+          // index the transaction history once every record is loaded
+          my->clear_transaction_history();
+
           my->_records.open( wallet_file, true );
           for( auto itr = my->_records.begin(); itr.valid(); ++itr )
           {
@@ -179,6 +283,7 @@ namespace bts { namespace wallet {
 
    void wallet_db::close()
    {
+      clear_private_key_cache();
       my->_records.close();
 
       wallet_master_key.reset();
@@ -193,8 +298,12 @@ namespace bts { namespace wallet {
 
       transactions.clear();
       id_to_transaction_record_index.clear();
+      my->clear_transaction_history();
 
       balances.clear();
+      owned_balance_ids.clear();
+      emptied_balance_ids.clear();
+      owned_balance_ids_are_complete = false;
       properties.clear();
       settings.clear();
    }
@@ -334,7 +443,7 @@ namespace bts { namespace wallet {
        FC_ASSERT( key_record.valid(), "Active key not found!" );
        FC_ASSERT( key_record->has_private_key(), "Active private key not found!" );
 
-       const private_key_type active_private_key = key_record->decrypt_private_key( password );
+       const private_key_type active_private_key = get_private_key( *key_record, password );
        uint32_t seq_num = account_record->last_used_gen_sequence;
        private_key_type account_child_private_key;
        public_key_type account_child_public_key;
@@ -536,6 +645,11 @@ namespace bts { namespace wallet {
        FC_ASSERT( key.public_key != public_key_type() );
 
        owallet_key_record key_record = lookup_key( key.get_address() );
+
+       // a key we can newly sign with may already own balances on the chain
+       if( key.has_private_key() && !(key_record.valid() && key_record->has_private_key()) )
+           owned_balance_ids_are_complete = false;
+
        if( !key_record.valid() )
            key_record = wallet_key_record();
 
@@ -590,6 +704,44 @@ namespace bts { namespace wallet {
        store_key( *key_record );
    } FC_CAPTURE_AND_RETHROW( (account_name)(move_existing) ) }
 
+   private_key_type wallet_db::get_private_key( const wallet_key_record& key_record, const fc::sha512& password )const
+   { try {
+       FC_ASSERT( key_record.has_private_key() );
+       if( !my->_private_key_cache_enabled )
+           return key_record.decrypt_private_key( password );
+
+       const address key_address = key_record.get_address();
+       const auto cache_iter = my->_private_key_cache.find( key_address );
+       if( cache_iter != my->_private_key_cache.end() )
+           return cache_iter->second;
+
+       const private_key_type private_key = key_record.decrypt_private_key( password );
+       my->_private_key_cache[ key_address ] = private_key;
+       return private_key;
+   } FC_CAPTURE_AND_RETHROW( (key_record.get_address()) ) }
+
+   private_key_type wallet_db::get_private_key( const public_key_type& public_key, const fc::sha512& password )const
+   { try {
+       const owallet_key_record key_record = lookup_key( address( public_key ) );
+       FC_ASSERT( key_record.valid() );
+       return get_private_key( *key_record, password );
+   } FC_CAPTURE_AND_RETHROW( (public_key) ) }
+
+   void wallet_db::cache_private_keys( const fc::sha512& password )
+   { try {
+       FC_ASSERT( is_open() );
+       clear_private_key_cache();
+       my->_private_key_cache_enabled = true;
+       get_account_private_keys( password );
+   } FC_CAPTURE_AND_RETHROW() }
+
+   void wallet_db::clear_private_key_cache()
+   {
+       // destroying the keys frees their secrets with the crypto library's clearing free
+       my->_private_key_cache.clear();
+       my->_private_key_cache_enabled = false;
+   }
+
    owallet_transaction_record wallet_db::lookup_transaction( const transaction_id_type& id )const
    { try {
        FC_ASSERT( is_open() );
@@ -668,7 +820,7 @@ namespace bts { namespace wallet {
 
            try
            {
-               private_keys[ key_record->decrypt_private_key( password ) ] = account_name;
+               private_keys[ get_private_key( *key_record, password ) ] = account_name;
            }
            catch( const fc::exception& e )
            {
@@ -681,6 +833,9 @@ namespace bts { namespace wallet {
    void wallet_db::repair_records( const fc::sha512& password )
    { try {
        FC_ASSERT( is_open() );
+       owned_balance_ids_are_complete = false;
+       // key records may be rewritten under different addresses
+       my->_private_key_cache.clear();
 
        vector<generic_wallet_record> records;
        for( auto iter = my->_records.begin(); iter.valid(); ++iter )
@@ -738,6 +893,7 @@ namespace bts { namespace wallet {
        }
 
        // Repair transaction_data.record_id
+       my->clear_transaction_history();
        for( generic_wallet_record& record : records )
        {
            try
@@ -1041,6 +1197,24 @@ namespace bts { namespace wallet {
       }
    } FC_CAPTURE_AND_RETHROW() }
 
+   void wallet_db::add_owned_balance_id( const balance_id_type& balance_id )
+   {
+      emptied_balance_ids.erase( balance_id );
+      owned_balance_ids.insert( balance_id );
+   }
+
+   void wallet_db::set_owned_balance_emptied( const balance_id_type& balance_id )
+   {
+      owned_balance_ids.erase( balance_id );
+      emptied_balance_ids.insert( balance_id );
+   }
+
+   void wallet_db::remove_owned_balance_id( const balance_id_type& balance_id )
+   {
+      owned_balance_ids.erase( balance_id );
+      emptied_balance_ids.erase( balance_id );
+   }
+
    void wallet_db::remove_balance( const balance_id_type& balance_id )
    {
       remove_item( balances[balance_id].wallet_record_index );
@@ -1052,7 +1226,52 @@ namespace bts { namespace wallet {
       const auto rec = lookup_transaction( record_id );
       if( !rec.valid() ) return;
       remove_item( rec->wallet_record_index );
+      my->index_transaction_history( *rec, false );
       transactions.erase( record_id );
    }
 
+   vector<wallet_transaction_record> wallet_db::get_transaction_history( const optional<address>& account_address,
+                                                                        const optional<asset_id_type>& asset_id,
+                                                                        const transaction_history_cursor& start,
+                                                                        uint32_t end_block_num,
+                                                                        uint32_t limit )const
+   { try {
+       FC_ASSERT( is_open() );
+       my->refresh_transaction_history();
+
+       vector<wallet_transaction_record> transaction_records;
+       // returns false once the page is complete
+       const auto add_record = [&]( const transaction_history_cursor& position ) -> bool
+       {
+           if( position.first > end_block_num || transaction_records.size() >= limit )
+               return false;
+           const wallet_transaction_record& transaction_record = transactions.at( position.second );
+           if( account_address.valid() && asset_id.valid()
+               && my->get_transaction_history_assets( transaction_record ).count( *asset_id ) <= 0 )
+               return true;
+           transaction_records.push_back( transaction_record );
+           return true;
+       };
+
+       if( account_address.valid() )
+       {
+           const auto& index = my->_account_transaction_history;
+           for( auto itr = index.lower_bound( std::make_pair( *account_address, start ) );
+                itr != index.end() && itr->first == *account_address && add_record( itr->second ); ++itr );
+       }
+       else if( asset_id.valid() )
+       {
+           const auto& index = my->_asset_transaction_history;
+           for( auto itr = index.lower_bound( std::make_pair( *asset_id, start ) );
+                itr != index.end() && itr->first == *asset_id && add_record( itr->second ); ++itr );
+       }
+       else
+       {
+           const auto& index = my->_transaction_history;
+           for( auto itr = index.lower_bound( start ); itr != index.end() && add_record( *itr ); ++itr );
+       }
+
+       return transaction_records;
+   } FC_CAPTURE_AND_RETHROW( (account_address)(asset_id)(start)(end_block_num)(limit) ) }
+
 } } // bts::wallet
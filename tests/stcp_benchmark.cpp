@@ -0,0 +1,56 @@
+#define BOOST_TEST_MODULE StcpBenchmark
+#include <boost/test/unit_test.hpp>
+
+#include <bts/net/stcp_socket.hpp>
+
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+#include <iostream>
+
+// the size of a frame carrying a full sized block
+const size_t   frame_size = 512 * 1024 + 16;
+const unsigned frames_to_send = 200;
+
+BOOST_AUTO_TEST_CASE(stcp_socket_throughput)
+{
+  fc::tcp_server server;
+  server.listen(fc::ip::endpoint(fc::ip::address("127.0.0.1"), 0));
+
+  bts::net::stcp_socket receiving_socket;
+  fc::future<void> accept_done = fc::async([&](){
+    server.accept(receiving_socket.get_socket());
+    receiving_socket.accept();
+  }, "accept");
+
+  bts::net::stcp_socket sending_socket;
+  sending_socket.connect_to(server.get_local_endpoint());
+  accept_done.wait();
+
+  std::vector<char> plaintext(frame_size);
+  for (size_t i = 0; i < plaintext.size(); ++i)
+    plaintext[i] = char(i * 7);
+  std::vector<char> received(frame_size);
+
+  fc::time_point start_time = fc::time_point::now();
+  fc::future<void> send_done = fc::async([&](){
+    for (unsigned i = 0; i < frames_to_send; ++i)
+      sending_socket.write(plaintext.data(), plaintext.size());
+    sending_socket.flush();
+  }, "send frames");
+
+  for (unsigned i = 0; i < frames_to_send; ++i)
+  {
+    receiving_socket.read(received.data(), received.size());
+    BOOST_REQUIRE(received == plaintext);
+  }
+  send_done.wait();
+  fc::microseconds elapsed = fc::time_point::now() - start_time;
+
+  double megabytes = double(frame_size) * frames_to_send / (1024 * 1024);
+  std::cout << "stcp_socket: transferred " << megabytes << " MB in " << elapsed.count() / 1000 << " ms, "
+            << megabytes * 1000000 / elapsed.count() << " MB/s\n";
+
+  sending_socket.close();
+  receiving_socket.close();
+}
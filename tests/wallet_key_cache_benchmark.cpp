@@ -0,0 +1,65 @@
+#define BOOST_TEST_MODULE WalletKeyCacheBenchmark
+#include <boost/test/unit_test.hpp>
+
+#include <bts/wallet/wallet_db.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/time.hpp>
+#include <iostream>
+
+using namespace bts::wallet;
+
+// a transfer spending one balance per output, each owned by a different key
+const unsigned outputs_per_transfer = 50;
+const unsigned transfers_to_sign = 20;
+
+BOOST_AUTO_TEST_CASE(wallet_key_cache_signing_throughput)
+{
+  fc::temp_directory wallet_dir;
+  wallet_db db;
+  db.open(wallet_dir.path() / "wallet");
+
+  const std::string passphrase = "benchmark passphrase";
+  const fc::sha512 password = fc::sha512::hash(passphrase.c_str(), passphrase.size());
+  db.set_master_key(extended_private_key(fc::sha512::hash(password)), password);
+  db.generate_new_account(password, "alice", fc::variant());
+
+  std::vector<address> owner_addresses;
+  signed_transaction transfer;
+  for (unsigned i = 0; i < outputs_per_transfer; ++i)
+  {
+    const address owner(db.generate_new_account_child_key(password, "alice").get_public_key());
+    owner_addresses.push_back(owner);
+    transfer.withdraw(withdraw_condition(withdraw_with_signature(owner), 0).get_address(), 1);
+    transfer.deposit(owner, asset(1), 0);
+  }
+
+  const auto sign_transfers = [&]() -> fc::microseconds
+  {
+    fc::time_point start_time = fc::time_point::now();
+    for (unsigned i = 0; i < transfers_to_sign; ++i)
+    {
+      signed_transaction trx = transfer;
+      for (const address& owner : owner_addresses)
+        trx.sign(db.get_private_key(*db.lookup_key(owner), password), digest_type());
+      BOOST_REQUIRE(trx.signatures.size() == outputs_per_transfer);
+    }
+    return fc::time_point::now() - start_time;
+  };
+
+  db.clear_private_key_cache();
+  const fc::microseconds uncached = sign_transfers();
+
+  db.cache_private_keys(password);
+  sign_transfers(); // the child keys are cached on first use
+  const fc::microseconds cached = sign_transfers();
+
+  const double signatures = double(outputs_per_transfer) * transfers_to_sign;
+  std::cout << "wallet_db: signed " << transfers_to_sign << " transfers of " << outputs_per_transfer << " outputs\n"
+            << "  without key cache: " << uncached.count() / 1000 << " ms, "
+            << signatures * 1000000 / uncached.count() << " signatures/s\n"
+            << "  with key cache:    " << cached.count() / 1000 << " ms, "
+            << signatures * 1000000 / cached.count() << " signatures/s\n";
+
+  db.close();
+}